@@ -0,0 +1,200 @@
+#include "Bot.h"
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+    //script key names are the ones the old INPUT messages used
+    uint8_t inputBitFor(const std::string& key)
+    {
+        if (key == "LEFT") return Protocol::InputBits::LEFT;
+        if (key == "RIGHT") return Protocol::InputBits::RIGHT;
+        if (key == "UP") return Protocol::InputBits::JUMP;
+        if (key == "DOWN") return Protocol::InputBits::DOWN;
+        return 0;
+    }
+}
+
+bool BotScript::load(const std::string& path, BotScript& script, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        error = "cant open " + path;
+        return false;
+    }
+
+    script.steps.clear();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        std::istringstream ss(line);
+        std::string command;
+        if (!(ss >> command) || command[0] == '#')
+            continue;
+
+        BotStep step;
+        bool ok = true;
+        if (command == "wait") { step.kind = BotStep::Kind::WAIT; ok = static_cast<bool>(ss >> step.ms); }
+        else if (command == "press") { step.kind = BotStep::Kind::PRESS; ok = ss >> step.key && inputBitFor(step.key); }
+        else if (command == "release") { step.kind = BotStep::Kind::RELEASE; ok = ss >> step.key && inputBitFor(step.key); }
+        else if (command == "use") { step.kind = BotStep::Kind::USE; ok = static_cast<bool>(ss >> step.slot >> step.dx >> step.dy); }
+        else if (command == "loop") step.kind = BotStep::Kind::LOOP;
+        else ok = false;
+
+        if (!ok)
+        {
+            error = path + ":" + std::to_string(lineNumber) + ": bad step '" + line + "'";
+            return false;
+        }
+        script.steps.push_back(step);
+    }
+    return true;
+}
+
+BotScript BotScript::defaultScript()
+{
+    BotScript script;
+    auto add = [&script](const BotStep::Kind kind, const std::string& key = "", const int ms = 0, const int dy = 0)
+    {
+        BotStep step;
+        step.kind = kind;
+        step.key = key;
+        step.ms = ms;
+        step.dy = dy;
+        script.steps.push_back(step);
+    };
+
+    add(BotStep::Kind::PRESS, "RIGHT");
+    add(BotStep::Kind::WAIT, "", 1000);
+    add(BotStep::Kind::RELEASE, "RIGHT");
+    add(BotStep::Kind::PRESS, "UP");
+    add(BotStep::Kind::WAIT, "", 200);
+    add(BotStep::Kind::RELEASE, "UP");
+    add(BotStep::Kind::PRESS, "LEFT");
+    add(BotStep::Kind::WAIT, "", 1000);
+    add(BotStep::Kind::RELEASE, "LEFT");
+    add(BotStep::Kind::USE, "", 0, 2); //the tile under its feet, players are two tiles tall
+    add(BotStep::Kind::WAIT, "", 500);
+    add(BotStep::Kind::LOOP);
+    return script;
+}
+
+Bot::Bot(const int index, const BotScript& script, const NetBackend backend, const bool streamChunks, const bool udp) : index(index), script(script)
+{
+    network.setBackend(backend);
+    network.setChunkStreaming(streamChunks);
+    network.setUdpEnabled(udp);
+    network.setGame(&game);
+    game.setNetwork(&network);
+}
+
+bool Bot::connect(const std::string& host, const int port)
+{
+    const auto started = std::chrono::steady_clock::now();
+    if (!network.connectToServer(host, port))
+        return false;
+
+    connectMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    return true;
+}
+
+void Bot::tick(const std::chrono::steady_clock::time_point now)
+{
+    if (!network.isConnected())
+        return;
+
+    game.processNetworkMessages();
+    game.updateChunkStreaming(now);
+
+    //scripts only start once the server has placed us
+    float x, y;
+    if (!game.getPlayerPosition(game.getLocalPlayerId(), x, y) || script.steps.empty())
+        return;
+    if (!scriptStarted)
+    {
+        scriptStarted = true;
+        nextStepAt = now;
+    }
+
+    //run every step thats due, bounded so a script without waits cant spin forever
+    for (size_t executed = 0; now >= nextStepAt && executed < script.steps.size(); executed++)
+    {
+        const BotStep& current = script.steps[step];
+        step = (step + 1) % script.steps.size();
+        runStep(current, now);
+    }
+    game.sampleInput(now);
+}
+
+void Bot::runStep(const BotStep& current, const std::chrono::steady_clock::time_point now)
+{
+    switch (current.kind)
+    {
+    case BotStep::Kind::WAIT:
+        nextStepAt = now + std::chrono::milliseconds(current.ms);
+        break;
+    case BotStep::Kind::PRESS:
+    case BotStep::Kind::RELEASE:
+        game.setInputKey(inputBitFor(current.key), current.kind == BotStep::Kind::PRESS);
+        inputsSent++;
+        break;
+    case BotStep::Kind::USE:
+    {
+        float x, y;
+        if (network.isSendBacklogged() || !game.getPlayerPosition(game.getLocalPlayerId(), x, y))
+            break; //optional traffic, skipped while the socket is behind
+
+        //same top-down to bottom-up flip Game::handleInput does for mouse clicks
+        constexpr int worldHeightInTiles = World::WORLD_HEIGHT_IN_CHUNKS * Chunk::SIZE;
+        const int tileX = static_cast<int>(std::floor(x)) + current.dx;
+        const int tileY = static_cast<int>(std::floor(y)) + current.dy;
+        network.sendUseItem(current.slot, tileX, worldHeightInTiles - 1 - tileY);
+        usesSent++;
+        break;
+    }
+    case BotStep::Kind::LOOP:
+        step = 0;
+        break;
+    }
+}
+
+BotReport Bot::finish()
+{
+    BotReport report;
+    report.index = index;
+    report.connected = connectMs >= 0.0;
+    report.connectMs = connectMs;
+    report.worldLoadMs = game.getWorldLoadMs();
+    report.firstFullScreenMs = game.getFirstFullScreenMs();
+
+    //snapshot before disconnecting, the next connection would reset it
+    const NetTelemetry::Snapshot snap = network.getTelemetry().snapshot();
+    if (report.connected)
+    {
+        report.sessionSeconds = snap.elapsedSeconds;
+        report.udp = network.isUdpActive();
+        report.playerMoves = snap.opcodes[static_cast<uint8_t>(Protocol::Opcode::PLAYER_MOVE)].messagesIn + network.getUdpStats().movesIn;
+        report.playerMovesPerSecond = snap.elapsedSeconds > 0.0 ? static_cast<double>(report.playerMoves) / snap.elapsedSeconds : 0.0;
+        report.rttMinMs = snap.minRttMs;
+        report.rttSmoothedMs = snap.smoothedRttMs;
+        report.rttMaxMs = snap.maxRttMs;
+        report.rttSamples = snap.rttSamples;
+        report.bytesIn = snap.bytesIn;
+        report.bytesOut = snap.bytesOut;
+    }
+    report.inputsSent = inputsSent;
+    report.usesSent = usesSent;
+    if (const Game::MoveLatency& latency = game.getMoveLatency(); latency.samples > 0)
+    {
+        report.moveLatencySamples = latency.samples;
+        report.moveLatencyAvgMs = latency.totalMs / static_cast<double>(latency.samples);
+        report.moveLatencyMaxMs = latency.worstMs;
+    }
+
+    network.disconnect();
+    return report;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../include/Game.h"
+#include "../include/Network.h"
+
+//one scripted step, scripts are plain text with one step per line:
+//  wait <ms> | press <UP|DOWN|LEFT|RIGHT> | release <UP|DOWN|LEFT|RIGHT> | use <slot> <dx> <dy> | loop
+//use targets a tile relative to the bot's own position (dy is down), loop jumps back to the first step
+struct BotStep
+{
+    enum class Kind { WAIT, PRESS, RELEASE, USE, LOOP } kind = Kind::WAIT;
+    std::string key;
+    int ms = 0;
+    int slot = 0;
+    int dx = 0;
+    int dy = 0;
+};
+
+struct BotScript
+{
+    std::vector<BotStep> steps;
+
+    static bool load(const std::string& path, BotScript& script, std::string& error);
+    static BotScript defaultScript(); //walk right, jump, walk left, dig under its feet, repeat
+};
+
+struct BotReport
+{
+    int index = 0;
+    bool connected = false;
+    double connectMs = -1.0;
+    double worldLoadMs = -1.0; //ASSIGN_ID to the last chunk installed
+    double firstFullScreenMs = -1.0; //ASSIGN_ID to every chunk of the spawn view installed
+    double sessionSeconds = 0.0;
+    uint64_t playerMoves = 0;
+    double playerMovesPerSecond = 0.0;
+    double rttMinMs = 0.0;
+    double rttSmoothedMs = 0.0;
+    double rttMaxMs = 0.0;
+    uint64_t rttSamples = 0;
+    uint64_t inputsSent = 0;
+    uint64_t usesSent = 0;
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    bool udp = false; //movement came over the UDP side channel
+    uint64_t moveLatencySamples = 0;
+    double moveLatencyAvgMs = -1.0; //movement key pressed until our next PLAYER_MOVE
+    double moveLatencyMaxMs = -1.0;
+};
+
+//a single simulated player: a real Network plus a headless Game, driven by whichever pool thread owns it
+class Bot
+{
+public:
+    Bot(int index, const BotScript& script, NetBackend backend, bool streamChunks, bool udp);
+
+    bool connect(const std::string& host, int port);
+    void tick(std::chrono::steady_clock::time_point now);
+    BotReport finish(); //disconnects and returns the numbers for this connection
+
+    [[nodiscard]] bool isConnected() const { return network.isConnected(); }
+
+private:
+    Game game{true};
+    Network network; //declared after game so it disconnects (and stops pushing into game) first
+
+    int index;
+    const BotScript& script;
+    size_t step = 0;
+    std::chrono::steady_clock::time_point nextStepAt;
+    bool scriptStarted = false;
+
+    double connectMs = -1.0;
+    uint64_t inputsSent = 0;
+    uint64_t usesSent = 0;
+
+    void runStep(const BotStep& current, std::chrono::steady_clock::time_point now);
+};
@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <SDL.h>
+
+#include "Bot.h"
+
+//swagaria-bot: headless load generator, opens N scripted connections against a server and reports how it held up
+//  --host <ip> --port <n> --bots <n> --threads <n> --duration <s> --ramp <ms> --script <file> --report <file.csv> --net-backend sdl|epoll
+//  --chunks stream|bulk --udp on|off
+namespace
+{
+    struct Options
+    {
+        std::string host = "127.0.0.1";
+        int port = 25565;
+        int bots = 10;
+        int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        int durationSeconds = 30;
+        int rampMs = 50; //between connects, so the server sees a join curve instead of one spike
+        std::string scriptPath;
+        std::string reportPath;
+        NetBackend backend = Network::defaultBackend();
+        bool streamChunks = true; //bulk makes the server push the whole world at join like old clients
+        bool udp = false;         //movement and input over the UDP side channel
+    };
+
+    Options parseOptions(const int argc, char* argv[])
+    {
+        Options options;
+        for (int i = 1; i + 1 < argc; i++)
+        {
+            const std::string arg = argv[i];
+            const char* value = argv[++i];
+            if (arg == "--host") options.host = value;
+            else if (arg == "--port") options.port = std::atoi(value);
+            else if (arg == "--bots") options.bots = std::max(1, std::atoi(value));
+            else if (arg == "--threads") options.threads = std::max(1, std::atoi(value));
+            else if (arg == "--duration") options.durationSeconds = std::max(1, std::atoi(value));
+            else if (arg == "--ramp") options.rampMs = std::max(0, std::atoi(value));
+            else if (arg == "--script") options.scriptPath = value;
+            else if (arg == "--report") options.reportPath = value;
+            else if (arg == "--net-backend") options.backend = std::strcmp(value, "epoll") == 0 ? NetBackend::EPOLL : NetBackend::SDL_NET;
+            else if (arg == "--chunks") options.streamChunks = std::strcmp(value, "bulk") != 0;
+            else if (arg == "--udp") options.udp = std::strcmp(value, "on") == 0;
+            else
+            {
+                std::cerr << "[BOT] Unknown option " << arg << std::endl;
+                i--;
+            }
+        }
+        return options;
+    }
+
+    double percentile(std::vector<double> values, const double p)
+    {
+        if (values.empty()) return -1.0;
+        std::sort(values.begin(), values.end());
+        return values[std::min(values.size() - 1, static_cast<size_t>(p * static_cast<double>(values.size() - 1) + 0.5))];
+    }
+
+    void writeReport(const std::string& path, const std::vector<BotReport>& reports)
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            std::cerr << "[BOT] Failed to open report file " << path << std::endl;
+            return;
+        }
+
+        out << "bot,connected,connect_ms,world_load_ms,first_full_screen_ms,session_s,player_moves,player_moves_per_s,rtt_min_ms,rtt_smoothed_ms,rtt_max_ms,rtt_samples,inputs_sent,uses_sent,bytes_in,bytes_out,udp,move_latency_samples,move_latency_avg_ms,move_latency_max_ms\n";
+        for (const BotReport& r : reports)
+            out << r.index << ',' << r.connected << ',' << r.connectMs << ',' << r.worldLoadMs << ',' << r.firstFullScreenMs << ',' << r.sessionSeconds << ','
+                << r.playerMoves << ',' << r.playerMovesPerSecond << ',' << r.rttMinMs << ',' << r.rttSmoothedMs << ',' << r.rttMaxMs << ','
+                << r.rttSamples << ',' << r.inputsSent << ',' << r.usesSent << ',' << r.bytesIn << ',' << r.bytesOut << ','
+                << r.udp << ',' << r.moveLatencySamples << ',' << r.moveLatencyAvgMs << ',' << r.moveLatencyMaxMs << '\n';
+        std::cout << "[BOT] Wrote per connection report to " << path << std::endl;
+    }
+
+    void printSummary(const std::vector<BotReport>& reports, const Options& options)
+    {
+        std::vector<double> connectMs, worldLoadMs, fullScreenMs, moveRates, rtts, moveLatency;
+        int connected = 0, onUdp = 0;
+        double worstMoveLatency = 0.0;
+        uint64_t bytesIn = 0, bytesOut = 0;
+        double worstRtt = 0.0;
+        for (const BotReport& r : reports)
+        {
+            if (!r.connected) continue;
+            connected++;
+            connectMs.push_back(r.connectMs);
+            if (r.worldLoadMs >= 0.0) worldLoadMs.push_back(r.worldLoadMs);
+            if (r.firstFullScreenMs >= 0.0) fullScreenMs.push_back(r.firstFullScreenMs);
+            moveRates.push_back(r.playerMovesPerSecond);
+            if (r.rttSamples > 0) rtts.push_back(r.rttSmoothedMs);
+            worstRtt = std::max(worstRtt, r.rttMaxMs);
+            if (r.moveLatencySamples > 0) moveLatency.push_back(r.moveLatencyAvgMs);
+            worstMoveLatency = std::max(worstMoveLatency, r.moveLatencyMaxMs);
+            onUdp += r.udp ? 1 : 0;
+            bytesIn += r.bytesIn;
+            bytesOut += r.bytesOut;
+        }
+
+        std::cout << "[BOT] ===== " << connected << "/" << reports.size() << " bots connected to " << options.host << ":" << options.port
+                  << " for " << options.durationSeconds << "s on " << options.threads << " threads (" << Network::backendName(options.backend) << ") =====\n"
+                  << "[BOT] connect ms        p50 " << percentile(connectMs, 0.5) << "  p95 " << percentile(connectMs, 0.95) << "  max " << percentile(connectMs, 1.0) << "\n"
+                  << "[BOT] join->last chunk  p50 " << percentile(worldLoadMs, 0.5) << "ms  p95 " << percentile(worldLoadMs, 0.95) << "ms  max "
+                  << percentile(worldLoadMs, 1.0) << "ms  (" << worldLoadMs.size() << " finished loading)\n"
+                  << "[BOT] join->full screen p50 " << percentile(fullScreenMs, 0.5) << "ms  p95 " << percentile(fullScreenMs, 0.95) << "ms  max "
+                  << percentile(fullScreenMs, 1.0) << "ms  (" << (options.streamChunks ? "streamed" : "bulk push") << ")\n"
+                  << "[BOT] PLAYER_MOVE/s     p50 " << percentile(moveRates, 0.5) << "  p5 " << percentile(moveRates, 0.05) << "  per bot\n"
+                  << "[BOT] rtt (smoothed)    p50 " << percentile(rtts, 0.5) << "ms  p95 " << percentile(rtts, 0.95) << "ms  worst sample " << worstRtt << "ms\n"
+                  << "[BOT] key->move (avg)   p50 " << percentile(moveLatency, 0.5) << "ms  p95 " << percentile(moveLatency, 0.95) << "ms  worst sample "
+                  << worstMoveLatency << "ms  (" << onUdp << " bots on UDP)\n"
+                  << "[BOT] traffic           " << bytesIn / 1024 << " KB in, " << bytesOut / 1024 << " KB out" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const Options options = parseOptions(argc, argv);
+
+    BotScript script = BotScript::defaultScript();
+    if (!options.scriptPath.empty())
+    {
+        if (std::string error; !BotScript::load(options.scriptPath, script, error))
+        {
+            std::cerr << "[BOT] " << error << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<std::unique_ptr<Bot>> bots;
+    for (int i = 0; i < options.bots; i++)
+        bots.push_back(std::make_unique<Bot>(i, script, options.backend, options.streamChunks, options.udp));
+    std::vector<BotReport> reports(bots.size());
+
+    //bot i belongs to pool thread i % threads for its whole life, so a bot is only ever touched by one thread
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::milliseconds(static_cast<int64_t>(options.bots) * options.rampMs) + std::chrono::seconds(options.durationSeconds);
+    std::vector<std::thread> pool;
+    for (int t = 0; t < std::min(options.threads, options.bots); t++)
+    {
+        pool.emplace_back([&, t]
+        {
+            std::vector<size_t> mine;
+            for (size_t i = t; i < bots.size(); i += options.threads)
+                mine.push_back(i);
+            std::vector<bool> attempted(mine.size(), false);
+
+            while (std::chrono::steady_clock::now() < deadline)
+            {
+                const auto now = std::chrono::steady_clock::now();
+                for (size_t n = 0; n < mine.size(); n++)
+                {
+                    Bot& bot = *bots[mine[n]];
+                    if (!attempted[n] && now >= start + std::chrono::milliseconds(static_cast<int64_t>(mine[n]) * options.rampMs))
+                    {
+                        attempted[n] = true;
+                        if (!bot.connect(options.host, options.port))
+                            std::cerr << "[BOT] Bot " << mine[n] << " failed to connect" << std::endl;
+                    }
+                    bot.tick(now);
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(16)); //about the real client's frame rate
+            }
+
+            for (const size_t i : mine)
+                reports[i] = bots[i]->finish();
+        });
+    }
+    for (std::thread& thread : pool)
+        thread.join();
+
+    printSummary(reports, options);
+    if (!options.reportPath.empty())
+        writeReport(options.reportPath, reports);
+    return 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+
+//heap allocations made by the calling thread. only counts when built with SWAGARIA_COUNT_ALLOCS
+//(cmake -DSWAGARIA_COUNT_ALLOCS=ON), which swaps in a counting operator new, otherwise everything reads 0
+namespace AllocCounter
+{
+#ifdef SWAGARIA_COUNT_ALLOCS
+    constexpr bool ENABLED = true;
+#else
+    constexpr bool ENABLED = false;
+#endif
+
+    uint64_t threadAllocations();
+    uint64_t threadBytes();
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <array>
+#include <cstdint>
 #include "Tile.h"
 
 namespace TileLayer
@@ -15,6 +16,7 @@ public:
     static constexpr int SIZE = 16;
     int chunkX, chunkY;
     std::array<std::array<std::array<Tile, TileLayer::NUM_LAYERS>, SIZE>, SIZE> tiles; //i fucking hate this
+    uint64_t hash = 0; //content hash, kept up to date by setTile, call rehash() after writing tiles directly
 
     Chunk(const int cx, const int cy) : chunkX(cx), chunkY(cy)
     {
@@ -28,9 +30,31 @@ public:
     {
         if (layer >= 0 && layer < TileLayer::NUM_LAYERS)
         {
-            tiles[y][x][layer].type = type;
+            Tile& tile = tiles[y][x][layer];
+            hash += tileHash(x, y, layer, static_cast<uint16_t>(type)) - tileHash(x, y, layer, tile.type);
+            tile.type = type;
         }
     }
+
+    void rehash()
+    {
+        hash = 0;
+        for (int y = 0; y < SIZE; ++y)
+            for (int x = 0; x < SIZE; ++x)
+                for (int l = 0; l < TileLayer::NUM_LAYERS; ++l)
+                    hash += tileHash(x, y, l, tiles[y][x][l].type);
+    }
+
+    //must match Chunk.tileHash on the server. the chunk hash is the sum over all tiles so one tile change
+    //is a subtract and an add, air counts as nothing so an empty chunk hashes to 0
+    static uint64_t tileHash(const int x, const int y, const int layer, const uint16_t type)
+    {
+        if (type == 0) return 0;
+        uint64_t z = (static_cast<uint64_t>((y * SIZE + x) * TileLayer::NUM_LAYERS + layer) << 16 | type) + 0x9E3779B97F4A7C15ull; //splitmix64
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
     [[nodiscard]] Tile getTile(const int x, const int y, const int layer) const
     {
         if (x >= 0 && x < SIZE && y >= 0 && y < SIZE && layer >= 0 && layer < TileLayer::NUM_LAYERS)
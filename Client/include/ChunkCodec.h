@@ -0,0 +1,22 @@
+#pragma once
+#include <memory>
+
+#include "Chunk.h"
+#include "Protocol.h"
+
+#include <string_view>
+
+//decoders for every chunk payload, they write straight into Chunk::tiles and leave Chunk::hash matching.
+//all of them return nullptr if the payload is truncated or inconsistent
+namespace ChunkCodec
+{
+    //text CHUNK_DATA line: CHUNK_DATA,chunkX,chunkY,<SIZE*SIZE ids per layer>
+    std::unique_ptr<Chunk> decodeText(std::string_view msg);
+
+    //CHUNK_DATA: chunkX, chunkY, then every tile id as u16 (layer, then bottom->top rows, left->right)
+    std::unique_ptr<Chunk> decodeRaw(Protocol::BinaryReader& reader);
+
+    //CHUNK_DATA_PACKED: chunkX, chunkY, u8 palette size, palette of u16 tile ids,
+    //then per layer (varint run length, u8 palette index) pairs covering all SIZE*SIZE tiles
+    std::unique_ptr<Chunk> decodePacked(Protocol::BinaryReader& reader);
+}
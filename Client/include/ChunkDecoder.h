@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Chunk.h"
+
+//decodes chunk payloads on a small worker pool so the join burst doesnt stall the render thread.
+//submit() and collect() are main thread only, finished chunks come back in the order they were submitted
+class ChunkDecoder
+{
+public:
+    enum class Format { TEXT, RAW, PACKED };
+
+    struct Stats
+    {
+        uint64_t chunks = 0;
+        uint64_t failed = 0;
+        uint64_t wireBytes = 0;
+        uint64_t decodeNs = 0; //summed over all workers
+    };
+
+    explicit ChunkDecoder(unsigned workerCount = defaultWorkerCount());
+    ~ChunkDecoder();
+
+    void submit(Format format, std::string_view payload, size_t wireBytes);
+    //drops every chunk not installed yet, waits out the ones a worker is in the middle of
+    void reset();
+
+    //hands up to budget finished chunks to install(std::unique_ptr<Chunk>), stops at the first one still decoding.
+    //failed chunks are skipped
+    template<typename Installer>
+    size_t collect(size_t budget, Installer&& install)
+    {
+        size_t installed = 0;
+        while (installed < budget && !inFlight.empty() && inFlight.front()->done.load(std::memory_order_acquire))
+        {
+            std::unique_ptr<Job> job = std::move(inFlight.front());
+            inFlight.pop_front();
+            releasePending(job->chunkX, job->chunkY);
+
+            if (job->result)
+            {
+                install(std::move(job->result));
+                installed++;
+            }
+        }
+        return installed;
+    }
+
+    //true while a chunk at these coords has been submitted but not installed yet
+    [[nodiscard]] bool isPending(int chunkX, int chunkY) const;
+    [[nodiscard]] size_t inFlightCount() const { return inFlight.size(); }
+    [[nodiscard]] Stats getStats();
+    void resetStats();
+
+    static unsigned defaultWorkerCount();
+    //shifted as unsigned, a negative chunkX (only a broken message has one) must not be undefined behaviour
+    static long long coordsKey(const int chunkX, const int chunkY)
+    {
+        return static_cast<long long>(static_cast<unsigned long long>(static_cast<unsigned>(chunkX)) << 32 | static_cast<unsigned>(chunkY));
+    }
+
+private:
+    struct Job
+    {
+        Format format;
+        std::string payload;
+        size_t wireBytes;
+        int chunkX, chunkY; //peeked on submit so tile updates can tell the chunk is on its way
+        std::unique_ptr<Chunk> result;
+        std::atomic<bool> done{false};
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex jobMutex;
+    std::condition_variable jobCondition;
+    std::deque<Job*> jobQueue; //waiting for a worker, owned by inFlight
+    bool stopping = false;
+
+    std::deque<std::unique_ptr<Job>> inFlight;           //main thread only, submit order
+    std::unordered_map<long long, int> pendingByCoords;  //main thread only
+
+    std::mutex statsMutex;
+    Stats stats;
+
+    void workerLoop();
+    void decode(Job& job);
+    void releasePending(int chunkX, int chunkY);
+};
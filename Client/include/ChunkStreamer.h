@@ -0,0 +1,64 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "World.h"
+
+//inclusive rect of chunk coords, bottom-up like the server's
+struct ChunkRect
+{
+    int minX = 0, minY = 0, maxX = -1, maxY = -1;
+
+    [[nodiscard]] bool contains(const int cx, const int cy) const { return cx >= minX && cx <= maxX && cy >= minY && cy <= maxY; }
+    [[nodiscard]] bool empty() const { return maxX < minX || maxY < minY; }
+    [[nodiscard]] ChunkRect grown(int by) const; //clamped to the world
+    bool operator==(const ChunkRect& o) const { return minX == o.minX && minY == o.minY && maxX == o.maxX && maxY == o.maxY; }
+    bool operator!=(const ChunkRect& o) const { return !(*this == o); }
+};
+
+//picks which chunks to ask for when the server streams them on request instead of pushing the whole world.
+//the view (plus a margin) goes first nearest to its centre, the rest of the world trickles in once thats loaded.
+//requests in flight are capped so the socket never fills up with chunks nobody is looking at. main thread only
+class ChunkStreamer
+{
+public:
+    using ChunkCoord = std::pair<int, int>;
+
+    static constexpr int MAX_IN_FLIGHT = 12;
+    static constexpr int VIEW_MARGIN = 1;
+    static constexpr int BACKGROUND_PER_STEP = 2;
+    static constexpr std::chrono::milliseconds BACKGROUND_INTERVAL{50};
+    static constexpr std::chrono::milliseconds REQUEST_TIMEOUT{3000}; //asked again if it never turns up
+
+    struct Stats
+    {
+        uint64_t requested = 0;
+        uint64_t received = 0;
+        uint64_t rerequested = 0;
+        uint64_t unrequested = 0; //arrived without being asked for, bulk pushes land here
+    };
+
+    void reset();
+    //appends the chunks to request now to out, nearest first
+    void update(const ChunkRect& view, std::chrono::steady_clock::time_point now, std::vector<ChunkCoord>& out);
+    void onChunkReceived(int cx, int cy);
+    [[nodiscard]] bool isLoaded(const ChunkRect& rect) const;
+    [[nodiscard]] int inFlightCount() const { return inFlight; }
+    [[nodiscard]] const Stats& getStats() const { return stats; }
+
+private:
+    enum class State : uint8_t { MISSING, REQUESTED, LOADED };
+    static constexpr int CHUNK_COUNT = World::WORLD_WIDTH_IN_CHUNKS * World::WORLD_HEIGHT_IN_CHUNKS;
+
+    std::array<State, CHUNK_COUNT> states{};
+    std::array<std::chrono::steady_clock::time_point, CHUNK_COUNT> requestedAt{};
+    int inFlight = 0;
+    std::chrono::steady_clock::time_point nextBackground;
+    Stats stats;
+
+    static int indexOf(int cx, int cy);
+    void request(const ChunkRect& area, const ChunkRect& view, int budget, std::chrono::steady_clock::time_point now, std::vector<ChunkCoord>& out);
+};
@@ -0,0 +1,71 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+//estimates the server clock from timestamped PING/PONG probes.
+//one probe puts the server stamp at the midpoint of its round trip, which is off by at most rtt/2, and queueing
+//only ever adds delay, so the lowest rtt probe of the last few is the one kept. a least squares line through the
+//kept ones gives the drift between the two clocks once they span long enough to measure it
+class ClockSync
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t FILTER_WINDOW = 8; //raw probes the lowest rtt one is picked from
+    static constexpr size_t FIT_WINDOW = 32;   //kept probes the offset/drift line is fitted through
+    static constexpr std::chrono::seconds MIN_DRIFT_SPAN{20}; //drift reads as 0 until the fitted probes cover this much
+    static constexpr int64_t FIT_RTT_SLACK_NS = 1000000;      //fitted probes are within 1.5x + 1ms of the best rtt
+    static constexpr double MAX_DRIFT_PPM = 1000.0;           //anything past this is noise, real clocks are within ~100
+    static constexpr size_t FAST_PROBES = 8;                  //probed quickly after connecting so it syncs in under a second
+    static constexpr std::chrono::milliseconds FAST_PROBE_INTERVAL{100};
+    static constexpr std::chrono::milliseconds PROBE_INTERVAL{1000};
+
+    struct Estimate
+    {
+        bool synced = false;
+        double offsetUs = 0.0; //server minus local, now
+        double driftPpm = 0.0; //how fast the server clock runs ahead of ours
+        double bestRttMs = 0.0; //of the probe the current offset rests on
+        uint64_t probes = 0;
+    };
+
+    void reset();
+    //receive thread. sent and received are local steady clock ns, serverUs is the server's clock when it answered
+    void addProbe(int64_t sentNs, int64_t receivedNs, int64_t serverUs);
+    //until the next probe should go out, counted in probes sent so a server that never stamps isnt probed fast forever
+    static std::chrono::milliseconds probeInterval(const uint32_t probesSent)
+    {
+        return probesSent < FAST_PROBES ? FAST_PROBE_INTERVAL : PROBE_INTERVAL;
+    }
+
+    //until the first probe answers (or against a server that doesnt stamp PONG) these assume no offset
+    [[nodiscard]] bool isSynced() const;
+    [[nodiscard]] int64_t serverNowUs() const { return toServerUs(Clock::now()); }
+    [[nodiscard]] int64_t toServerUs(Clock::time_point local) const;
+    [[nodiscard]] Clock::time_point toLocal(int64_t serverUs) const;
+    [[nodiscard]] Estimate estimate() const;
+
+private:
+    struct Probe
+    {
+        int64_t localNs; //midpoint of the round trip
+        double offsetUs;
+        int64_t rttNs;
+    };
+
+    mutable std::mutex mutex;
+    std::deque<Probe> recent; //last FILTER_WINDOW raw probes
+    std::deque<Probe> kept;   //lowest rtt picks, oldest first
+    uint64_t probes = 0;
+
+    //offset(t) = offsetUs + driftPpm * (t - refNs) / 1e9, refit whenever a probe is kept
+    int64_t refNs = 0;
+    double offsetUs = 0.0;
+    double driftPpm = 0.0;
+    double bestRttMs = 0.0;
+
+    void refit();
+    [[nodiscard]] double offsetAt(int64_t localNs) const;
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+//bump allocator for memory that only lives until the end of one processNetworkMessages call: the parsed
+//ITEM_DEF_SYNC list before it reaches the registry, the tile list of an UPDATE_REGION and the encoded CHUNK_REQUEST list.
+//INV_SYNC and the other lists are walked in place and never allocate. a normal frame is served from one fixed block and
+//never touches the heap, a frame that needs more spills over to new/delete and the extra is freed on reset
+class FrameArena : public std::pmr::memory_resource
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    FrameArena() : block(new std::byte[BLOCK_SIZE]), arena(block.get(), BLOCK_SIZE, std::pmr::new_delete_resource()) {}
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    //what transient containers should allocate from, plain new/delete when the arena is switched off
+    std::pmr::memory_resource* resource() { return enabled ? static_cast<std::pmr::memory_resource*>(this) : std::pmr::new_delete_resource(); }
+
+    //everything handed out since the last reset is gone after this
+    void reset()
+    {
+        arena.release();
+        if (frameBytes > highWater) highWater = frameBytes;
+        frameBytes = 0;
+    }
+
+    void setEnabled(const bool on) { enabled = on; }
+    [[nodiscard]] bool isEnabled() const { return enabled; }
+    [[nodiscard]] size_t highWaterBytes() const { return highWater; } //most one frame has used, over BLOCK_SIZE means it spilled
+
+private:
+    std::unique_ptr<std::byte[]> block;
+    std::pmr::monotonic_buffer_resource arena;
+    bool enabled = true;
+    size_t frameBytes = 0;
+    size_t highWater = 0;
+
+    void* do_allocate(const size_t bytes, const size_t alignment) override
+    {
+        frameBytes += bytes;
+        return arena.allocate(bytes, alignment);
+    }
+    void do_deallocate(void*, size_t, size_t) override {} //freed all at once by reset
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
@@ -1,35 +1,78 @@
 #pragma once
 #include <SDL_ttf.h>
-#include <mutex>
-#include <queue>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <thread>
 #include <map>
+#include <unordered_map>
 #include <vector>
+#include <string_view>
 
 #include "Player.h"
 #include "World.h"
 #include "Camera.h"
 #include "Inventory.h"
 #include "ParticleManager.h"
+#include "MessageQueue.h"
+#include "Messages.h"
+#include "ChunkDecoder.h"
+#include "ChunkStreamer.h"
+#include "NetTelemetry.h"
+#include "FrameArena.h"
 
 class Network;
 
 class Game
 {
 public:
-    Game();
+    explicit Game(bool headless = false); //headless skips fonts, audio and effects, for the load test bot
     ~Game();
 
     void setNetwork(Network* n) { network = n; }
-    void pushNetworkMessage(const std::string& msg); //called from network thread
+    bool pushNetworkMessage(std::string_view msg, const std::atomic<bool>& keepWaiting); //called from network thread
+    bool pushDatagram(std::string_view payload) { return incomingDatagrams.tryPush(payload); } //called from the udp thread, never blocks
     void processNetworkMessages();                   //called from main thread
     void handleInput(const SDL_Event& e);            //called from main thread
     void render(SDL_Renderer* renderer);
     void renderInventory(SDL_Renderer* renderer, int winW, int winH) const;
     int getSlotIndexAt(int mouseX, int mouseY, int winW, int winH) const;
     void update();
+    //movement keys go out as one INPUT_STATE per input tick, only when they changed
+    void setInputKey(uint8_t bit, bool down);
+    void sampleInput(std::chrono::steady_clock::time_point now);
+    //sends VIEW and chunk requests when the server streams chunks, also times the first full screen either way
+    void updateChunkStreaming(std::chrono::steady_clock::time_point now);
+    //keep the world through the next ASSIGN_ID so a reconnect only has to fetch what changed
+    void prepareResume(const bool resume) { resuming = resume; }
+    //after the network threads are gone, drops what the old connection left queued or decoding so none of it lands in the next session
+    void discardSession();
+    [[nodiscard]] std::vector<HeldChunk> getHeldChunks() const { return world ? world->heldChunks() : std::vector<HeldChunk>{}; }
 
     int getLocalPlayerId() const { return localPlayerId; }
+    bool getPlayerPosition(int id, float& x, float& y) const;
+    double getWorldLoadMs() const { return joinBurst.completedMs; } //ASSIGN_ID until the last chunk was installed, -1 until then
+    double getFirstFullScreenMs() const { return joinBurst.firstFullScreenMs; } //ASSIGN_ID until the spawn view was complete
+    //movement key pressed until the server's next position for us came back, what the player feels as lag
+    struct MoveLatency
+    {
+        uint64_t samples = 0;
+        double totalMs = 0.0;
+        double worstMs = 0.0;
+    };
+    const MoveLatency& getMoveLatency() const { return moveLatency; }
+    const MessageQueue& getIncomingQueue() const { return incomingMessages; }
+    size_t getChunksDecoding() const { return chunkDecoder.inFlightCount(); } //submitted but not installed yet
+    //heap allocations made while handling messages, all zero unless built with SWAGARIA_COUNT_ALLOCS
+    struct AllocStats
+    {
+        uint64_t frames = 0;
+        uint64_t total = 0;
+        uint64_t worst = 0;
+    };
+    const AllocStats& getMessageAllocStats() const { return messageAllocs; }
+    void setFrameArenaEnabled(const bool enabled) { frameArena.setEnabled(enabled); } //off to compare against plain new/delete
+    uint64_t getUnknownMessages() const { return unknownMessages; }
     void setLocalPlayerId(const int id) { localPlayerId = id; }
 
     void drawText(SDL_Renderer* renderer, const std::string& text, int x, int y, SDL_Color color) const;
@@ -37,6 +80,7 @@ public:
 
 private:
     Network* network = nullptr;
+    bool headless = false;
     std::unique_ptr<World> world;
     Camera camera = Camera(800, 600);
     TTF_Font* font = nullptr;
@@ -48,13 +92,118 @@ private:
     bool isInventoryOpen = false;
 
     bool isFreecamActive = false;
+    bool isNetOverlayOpen = false;
     float freecamSpeed = 10.0f;
     const float freecamSpeedStep = 5.0f;
     const float minFreecamSpeed = 5.0f;
     const float maxFreecamSpeed = 50.0f;
     std::map<SDL_Keycode, bool> keysHeld;
 
-    std::mutex incomingMutex;
-    std::queue<std::string> incomingMessages;
-    void handleOneNetworkMessage(const std::string& msg);
+    static constexpr std::chrono::milliseconds INPUT_TICK{16}; //same rate the server simulates at
+    uint8_t inputHeld = 0;
+    uint8_t inputLatched = 0; //pressed since the last sample, so a tap shorter than a tick still reaches the server
+    uint8_t inputSent = 0;
+    uint32_t inputSequence = 0;
+    uint64_t inputSamples = 0;
+    std::chrono::steady_clock::time_point lastInputSample;
+    static constexpr int UDP_INPUT_REPEATS = 3; //extra copies of a changed state over UDP, the server drops the duplicates
+    int inputRepeats = 0;
+
+    static constexpr std::chrono::seconds MOVE_PROBE_TIMEOUT{1}; //a press against a wall never moves us
+    bool moveProbePending = false;
+    std::chrono::steady_clock::time_point moveProbeSent;
+    MoveLatency moveLatency;
+
+    MessageQueue incomingMessages;
+    MessageQueue incomingDatagrams{256}; //MOVE_BATCH payloads from the udp thread, its own queue since each one has a single producer
+    FrameArena frameArena; //reset at the end of every processNetworkMessages
+    AllocStats messageAllocs;
+
+    //chunk payloads are decoded off the main thread and installed a few per frame
+    static constexpr size_t CHUNK_INSTALL_BUDGET = 32;
+    ChunkDecoder chunkDecoder;
+
+    struct TileUpdate
+    {
+        int worldX, topDownWorldY, newTileType, layerIndex;
+    };
+    //tile updates for chunks still being decoded, by ChunkDecoder::coordsKey. applied when that chunk lands so they arent lost
+    std::unordered_map<long long, std::vector<TileUpdate>> deferredTileUpdates;
+    static constexpr int MAX_REGION_EFFECTS = 8; //particle bursts per batch, a felled tree shouldnt spawn fifty
+
+    ChunkStreamer chunkStreamer;
+    bool resuming = false;      //set before reconnecting, consumed by the next ASSIGN_ID
+    bool resumePending = false; //held chunks count as loaded once the server confirms RESUME
+    ChunkRect sentView;                  //last VIEW the server got
+    std::vector<ChunkStreamer::ChunkCoord> chunkRequests;
+    int viewWidth = 800, viewHeight = 600; //window size as of the last render, headless keeps the default
+    static ChunkRect chunkRectAt(float cameraX, float cameraY, float zoom, int winW, int winH);
+    [[nodiscard]] ChunkRect targetView() const; //where the camera is heading, not where it is mid-lerp
+
+    //join burst numbers so chunk encodings and frame pacing can be compared between runs
+    struct JoinBurstStats
+    {
+        bool active = false;
+        size_t chunksInstalled = 0;
+        int frames = 0;
+        double worstFrameMs = 0.0;
+        double totalFrameMs = 0.0;
+        double completedMs = -1.0;
+        double firstFullScreenMs = -1.0; //every chunk the spawn view needs is installed
+        std::chrono::steady_clock::time_point started, lastFrame;
+    } joinBurst;
+    //F3 overlay, rates are worked out against the snapshot from a second ago
+    NetTelemetry::Snapshot overlayCurrent, overlayPrevious;
+    std::chrono::steady_clock::time_point overlayRefreshed;
+    void renderNetOverlay(SDL_Renderer* renderer);
+
+    void trackJoinBurstFrame();
+    void installChunk(std::unique_ptr<Chunk> chunk);
+    bool submitChunk(std::string_view msg);
+    void handleOneNetworkMessage(std::string_view msg);
+    void handleBinaryMessage(std::string_view frame);
+
+    //text commands dispatch through this by the opcode they intern to, binary frames with a Messages.def layout
+    //through the second one by their opcode
+    using TextHandler = void (Game::*)(Protocol::TextReader& reader);
+    using BinaryHandler = void (Game::*)(Protocol::BinaryReader& reader);
+    static const std::array<TextHandler, Protocol::OPCODE_COUNT> textHandlers;
+    static const std::array<BinaryHandler, Protocol::OPCODE_COUNT> binaryHandlers;
+    template<typename Reader>
+    static std::array<void (Game::*)(Reader&), Protocol::OPCODE_COUNT> messageHandlers();
+    //decodes one Messages.def message into its struct and hands it to on(), either encoding
+    template<typename Message, typename Reader>
+    void handleMessage(Reader& reader)
+    {
+        Message msg;
+        if (Messages::read(reader, msg)) on(msg);
+    }
+    uint64_t unknownMessages = 0; //text commands and binary opcodes nothing handles
+    void countUnknownMessage(std::string_view msg);
+
+    //shared by the text and binary decoders
+    void on(const Messages::AssignId& msg);
+    void on(const Messages::Spawn& msg);
+    void on(const Messages::PlayerMove& msg);
+    void on(const Messages::PlayerJoin& msg);
+    void on(const Messages::PlayerLeave& msg);
+    void on(const Messages::UpdateTile& msg);
+    void on(const Messages::InvUpdate& msg);
+    void on(const Messages::ItemDefSync& msg);
+    void on(const Messages::UpdateRegion& msg);
+    void on(const Messages::InvSync& msg);
+    //a parsed ITEM_DEF_SYNC entry, name points into the message being handled. the list lives in frameArena,
+    //only the registry copies are kept
+    struct ItemDefEntry
+    {
+        int id = 0;
+        std::string_view name;
+        int maxStack = 1;
+        bool isTile = false;
+        int tileTypeID = 0;
+    };
+    using ItemDefList = std::pmr::vector<ItemDefEntry>;
+    void onItemDefinitions(const ItemDefList& definitions);
+    void onChunkData(std::unique_ptr<Chunk> chunk);
+    void onUpdateRegion(const TileUpdate* updates, size_t count, bool withEffects = true);
 };
\ No newline at end of file
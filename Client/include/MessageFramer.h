@@ -0,0 +1,40 @@
+#pragma once
+#include <string_view>
+#include <vector>
+
+//splits the raw tcp byte stream into messages without copying them, either newline terminated
+//text lines or varint length prefixed binary frames depending on the negotiated protocol.
+//the socket reads straight into the buffer and complete lines are handed out as views into it.
+//only the unfinished tail is ever moved (once per read) and the buffer only grows if a single
+//message is bigger than the whole capacity
+class MessageFramer
+{
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+    static constexpr size_t MIN_READ_SPACE = 4096;
+
+    explicit MessageFramer(size_t capacity = DEFAULT_CAPACITY);
+
+    //make room for the next read and return where to write it
+    char* prepareWrite();
+    [[nodiscard]] size_t writeSpace() const { return buffer.size() - writePos; }
+    void commitWrite(size_t bytes) { writePos += bytes; }
+
+    //returns the next complete line (without \r\n). the view is valid until prepareWrite() is called again
+    bool nextLine(std::string_view& line);
+    //returns the next complete binary frame (without the length prefix), same lifetime rules as nextLine
+    bool nextFrame(std::string_view& frame);
+    //set when a frame header is malformed or claims an impossible size, the stream cant be recovered
+    [[nodiscard]] bool hasError() const { return error; }
+
+    void reset();
+    [[nodiscard]] size_t pendingBytes() const { return writePos - readPos; }
+    [[nodiscard]] size_t capacity() const { return buffer.size(); }
+
+private:
+    std::vector<char> buffer;
+    size_t readPos = 0;  //start of the first unconsumed byte
+    size_t scanPos = 0;  //everything before this has already been searched for '\n'
+    size_t writePos = 0; //end of the received data
+    bool error = false;
+};
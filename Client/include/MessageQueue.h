@@ -0,0 +1,124 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+//bounded lock-free queue between exactly one producer (network thread) and one consumer (main thread).
+//slots are preallocated strings that keep their capacity, so once they have grown to fit the
+//biggest messages (CHUNK_DATA) pushing a message is just a memcpy
+class MessageQueue
+{
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1024; //must be a power of two
+    static constexpr size_t SLOT_RESERVE = 256;
+
+    explicit MessageQueue(const size_t capacity = DEFAULT_CAPACITY) : slots(capacity), mask(capacity - 1)
+    {
+        for (std::string& slot : slots)
+            slot.reserve(SLOT_RESERVE);
+    }
+
+    //producer only. returns false if the queue is full
+    bool tryPush(const std::string_view msg)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        const size_t h = head.load(std::memory_order_acquire);
+        if (t - h >= slots.size())
+            return false;
+
+        slots[t & mask].assign(msg.data(), msg.size());
+        tail.store(t + 1, std::memory_order_release);
+
+        if (const size_t depth = t + 1 - h; depth > highWater.load(std::memory_order_relaxed))
+            highWater.store(depth, std::memory_order_relaxed);
+        return true;
+    }
+
+    //producer only. waits for the consumer to free a slot instead of dropping the message,
+    //gives up once keepWaiting is cleared so shutdown cant deadlock.
+    //a short spin covers the usual case of the consumer being mid drain, after that it sleeps until drain wakes it
+    bool push(const std::string_view msg, const std::atomic<bool>& keepWaiting)
+    {
+        if (tryPush(msg))
+            return true;
+
+        stalls.fetch_add(1, std::memory_order_relaxed);
+        for (int spin = 0; spin < SPIN_LIMIT && keepWaiting; spin++)
+        {
+            if (tryPush(msg))
+                return true;
+            std::this_thread::yield();
+        }
+
+        std::unique_lock lock(waitMutex);
+        while (keepWaiting)
+        {
+            producerWaiting.store(true, std::memory_order_seq_cst);
+            //pairs with the fence in drain, either it sees producerWaiting or this sees the slot it freed
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (tryPush(msg))
+            {
+                producerWaiting.store(false, std::memory_order_relaxed);
+                return true;
+            }
+            //the timeout is only so a cleared keepWaiting is noticed, nobody notifies for that
+            spaceFreed.wait_for(lock, WAIT_SLICE);
+        }
+        producerWaiting.store(false, std::memory_order_relaxed);
+        return false;
+    }
+
+    //consumer only. hands every message queued so far to the handler, no locks involved.
+    //each slot is given back as soon as its handler returns so the producer can keep going
+    template<typename Handler>
+    size_t drain(Handler&& handler)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        const size_t t = tail.load(std::memory_order_acquire);
+        const size_t count = t - h;
+
+        for (; h != t; ++h)
+        {
+            handler(static_cast<const std::string&>(slots[h & mask]));
+            head.store(h + 1, std::memory_order_release);
+        }
+
+        if (count != 0)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (producerWaiting.load(std::memory_order_relaxed))
+            {
+                std::lock_guard lock(waitMutex); //so the wakeup cant land between the producer checking and waiting
+                spaceFreed.notify_one();
+            }
+        }
+        return count;
+    }
+
+    [[nodiscard]] size_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+    [[nodiscard]] size_t capacity() const { return slots.size(); }
+    [[nodiscard]] size_t highWaterMark() const { return highWater.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t producerStalls() const { return stalls.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int SPIN_LIMIT = 64;
+    static constexpr std::chrono::milliseconds WAIT_SLICE{50};
+
+    std::vector<std::string> slots;
+    const size_t mask;
+
+    alignas(64) std::atomic<size_t> head{0}; //next slot to read, only the consumer moves it
+    alignas(64) std::atomic<size_t> tail{0}; //next slot to write, only the producer moves it
+    alignas(64) std::atomic<size_t> highWater{0};
+    std::atomic<uint64_t> stalls{0};
+
+    //only touched once the ring is full, the fast paths never take the lock
+    std::atomic<bool> producerWaiting{false};
+    std::mutex waitMutex;
+    std::condition_variable spaceFreed;
+};
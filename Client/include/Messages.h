@@ -0,0 +1,275 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "Protocol.h"
+
+//a struct plus text and binary codecs for every message in Messages.def, all expanded at compile time.
+//TextReader/BinaryReader and TextWriter/BinaryWriter share a method name per field type, so one field list
+//drives both encodings and a layout can only change in one place
+namespace Messages
+{
+    //field type -> member type
+    namespace Field
+    {
+        using i32 = int32_t;
+        using u16 = uint16_t;
+        using u8 = uint8_t;
+        using u64 = uint64_t;
+        using i64 = int64_t;
+        using f32 = float;
+        using varint = uint32_t;
+        using str = std::string_view; //points into the message being handled, copy it to keep it
+        using chr = char;
+    }
+
+    //a LIST, LIST_FIELD or ARRAY field. read() leaves the entries where they are in the message, forEach and
+    //readArray decode them from there, so a list costs nothing until it is walked.
+    //to send one, point entries/size at what goes out
+    template<typename Entry>
+    struct List
+    {
+        std::string_view encoded; //views into the message like str fields
+        uint32_t count = 0;       //binary lists and arrays, a text list runs to the end of encoded
+        bool binary = false;
+        char entrySeparator = ',', fieldSeparator = ','; //text only, they differ for a LIST_FIELD
+
+        const Entry* entries = nullptr;
+        uint32_t size = 0;
+    };
+
+#define ENTRY(Name) struct Name {
+#define MESSAGE(Name, op) struct Name { static constexpr Protocol::Opcode OPCODE = Protocol::Opcode::op;
+#define FIELD(type, name) Field::type name{};
+#define OPTIONAL(type, name) std::optional<Field::type> name;
+#define LIST(Entry, name) List<Entry> name;
+#define LIST_FIELD(Entry, name, separator, fieldSeparator) List<Entry> name;
+#define ARRAY(type, name, count) static constexpr uint32_t name##Count = count; List<Field::type> name;
+#define SWITCH(type, name) Field::type name{};
+#define CASE(value)
+#define END_SWITCH
+#define END_ENTRY };
+#define END_MESSAGE };
+#include "Messages.def"
+#undef ENTRY
+#undef MESSAGE
+#undef FIELD
+#undef OPTIONAL
+#undef LIST
+#undef LIST_FIELD
+#undef ARRAY
+#undef SWITCH
+#undef CASE
+#undef END_SWITCH
+#undef END_ENTRY
+#undef END_MESSAGE
+
+    //where a list is in the message, everything left after its count (binary) or after the fields before it (text)
+    template<typename Entry>
+    void locateList(Protocol::BinaryReader& reader, List<Entry>& list, char = ',', char = ',')
+    {
+        list.count = reader.varint();
+        list.binary = true;
+        list.encoded = reader.remainder();
+    }
+
+    template<typename Entry>
+    void locateList(Protocol::TextReader& reader, List<Entry>& list, const char entrySeparator = ',', const char fieldSeparator = ',')
+    {
+        list.entrySeparator = entrySeparator;
+        list.fieldSeparator = fieldSeparator;
+        if (entrySeparator != fieldSeparator)
+        {
+            list.encoded = reader.atEnd() ? std::string_view() : reader.field();
+            return;
+        }
+        list.encoded = reader.remainder();
+        if (!list.encoded.empty() && list.encoded.front() == ',')
+            list.encoded.remove_prefix(1); //INV_SYNC has an empty field in front of its slots
+    }
+
+    template<typename Reader, typename Type>
+    void locateArray(Reader& reader, List<Type>& list, const uint32_t count)
+    {
+        list.count = count;
+        list.binary = std::is_same_v<Reader, Protocol::BinaryReader>;
+        list.encoded = reader.remainder();
+    }
+
+    //the fields after the command name or opcode, false if one is missing or malformed.
+    //trailing fields past the layout are ignored, that is how old clients cope with fields a newer server appended
+#define ENTRY(Name) template<typename Reader> bool read(Reader& reader, Name& msg) {
+#define MESSAGE(Name, op) ENTRY(Name)
+#define FIELD(type, name) msg.name = reader.type();
+#define OPTIONAL(type, name) if (!reader.atEnd()) msg.name = reader.type();
+#define LIST(Entry, name) locateList(reader, msg.name);
+#define LIST_FIELD(Entry, name, separator, fieldSeparator) locateList(reader, msg.name, separator, fieldSeparator);
+#define ARRAY(type, name, count) locateArray(reader, msg.name, count);
+#define SWITCH(type, name) msg.name = reader.type(); switch (msg.name) { default: break;
+#define CASE(value) break; case value:
+#define END_SWITCH }
+#define END_ENTRY return reader.ok(); }
+#define END_MESSAGE END_ENTRY
+#include "Messages.def"
+#undef ENTRY
+#undef MESSAGE
+#undef FIELD
+#undef OPTIONAL
+#undef LIST
+#undef LIST_FIELD
+#undef ARRAY
+#undef SWITCH
+#undef CASE
+#undef END_SWITCH
+#undef END_ENTRY
+#undef END_MESSAGE
+
+    template<typename Entry>
+    void writeList(Protocol::BinaryWriter& writer, const List<Entry>& list, char = ',', char = ',')
+    {
+        writer.varint(list.size);
+        for (uint32_t i = 0; i < list.size; i++)
+            write(writer, list.entries[i]);
+    }
+
+    template<typename Entry>
+    void writeList(Protocol::TextWriter& writer, const List<Entry>& list, const char entrySeparator = ',', const char fieldSeparator = ',')
+    {
+        if (entrySeparator == fieldSeparator)
+        {
+            for (uint32_t i = 0; i < list.size; i++)
+                write(writer, list.entries[i]);
+            return;
+        }
+
+        writer.str({}); //the field the whole list goes in
+        for (uint32_t i = 0; i < list.size; i++)
+        {
+            Protocol::TextWriter entry(writer, entrySeparator, fieldSeparator);
+            write(entry, list.entries[i]);
+        }
+    }
+
+#define ENTRY(Name) template<typename Writer> void write(Writer& writer, const Name& msg) {
+#define MESSAGE(Name, op) ENTRY(Name)
+#define FIELD(type, name) writer.type(msg.name);
+#define OPTIONAL(type, name) if (msg.name) writer.type(*msg.name);
+#define LIST(Entry, name) writeList(writer, msg.name);
+#define LIST_FIELD(Entry, name, separator, fieldSeparator) writeList(writer, msg.name, separator, fieldSeparator);
+#define ARRAY(type, name, count) for (uint32_t i = 0; i < (count); i++) writer.type(i < msg.name.size ? msg.name.entries[i] : Field::type{});
+#define SWITCH(type, name) writer.type(msg.name); switch (msg.name) { default: break;
+#define CASE(value) break; case value:
+#define END_SWITCH }
+#define END_ENTRY }
+#define END_MESSAGE END_ENTRY
+#include "Messages.def"
+#undef ENTRY
+#undef MESSAGE
+#undef FIELD
+#undef OPTIONAL
+#undef LIST
+#undef LIST_FIELD
+#undef ARRAY
+#undef SWITCH
+#undef CASE
+#undef END_SWITCH
+#undef END_ENTRY
+#undef END_MESSAGE
+
+    //hands every entry of a list to f in order, false if one was bad. a bad entry in its own text field is skipped,
+    //anywhere else there is no telling where the next one starts so decoding stops there
+    template<typename Entry, typename F>
+    bool forEach(const List<Entry>& list, F&& f)
+    {
+        if (list.binary)
+        {
+            Protocol::BinaryReader reader(list.encoded);
+            for (uint32_t i = 0; i < list.count; i++)
+            {
+                Entry entry;
+                if (!read(reader, entry)) return false;
+                f(entry);
+            }
+            return true;
+        }
+
+        if (list.entrySeparator != list.fieldSeparator)
+        {
+            bool allRead = true;
+            Protocol::TextReader entries(list.encoded, list.entrySeparator);
+            while (!entries.atEnd())
+            {
+                const std::string_view text = entries.field();
+                if (text.empty()) continue;
+
+                Protocol::TextReader reader(text, list.fieldSeparator);
+                Entry entry;
+                if (read(reader, entry)) f(entry);
+                else allRead = false;
+            }
+            return allRead;
+        }
+
+        Protocol::TextReader reader(list.encoded);
+        while (!reader.atEnd())
+        {
+            Entry entry;
+            if (!read(reader, entry)) return false;
+            f(entry);
+        }
+        return true;
+    }
+
+    //an ARRAY of u16 into out (room for list.count), text goes through the decimal kernels.
+    //returns how many were read, fewer than list.count if the message is short or error is set
+    inline size_t readArray(const List<uint16_t>& list, uint16_t* out, Protocol::ParseError& error)
+    {
+        if (!list.binary)
+        {
+            Protocol::TextReader reader(list.encoded);
+            const size_t read = reader.u16List(out, list.count);
+            error = reader.getError();
+            return read;
+        }
+
+        Protocol::BinaryReader reader(list.encoded);
+        for (uint32_t i = 0; i < list.count; i++)
+        {
+            out[i] = reader.u16();
+            if (!reader.ok())
+            {
+                error = Protocol::ParseError::MISSING_FIELD;
+                return i;
+            }
+        }
+        return list.count;
+    }
+
+    //append one complete message: a frame with its length prefix, or a line with its newline
+    template<typename Message>
+    void encodeBinary(std::string& out, const Message& msg)
+    {
+        Protocol::BinaryWriter writer(out, Message::OPCODE);
+        write(writer, msg);
+        writer.finish();
+    }
+
+    template<typename Message>
+    void encodeText(std::string& out, const Message& msg)
+    {
+        Protocol::TextWriter writer(out, Message::OPCODE);
+        write(writer, msg);
+        writer.finish();
+    }
+
+    //whichever encoding the connection negotiated
+    template<typename Message>
+    void encode(std::string& out, const Message& msg, const bool binary)
+    {
+        if (binary) encodeBinary(out, msg);
+        else encodeText(out, msg);
+    }
+}
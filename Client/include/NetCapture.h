@@ -0,0 +1,55 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//capture files hold the messages exactly as Network handed them to Game, so a replay exercises the same code path.
+//layout: "SWGCAP1\n" then per message: u64 ns since the capture started | u32 length | bytes (all little-endian).
+//a zero length record marks where a reconnect started the next session, no real message is empty
+namespace NetCapture
+{
+    constexpr char MAGIC[] = "SWGCAP1\n";
+    constexpr size_t MAGIC_SIZE = sizeof(MAGIC) - 1;
+    //far above any frame or line the server sends, a bigger length means the file is corrupt
+    constexpr uint32_t MAX_RECORD_SIZE = 16 << 20;
+
+    struct Record
+    {
+        uint64_t timestampNs = 0;
+        std::string data;
+    };
+
+    //written from the receive thread only, flush and close once it is joined.
+    //one file per process: the first open creates it, later ones (every reconnect) append a session marker
+    class Writer
+    {
+    public:
+        bool open(const std::string& path);
+        void record(std::string_view msg);
+        void flush();
+        void close();
+        [[nodiscard]] bool isOpen() const { return file.is_open(); }
+        [[nodiscard]] uint64_t recorded() const { return messages; }
+
+    private:
+        std::ofstream file;
+        std::vector<char> buffer; //big buffer so a join burst isnt thousands of tiny writes
+        std::chrono::steady_clock::time_point started;
+        uint64_t messages = 0;
+        int sessions = 0;
+    };
+
+    class Reader
+    {
+    public:
+        bool open(const std::string& path);
+        bool next(Record& record); //false at the end of the file or on a truncated or corrupt record
+
+    private:
+        std::ifstream file;
+        uint64_t fileSize = 0;
+    };
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <SDL_net.h>
+
+//optional shim between Network's loops and the socket that fakes a bad link: one-way delay, jitter,
+//a bandwidth cap and periodic stalls, applied to each direction on its own. seeded so runs can be repeated
+class NetConditioner
+{
+public:
+    struct Config
+    {
+        int delayMs = 0;         //one way, added to both directions
+        int jitterMs = 0;        //+- uniform, never reorders bytes (its a tcp stream)
+        int bandwidthKBps = 0;   //per direction, 0 = unlimited
+        int stallEveryMs = 0;    //every N ms the link freezes...
+        int stallMs = 0;         //...for this long
+        uint32_t seed = 1;
+
+        [[nodiscard]] bool enabled() const { return delayMs > 0 || jitterMs > 0 || bandwidthKBps > 0 || (stallEveryMs > 0 && stallMs > 0); }
+
+        //--net-delay/--net-jitter/--net-bandwidth/--net-stall-every/--net-stall/--net-seed <n>,
+        //or --net-config <file> with one key=value per line (delay_ms, jitter_ms, bandwidth_kbps, stall_every_ms, stall_ms, seed)
+        static Config fromArgs(int argc, char* argv[]);
+        bool set(const std::string& key, int value);
+    };
+
+    struct Stats
+    {
+        uint64_t segments = 0;
+        uint64_t bytes = 0;
+        uint64_t totalDelayUs = 0;
+        uint64_t maxDelayUs = 0;
+        uint64_t stalledSegments = 0;
+    };
+
+    NetConditioner(TCPsocket socket, const Config& config);
+    ~NetConditioner();
+
+    //same contract as SDLNet_TCP_Send/Recv, returns <= 0 once the link is closed
+    int send(const char* data, int len);
+    int receive(char* dest, int space);
+
+    void shutdown(); //wakes everything blocked on the delay lines, call before closing the socket
+    void logStats() const;
+
+private:
+    static constexpr size_t SEGMENT_SIZE = 1460; //paced per tcp sized segment so a big write doesnt arrive all at once
+
+    //bytes in flight one way, each segment becomes visible on the far side at its release time
+    class DelayLine
+    {
+    public:
+        DelayLine(const Config& config, uint32_t seed, std::chrono::steady_clock::time_point epoch);
+
+        void push(const char* data, size_t len);
+        size_t pop(char* dest, size_t space); //blocks until the head is due, 0 once closed and empty
+        bool waitForDue(std::string& out);    //blocks until a segment is due, moves it out
+        void close(bool abort); //abort drops whatever is still in flight, otherwise it drains first
+        [[nodiscard]] Stats getStats() const;
+
+    private:
+        struct Segment
+        {
+            std::chrono::steady_clock::time_point release;
+            std::string bytes;
+            size_t offset = 0;
+        };
+
+        const Config& config;
+        const std::chrono::steady_clock::time_point epoch;
+        std::mt19937 rng;
+
+        mutable std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<Segment> segments;
+        std::chrono::steady_clock::time_point linkFreeAt; //end of the previous segment's serialisation
+        std::chrono::steady_clock::time_point lastRelease;
+        bool closed = false;
+        bool aborted = false;
+        Stats stats;
+
+        std::chrono::steady_clock::time_point releaseTime(size_t bytes);
+        std::chrono::steady_clock::time_point skipStall(std::chrono::steady_clock::time_point t, bool& stalled) const;
+        bool waitForHead(std::unique_lock<std::mutex>& lock);
+    };
+
+    TCPsocket socket;
+    Config config;
+    DelayLine uplink;
+    DelayLine downlink;
+    std::thread uplinkThread;   //delay line -> socket
+    std::thread downlinkThread; //socket -> delay line
+
+    void uplinkLoop();
+    void downlinkLoop();
+};
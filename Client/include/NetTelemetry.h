@@ -0,0 +1,105 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "Protocol.h"
+
+//per opcode traffic, parse cost, queue depths and round trip time for one connection.
+//every counter is a relaxed atomic so the network threads and the main thread can record without locking
+class NetTelemetry
+{
+public:
+    struct OpcodeCounters
+    {
+        uint64_t messagesIn = 0;
+        uint64_t bytesIn = 0;
+        uint64_t parseNs = 0;
+        uint64_t parsed = 0; //messages parseNs covers
+        uint64_t parseAllocs = 0; //heap allocations while handling them, 0 unless built with SWAGARIA_COUNT_ALLOCS
+        uint64_t messagesOut = 0;
+        uint64_t bytesOut = 0;
+    };
+
+    struct Snapshot
+    {
+        std::array<OpcodeCounters, Protocol::OPCODE_COUNT> opcodes{};
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+        uint64_t rttSamples = 0;
+        double lastRttMs = 0.0;
+        double minRttMs = 0.0;
+        double maxRttMs = 0.0;
+        double smoothedRttMs = 0.0;
+        size_t sendQueueDepth = 0;
+        size_t maxSendQueueDepth = 0;
+        size_t receiveQueueDepth = 0;
+        size_t maxReceiveQueueDepth = 0;
+        uint64_t wakeups = 0;
+        double elapsedSeconds = 0.0;
+    };
+
+    NetTelemetry() { reset(); }
+
+    void reset();
+
+    void recordIn(Protocol::Opcode opcode, size_t wireBytes);
+    void recordOut(Protocol::Opcode opcode, size_t wireBytes);
+    void recordParse(Protocol::Opcode opcode, uint64_t ns, uint64_t allocations = 0);
+    void recordSendQueueDepth(size_t depth);
+    void recordReceiveQueueDepth(size_t depth);
+    void recordWakeup() { wakeups.fetch_add(1, std::memory_order_relaxed); } //every time a network thread comes out of a blocking call
+
+    //called by the send thread right before the PING goes out, and by the receive thread on the PONG.
+    //recordPong gives back when that PING went out (steady clock ns), 0 if it was unknown or already answered
+    void recordPingSent(uint32_t sequence);
+    int64_t recordPong(uint32_t sequence);
+
+    [[nodiscard]] Snapshot snapshot() const;
+
+    //appends one JSON object per line to path every interval, call once per frame from the main thread
+    void setDumpFile(const std::string& path, std::chrono::milliseconds interval);
+    void dumpIfDue();
+    static void writeJson(std::ostream& out, const Snapshot& snap);
+    //cost per message and messages per second each opcode's handler could keep up with, from the parses recorded so far
+    static void logParseRates(const Snapshot& snap);
+
+private:
+    struct AtomicCounters
+    {
+        std::atomic<uint64_t> messagesIn{0};
+        std::atomic<uint64_t> bytesIn{0};
+        std::atomic<uint64_t> parseNs{0};
+        std::atomic<uint64_t> parsed{0};
+        std::atomic<uint64_t> parseAllocs{0};
+        std::atomic<uint64_t> messagesOut{0};
+        std::atomic<uint64_t> bytesOut{0};
+    };
+    std::array<AtomicCounters, Protocol::OPCODE_COUNT> opcodes;
+
+    static constexpr size_t PING_SLOTS = 16; //pings older than this many probes are treated as lost
+    std::array<std::atomic<int64_t>, PING_SLOTS> pingSentNs;
+    std::atomic<uint64_t> rttSamples{0};
+    std::atomic<uint64_t> lastRttUs{0};
+    std::atomic<uint64_t> minRttUs{0};
+    std::atomic<uint64_t> maxRttUs{0};
+    std::atomic<uint64_t> smoothedRttUs{0}; //only written by the receive thread
+
+    std::atomic<size_t> sendQueueDepth{0};
+    std::atomic<size_t> maxSendQueueDepth{0};
+    std::atomic<size_t> receiveQueueDepth{0};
+    std::atomic<size_t> maxReceiveQueueDepth{0};
+    std::atomic<uint64_t> wakeups{0};
+
+    std::atomic<int64_t> startedNs{0};
+
+    std::ofstream dumpFile;
+    std::chrono::milliseconds dumpInterval{0};
+    std::chrono::steady_clock::time_point nextDump;
+
+    static int64_t nowNs();
+    static void raiseMax(std::atomic<size_t>& max, size_t value);
+};
@@ -2,37 +2,291 @@
 #include <thread>
 #include <atomic>
 #include <mutex>
-#include <queue>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <memory_resource>
+#include <string>
 #include <SDL_net.h>
 
+#include "ChunkStreamer.h"
+#include "ClockSync.h"
+#include "MessageFramer.h"
+#include "NetCapture.h"
+#include "NetConditioner.h"
+#include "NetTelemetry.h"
+#include "Protocol.h"
+
 class Game;
 class World;
 
+//counters for the outgoing side, written by the send thread only
+struct SendStats
+{
+    uint64_t flushes = 0;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    uint64_t largestBatch = 0;
+    uint64_t totalQueueWaitUs = 0;
+    uint64_t maxQueueWaitUs = 0;
+};
+
+//counters for the incoming side, written by the receive thread only
+struct ReceiveStats
+{
+    uint64_t reads = 0;
+    uint64_t bytes = 0;
+    uint64_t messages = 0;
+    uint64_t framingNs = 0;
+    size_t largestBuffer = 0;
+};
+
+//what happened to messages on their way into the send queue, guarded by the send lock
+struct SendQueueStats
+{
+    uint64_t merged = 0;       //replaced by a newer message for the same thing still waiting (INV_MOVE_ITEM per slot, VIEW)
+    uint64_t deduplicated = 0; //the same USE_ITEM was already waiting
+    uint64_t dropped = 0;      //optional message turned away because the queue was full
+    size_t maxDepth = 0;
+};
+
+//the UDP side channel for one connection
+struct UdpStats
+{
+    bool active = false;       //server datagrams are arriving and it was told so, movement is going over it
+    uint64_t fallbacks = 0;    //times it went quiet and movement went back to TCP
+    uint64_t datagramsIn = 0;
+    uint64_t datagramsOut = 0;
+    uint64_t movesIn = 0;
+    uint64_t staleDropped = 0; //arrived after a newer tick
+    uint64_t queueDropped = 0; //Game's datagram queue was full
+};
+
+//what pollConnect() reports back to the menu each frame
+enum class ConnectEvent { NONE, CONNECTING, CONNECTED, FAILED, TIMED_OUT };
+
+//SDL_NET: blocking SDL_net socket driven by a receive and a send thread (works everywhere).
+//EPOLL: one non-blocking socket driven by a single epoll thread (linux only)
+enum class NetBackend { SDL_NET, EPOLL };
+
 class Network
 {
 public:
+    static constexpr std::chrono::milliseconds DEFAULT_CONNECT_TIMEOUT{5000};
+    //optional messages (USE_ITEM, chunk requests) are dropped once this many are waiting, the handshake and state
+    //changes are never dropped. past the backlog mark Game should hold optional traffic back itself
+    static constexpr size_t MAX_SEND_QUEUE = 256;
+    static constexpr size_t SEND_BACKLOG = MAX_SEND_QUEUE / 2;
+
     Network();
     ~Network();
 
-    bool connectToServer(const std::string& host, int port);
+    bool connectToServer(const std::string& host, int port); //blocking
+    //resolve + connect on a background thread so the ui keeps rendering, poll the result once per frame
+    void beginConnect(const std::string& host, int port, std::chrono::milliseconds timeout = DEFAULT_CONNECT_TIMEOUT);
+    ConnectEvent pollConnect();
+    void cancelConnect();
+    [[nodiscard]] const std::string& getConnectError() const { return connectError; }
     void disconnect();
     void queueMessage(const std::string& msg);
     [[nodiscard]] bool isConnected() const { return connected; }
+    [[nodiscard]] bool isBinaryProtocol() const { return binaryReceive; }
+    //ask v2 servers for chunks on request instead of the whole world at join, from the next connection on
+    void setChunkStreaming(const bool enabled) { chunkStreamingWanted = enabled; }
+    [[nodiscard]] bool isStreamingChunks() const { return streamingChunks; }
+    //chunks the client still holds from a dropped session, offered to the server once on the next connection
+    void setResumeChunks(std::vector<HeldChunk> held);
+    [[nodiscard]] bool isResumed() const { return resumed; }
+    //movement and input over UDP next to the TCP connection, from the next connection on.
+    //stays on TCP if the server doesnt offer it or the datagrams never get through
+    void setUdpEnabled(const bool enabled) { udpWanted = enabled; }
+    [[nodiscard]] bool isUdpActive() const { return udpReady; }
+    [[nodiscard]] UdpStats getUdpStats() const;
+
+    //typed senders, encoded as text or binary depending on what was negotiated
+    void sendInput(int playerId, const std::string& action);
+    //one sampled InputBits state, text servers get the key edges between previous and held as INPUT lines instead
+    void sendInputState(uint32_t sequence, uint8_t held, uint8_t previous, int playerId);
+    void sendUseItem(int slotIndex, int tileX, int tileY);
+    void sendInvMoveItem(int slotIndex, int itemID, int quantity);
+    void sendView(const ChunkRect& view);
+    //scratch holds the encoded list until it is queued, Game passes its frame arena
+    void sendChunkRequests(const std::vector<ChunkStreamer::ChunkCoord>& chunks, std::pmr::memory_resource* scratch = std::pmr::new_delete_resource());
+    [[nodiscard]] SendStats getSendStats();
+    [[nodiscard]] SendQueueStats getSendQueueStats();
+    [[nodiscard]] bool isSendBacklogged() const { return sendBacklogged; } //the socket isnt keeping up
+    [[nodiscard]] ReceiveStats getReceiveStats();
+    [[nodiscard]] NetTelemetry& getTelemetry() { return telemetry; }
+    //server time estimate, fed by the PING/PONG probes and reset for every connection
+    [[nodiscard]] const ClockSync& getClock() const { return clock; }
+
+    //both take effect from the next connection, the conditioner always runs on the SDL_net backend
+    void setConditioner(const NetConditioner::Config& config) { conditionerConfig = config; }
+    void setBackend(NetBackend backend);
+    static NetBackend defaultBackend();
+    static const char* backendName(NetBackend backend) { return backend == NetBackend::EPOLL ? "epoll" : "SDL_net"; }
+
+    //capture records every message handed to Game from the next connection on, replay plays one back with no socket
+    void setCaptureFile(const std::string& path) { capturePath = path; }
+    bool startReplay(const std::string& path, bool fast);
+    [[nodiscard]] bool isReplaying() const { return replaying; }
 
     void setGame(Game* g) { game = g; }
     void setWorld(World* w) { world = w; }
 
 private:
+    //whatever the connect thread opened, an SDL_net socket or a raw fd for the epoll backend
+    struct OpenedSocket
+    {
+        TCPsocket socket = nullptr;
+        int fd = -1;
+        IPaddress address{}; //what the host resolved to, the UDP channel talks to the same machine
+        explicit operator bool() const { return socket || fd >= 0; }
+    };
+
+    //shared with the connect thread, which can outlive the attempt if it gets cancelled or times out
+    struct ConnectAttempt
+    {
+        std::mutex mutex;
+        bool finished = false;
+        bool abandoned = false; //nobody wants the socket anymore, the connect thread closes it
+        OpenedSocket socket;
+        std::string error;
+    };
+
+    struct PendingMessage
+    {
+        std::string data;
+        std::chrono::steady_clock::time_point queuedAt;
+        bool binary = false; //encoding it was framed with, so the sender can tell its opcode
+        uint64_t coalesceKey = 0; //0 never merges
+        uint64_t reads = 0;       //SendRule::reads it was queued with
+    };
+
+    //how a new message treats one with the same key that is still waiting to be flushed
+    enum class Coalesce { NONE, REPLACE, DEDUPE };
+    struct SendRule
+    {
+        Coalesce coalesce = Coalesce::NONE;
+        uint64_t key = 0;
+        bool droppable = false; //can be turned away when the queue is full
+        uint64_t reads = 0;     //key of the state this message acts on (USE_ITEM reads its slot), nothing merges across a change to it
+    };
+
     TCPsocket socket = nullptr;
+    NetBackend preferredBackend = defaultBackend();
+    NetBackend activeBackend = NetBackend::SDL_NET;
+    NetConditioner::Config conditionerConfig;
+    std::unique_ptr<NetConditioner> conditioner; //only while a connection is conditioned
+    std::string capturePath;
+    NetCapture::Writer capture;             //receive side only, flushed once the threads are joined and closed with the Network
+    bool replaying = false;                 //only changes while the session threads arent running
     std::thread recvThread;
     std::thread sendThread;
+#ifdef __linux__
+    int socketFd = -1;
+    int wakeFd = -1;                        //eventfd the epoll thread waits on next to the socket
+    std::atomic<bool> wakePending{false};   //set while a wakeup is already on its way
+    std::thread reactorThread;
+#endif
     std::atomic<bool> connected{false};
-    std::queue<std::string> sendQueue;
+    std::vector<PendingMessage> sendQueue;  //bounded by MAX_SEND_QUEUE for droppable messages
     std::mutex sendMutex;
+    SendQueueStats sendQueueStats;          //guarded by sendMutex
+    std::atomic<bool> sendBacklogged{false};
+    std::condition_variable sendCondition;
+    MessageFramer framer;
+    bool binarySend = false;                //guarded by sendMutex
+    bool pingEnabled = false;               //guarded by sendMutex, only servers that know PING get one
+    uint32_t pingSequence = 0;              //send thread only
+    std::atomic<bool> binaryReceive{false}; //only flipped by the receive thread
+    bool chunkStreamingWanted = true;
+    std::atomic<bool> streamingChunks{false}; //server acked STREAM, set by the receive thread
+    std::vector<HeldChunk> resumeChunks;      //guarded by sendMutex
+    std::atomic<bool> resumed{false};         //server acked RESUME, set by the receive thread
+
+    //UDP side channel, started by the receive thread on UDP_OFFER and stopped with the connection
+    //hellos go out every UDP_HELLO_INTERVAL until one is answered, then every UDP_KEEPALIVE_INTERVAL so the server
+    //and any NAT in between keep the mapping. UDP_SILENCE_TIMEOUT without a datagram either way drops back to TCP
+    static constexpr int UDP_HELLO_ATTEMPTS = 20;
+    static constexpr std::chrono::milliseconds UDP_HELLO_INTERVAL{250};
+    static constexpr std::chrono::milliseconds UDP_KEEPALIVE_INTERVAL{1000};
+    static constexpr std::chrono::milliseconds UDP_SILENCE_TIMEOUT{5000};
+    static constexpr int UDP_POLL_MS = 50;
+    bool udpWanted = false;
+    IPaddress serverAddress{};
+    UDPsocket udpSocket = nullptr;
+    IPaddress udpServer{};
+    uint64_t udpToken = 0;
+    std::thread udpThread;
+    std::atomic<bool> udpRunning{false};
+    std::atomic<bool> udpReady{false}; //only set once UDP_READY 1 is queued, so the server never expects input we dont send
+    std::mutex udpSendMutex; //the send packet is shared by the main thread (input) and the udp thread (hello)
+    UDPpacket* udpSendPacket = nullptr;
+    std::atomic<uint64_t> udpDatagramsIn{0}, udpDatagramsOut{0}, udpMovesIn{0}, udpStaleDropped{0}, udpQueueDropped{0}, udpFallbacks{0};
+
+    std::mutex statsMutex;
+    SendStats sendStats;
+    ReceiveStats receiveStats;
+    NetTelemetry telemetry;
+    ClockSync clock;
+
+    std::shared_ptr<ConnectAttempt> connectAttempt; //main thread only
+    std::chrono::steady_clock::time_point connectDeadline;
+    std::string connectError;
 
     Game* game = nullptr;
     World* world = nullptr;
 
+    NetBackend connectBackend() const;
+    static OpenedSocket openSocket(const std::string& host, int port, NetBackend backend, std::string& error);
+    static void closeOpened(OpenedSocket& opened);
+    void startSession(const OpenedSocket& opened);
+    int readSocket(char* dest, int space);
+    int writeSocket(const char* data, int len);
     void receiveLoop();
+    void replayLoop(NetCapture::Reader reader, bool fast);
     void sendLoop();
-};
\ No newline at end of file
+    void wakeSender();   //wakes the sender whatever state its in, used for shutdown
+    void notifySender(); //new messages were queued
+    PendingMessage* admitMessage(const SendRule& rule); //sendMutex held, null if the message shouldnt be queued
+    void takeSendQueue(std::vector<PendingMessage>& batch); //sendMutex held
+
+    //shared by both backends
+    bool consumeReceived(size_t bytes, bool newRead);
+    bool addPingIfDue(std::vector<PendingMessage>& batch, std::chrono::steady_clock::time_point& nextPing);
+    void recordBatch(const std::vector<PendingMessage>& batch, size_t bytes, bool pingInBatch);
+    void logSessionSummary();
+
+#ifdef __linux__
+    static int openFd(const IPaddress& ip, std::string& error);
+    bool startReactor();
+    void stopReactor();
+    void reactorLoop();
+#endif
+    bool handleHandshake(std::string_view line);
+    bool handleUdpOffer(std::string_view msg);
+    void startUdp(uint16_t port, uint64_t token);
+    void stopUdp();
+    void udpLoop();
+    bool sendDatagram(Protocol::Opcode opcode, std::string_view fields);
+    void setUdpReady(bool ready);
+    bool handlePong(std::string_view msg);
+    void appendPing(std::vector<PendingMessage>& batch);
+    static Protocol::Opcode framedOpcode(const PendingMessage& msg);
+
+    //encode under the send lock so the text/binary switch can never reorder messages
+    template<typename Encoder>
+    void queueEncoded(Encoder&& encode, const SendRule& rule = {})
+    {
+        {
+            std::lock_guard lock(sendMutex);
+            PendingMessage* msg = admitMessage(rule);
+            if (!msg)
+                return;
+            encode(binarySend, msg->data);
+        }
+        notifySender();
+    }
+};
@@ -0,0 +1,604 @@
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+//wire format shared by the text (v1) and binary (v2) encodings.
+//v1 is the original comma separated lines, v2 frames are: varint length | opcode | little-endian fields.
+//the server advertises its version in ASSIGN_ID, the client answers with PROTO and both sides switch
+//to binary once the server has replied with PROTO_ACK
+namespace Protocol
+{
+    constexpr int TEXT_VERSION = 1;
+    constexpr int BINARY_VERSION = 2;
+    constexpr size_t MAX_FRAME_SIZE = 1 << 20;
+    constexpr size_t MAX_VARINT_BYTES = 5;
+    //optional feature flags appended to PROTO, the server echoes the ones it accepted in PROTO_ACK.
+    //STREAM: chunks are sent on request. RESUME: CHUNK_HASHES follows PROTO and only changed chunks are resent.
+    //UDP: the server follows PROTO_ACK with UDP_OFFER, movement goes over datagrams once the client answers UDP_READY
+    constexpr std::string_view STREAM_FEATURE = "STREAM";
+    constexpr std::string_view RESUME_FEATURE = "RESUME";
+    constexpr std::string_view UDP_FEATURE = "UDP";
+
+    //UDP side channel. client -> server datagrams are: u64 token | opcode | fields,
+    //server -> client ones are: u32 tick sequence | opcode | fields. anything older than the newest tick seen is stale
+    constexpr size_t MAX_DATAGRAM_SIZE = 1200; //stays under any sane path MTU
+    constexpr size_t CLIENT_DATAGRAM_HEADER = 8;
+    constexpr size_t SERVER_DATAGRAM_HEADER = 4;
+
+    //opcodes stay below 0x20 so a binary frame can never be mistaken for a text command
+    enum class Opcode : uint8_t
+    {
+        //server -> client
+        ASSIGN_ID = 0x01,
+        SPAWN = 0x02,
+        ITEM_DEF_SYNC = 0x03,
+        PLAYER_MOVE = 0x04,
+        PLAYER_JOIN = 0x05,
+        PLAYER_LEAVE = 0x06,
+        CHUNK_DATA = 0x07,
+        UPDATE_TILE = 0x08,
+        INV_UPDATE = 0x09,
+        INV_SYNC = 0x0A,
+        CHUNK_DATA_PACKED = 0x0B, //palette + run-length encoded CHUNK_DATA
+        PONG = 0x0C,              //echoes the PING sequence number, newer servers add an i64 of their clock in us
+        UPDATE_REGION = 0x0D,     //many UPDATE_TILEs from one server tick in a single frame
+        UDP_OFFER = 0x0E,         //u16 port | u64 token, right after PROTO_ACK when UDP was accepted
+        MOVE_BATCH = 0x0F,        //UDP only: varint count | count * (i32 id, f32 x, f32 y), every player that moved that tick
+
+        //client -> server
+        INPUT = 0x10,
+        USE_ITEM = 0x11,
+        INV_MOVE_ITEM = 0x12,
+        PING = 0x13,
+        INPUT_STATE = 0x14,       //varint sequence | u8 InputBits, replaces INPUT on v2 servers
+        VIEW = 0x15,              //i32 minX, minY, maxX, maxY chunk rect the camera is heading for
+        CHUNK_REQUEST = 0x16,     //varint count | count * (varint chunkX, varint chunkY)
+        CHUNK_HASHES = 0x17,      //varint count | count * (varint chunkX, varint chunkY, u64 hash), right after PROTO when resuming
+        UDP_HELLO = 0x18,         //UDP only, no fields: registers the address the datagram came from, answered with an empty MOVE_BATCH
+        UDP_READY = 0x19,         //u8 ready over TCP: 1 once the server's datagrams arrive, 0 when they stopped
+
+        //any text message without a binary layout yet, carried as-is
+        TEXT = 0x1F
+    };
+
+    //held movement keys as sent in INPUT_STATE
+    namespace InputBits
+    {
+        constexpr uint8_t LEFT = 1 << 0;
+        constexpr uint8_t RIGHT = 1 << 1;
+        constexpr uint8_t JUMP = 1 << 2;
+        constexpr uint8_t DOWN = 1 << 3;
+    }
+
+    inline bool isBinaryFrame(const std::string_view msg)
+    {
+        return !msg.empty() && static_cast<uint8_t>(msg[0]) < 0x20;
+    }
+
+    constexpr size_t OPCODE_COUNT = 0x20;
+
+    constexpr const char* opcodeName(const uint8_t opcode)
+    {
+        switch (static_cast<Opcode>(opcode))
+        {
+        case Opcode::ASSIGN_ID: return "ASSIGN_ID";
+        case Opcode::SPAWN: return "SPAWN";
+        case Opcode::ITEM_DEF_SYNC: return "ITEM_DEF_SYNC";
+        case Opcode::PLAYER_MOVE: return "PLAYER_MOVE";
+        case Opcode::PLAYER_JOIN: return "PLAYER_JOIN";
+        case Opcode::PLAYER_LEAVE: return "PLAYER_LEAVE";
+        case Opcode::CHUNK_DATA: return "CHUNK_DATA";
+        case Opcode::UPDATE_TILE: return "UPDATE_TILE";
+        case Opcode::INV_UPDATE: return "INV_UPDATE";
+        case Opcode::INV_SYNC: return "INV_SYNC";
+        case Opcode::CHUNK_DATA_PACKED: return "CHUNK_DATA_PACKED";
+        case Opcode::PONG: return "PONG";
+        case Opcode::UPDATE_REGION: return "UPDATE_REGION";
+        case Opcode::UDP_OFFER: return "UDP_OFFER";
+        case Opcode::MOVE_BATCH: return "MOVE_BATCH";
+        case Opcode::INPUT: return "INPUT";
+        case Opcode::USE_ITEM: return "USE_ITEM";
+        case Opcode::INV_MOVE_ITEM: return "INV_MOVE_ITEM";
+        case Opcode::PING: return "PING";
+        case Opcode::INPUT_STATE: return "INPUT_STATE";
+        case Opcode::VIEW: return "VIEW";
+        case Opcode::CHUNK_REQUEST: return "CHUNK_REQUEST";
+        case Opcode::CHUNK_HASHES: return "CHUNK_HASHES";
+        case Opcode::UDP_HELLO: return "UDP_HELLO";
+        case Opcode::UDP_READY: return "UDP_READY";
+        case Opcode::TEXT: return "TEXT";
+        default: return "UNKNOWN";
+        }
+    }
+
+    //text commands are interned through a perfect hash worked out at compile time: a seed is searched for
+    //until every opcode name lands in its own slot, so a lookup is one hash, one load and one compare
+    namespace detail
+    {
+        constexpr size_t COMMAND_SLOTS = 64; //power of two, one cache line of opcodes
+
+        //length plus the first two and the last character, enough to tell every opcode name apart (PING and PONG
+        //only differ in the second) at a fixed cost however long the command is. the table fails to build if that stops being true
+        constexpr uint32_t commandHash(const std::string_view s, const uint32_t seed)
+        {
+            if (s.size() < 2) return static_cast<uint32_t>(s.size());
+            uint32_t h = (static_cast<uint32_t>(s.size()) | static_cast<uint32_t>(static_cast<uint8_t>(s[0])) << 8
+                          | static_cast<uint32_t>(static_cast<uint8_t>(s[1])) << 16
+                          | static_cast<uint32_t>(static_cast<uint8_t>(s.back())) << 24) ^ seed;
+            h ^= h >> 16; //murmur3 finalizer, the slot comes from the low bits so every input bit has to reach them
+            h *= 0x85EBCA6Bu;
+            h ^= h >> 13;
+            h *= 0xC2B2AE35u;
+            return h ^ (h >> 16);
+        }
+
+        struct CommandTable
+        {
+            bool found = false;
+            uint32_t seed = 0;
+            uint8_t slots[COMMAND_SLOTS] = {}; //opcode per slot, 0 for empty
+        };
+
+        constexpr CommandTable buildCommandTable()
+        {
+            for (uint32_t seed = 0; seed < 4096; seed++)
+            {
+                CommandTable table{};
+                table.seed = seed;
+                bool collided = false;
+                for (uint8_t op = 1; op < OPCODE_COUNT && !collided; op++)
+                {
+                    const std::string_view name = opcodeName(op);
+                    if (name == "UNKNOWN") continue;
+                    uint8_t& slot = table.slots[commandHash(name, seed) & (COMMAND_SLOTS - 1)];
+                    collided = slot != 0;
+                    slot = op;
+                }
+                table.found = !collided;
+                if (table.found) return table;
+            }
+            return {};
+        }
+
+        inline constexpr CommandTable COMMAND_TABLE = buildCommandTable();
+        static_assert(COMMAND_TABLE.found, "no collision free seed for the command table, raise COMMAND_SLOTS");
+    }
+
+    //opcode a text command would have in v2, commands without a binary layout count as TEXT
+    constexpr Opcode commandOpcode(const std::string_view cmd)
+    {
+        const uint8_t op = detail::COMMAND_TABLE.slots[detail::commandHash(cmd, detail::COMMAND_TABLE.seed) & (detail::COMMAND_SLOTS - 1)];
+        return op != 0 && cmd == opcodeName(op) ? static_cast<Opcode>(op) : Opcode::TEXT;
+    }
+    static_assert(commandOpcode("PLAYER_MOVE") == Opcode::PLAYER_MOVE && commandOpcode("UPDATE_REGION") == Opcode::UPDATE_REGION
+                  && commandOpcode("SERVER_SHUTDOWN") == Opcode::TEXT);
+
+    //opcode of an unframed message in either encoding, so both can be counted the same way
+    inline Opcode messageOpcode(const std::string_view msg)
+    {
+        if (isBinaryFrame(msg))
+            return static_cast<Opcode>(msg[0]);
+        return commandOpcode(msg.substr(0, msg.find(',')));
+    }
+
+    inline size_t varintSize(uint32_t value)
+    {
+        size_t bytes = 1;
+        while (value >= 0x80)
+        {
+            value >>= 7;
+            bytes++;
+        }
+        return bytes;
+    }
+
+    //reads an unsigned LEB128 varint, returns the number of bytes used or 0 if incomplete/invalid
+    inline size_t readVarint(const char* data, const size_t size, uint32_t& value)
+    {
+        value = 0;
+        for (size_t i = 0; i < size && i < MAX_VARINT_BYTES; i++)
+        {
+            const auto byte = static_cast<uint8_t>(data[i]);
+            value |= static_cast<uint32_t>(byte & 0x7F) << (7 * i);
+            if (!(byte & 0x80))
+                return i + 1;
+        }
+        return 0;
+    }
+
+    inline void appendVarint(std::string& out, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    //appends one complete frame (length prefix included) to the end of out
+    class BinaryWriter
+    {
+    public:
+        BinaryWriter(std::string& out, const Opcode op) : out(out), start(out.size())
+        {
+            out.append(MAX_VARINT_BYTES, '\0'); //room for the length prefix, trimmed in finish()
+            u8(static_cast<uint8_t>(op));
+        }
+
+        void u8(const uint8_t v) { out.push_back(static_cast<char>(v)); }
+        void u16(const uint16_t v) { u8(static_cast<uint8_t>(v)); u8(static_cast<uint8_t>(v >> 8)); }
+        void i32(const int32_t v)
+        {
+            const auto u = static_cast<uint32_t>(v);
+            for (int i = 0; i < 4; i++) u8(static_cast<uint8_t>(u >> (8 * i)));
+        }
+        void u64(const uint64_t v)
+        {
+            for (int i = 0; i < 8; i++) u8(static_cast<uint8_t>(v >> (8 * i)));
+        }
+        void i64(const int64_t v) { u64(static_cast<uint64_t>(v)); }
+        void f32(const float v)
+        {
+            int32_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            i32(bits);
+        }
+        void varint(const uint32_t v) { appendVarint(out, v); }
+        void chr(const char v) { u8(static_cast<uint8_t>(v)); }
+        void str(const std::string_view s)
+        {
+            varint(static_cast<uint32_t>(s.size()));
+            out.append(s.data(), s.size());
+        }
+
+        void finish()
+        {
+            auto length = static_cast<uint32_t>(out.size() - start - MAX_VARINT_BYTES);
+            char prefix[MAX_VARINT_BYTES];
+            size_t prefixSize = 0;
+            do
+            {
+                prefix[prefixSize] = static_cast<char>((length & 0x7F) | (length >= 0x80 ? 0x80 : 0));
+                length >>= 7;
+                prefixSize++;
+            } while (length > 0);
+
+            //write the prefix right in front of the opcode and drop the unused reserved bytes
+            const size_t unused = MAX_VARINT_BYTES - prefixSize;
+            std::memcpy(&out[start + unused], prefix, prefixSize);
+            out.erase(start, unused);
+        }
+
+    private:
+        std::string& out;
+        const size_t start;
+    };
+
+    //text (v1) counterpart of BinaryWriter with the same field methods: appends one complete line,
+    //the command name then every field as a comma separated decimal
+    class TextWriter
+    {
+    public:
+        TextWriter(std::string& out, const Opcode op) : out(out) { out += opcodeName(static_cast<uint8_t>(op)); }
+        //one entry of a list that is a single field of its own (ITEM_DEF_SYNC): entrySeparator, then the
+        //entry's fields split by separator, all appended to the field parent is on
+        TextWriter(TextWriter& parent, const char entrySeparator, const char separator) : out(parent.out), separator(separator), first(true)
+        {
+            out.push_back(entrySeparator);
+        }
+
+        void u8(const uint8_t v) { integer(static_cast<unsigned>(v)); }
+        void u16(const uint16_t v) { integer(static_cast<unsigned>(v)); }
+        void i32(const int32_t v) { integer(v); }
+        void u64(const uint64_t v) { integer(v); }
+        void i64(const int64_t v) { integer(v); }
+        void varint(const uint32_t v) { integer(v); }
+        void f32(const float v)
+        {
+            char buffer[32];
+#if defined(__cpp_lib_to_chars)
+            const char* end = std::to_chars(buffer, buffer + sizeof(buffer), v).ptr; //shortest text that reads back the same
+#else
+            const char* end = buffer + std::snprintf(buffer, sizeof(buffer), "%.9g", static_cast<double>(v));
+#endif
+            next();
+            out.append(buffer, static_cast<size_t>(end - buffer));
+        }
+        void str(const std::string_view s)
+        {
+            next();
+            out.append(s.data(), s.size());
+        }
+        void chr(const char v) { str(std::string_view(&v, 1)); }
+
+        void finish() { out.push_back('\n'); }
+
+    private:
+        std::string& out;
+        const char separator = ',';
+        bool first = false; //the command name already went in front of the first field
+
+        void next()
+        {
+            if (!first) out.push_back(separator);
+            first = false;
+        }
+        template<typename T>
+        void integer(const T v)
+        {
+            char buffer[24];
+            const char* end = std::to_chars(buffer, buffer + sizeof(buffer), v).ptr;
+            next();
+            out.append(buffer, static_cast<size_t>(end - buffer));
+        }
+    };
+
+    //reads fields out of a frame payload (the bytes after the opcode).
+    //running past the end sets failed() instead of throwing, every getter then returns 0
+    class BinaryReader
+    {
+    public:
+        explicit BinaryReader(const std::string_view payload) : data(payload) {}
+
+        uint8_t u8()
+        {
+            if (!require(1)) return 0;
+            return static_cast<uint8_t>(data[pos++]);
+        }
+        uint16_t u16()
+        {
+            if (!require(2)) return 0;
+            const auto v = static_cast<uint16_t>(static_cast<uint8_t>(data[pos]) | static_cast<uint8_t>(data[pos + 1]) << 8);
+            pos += 2;
+            return v;
+        }
+        int32_t i32()
+        {
+            if (!require(4)) return 0;
+            uint32_t u = 0;
+            for (int i = 0; i < 4; i++)
+                u |= static_cast<uint32_t>(static_cast<uint8_t>(data[pos + i])) << (8 * i);
+            pos += 4;
+            return static_cast<int32_t>(u);
+        }
+        uint64_t u64()
+        {
+            if (!require(8)) return 0;
+            uint64_t u = 0;
+            for (int i = 0; i < 8; i++)
+                u |= static_cast<uint64_t>(static_cast<uint8_t>(data[pos + i])) << (8 * i);
+            pos += 8;
+            return u;
+        }
+        int64_t i64() { return static_cast<int64_t>(u64()); }
+        char chr() { return static_cast<char>(u8()); }
+        float f32()
+        {
+            const int32_t bits = i32();
+            float v;
+            std::memcpy(&v, &bits, sizeof(v));
+            return v;
+        }
+        uint32_t varint()
+        {
+            uint32_t v = 0;
+            const size_t used = readVarint(data.data() + pos, data.size() - pos, v);
+            if (used == 0)
+            {
+                failed = true;
+                return 0;
+            }
+            pos += used;
+            return v;
+        }
+        std::string_view str()
+        {
+            const uint32_t length = varint();
+            if (!require(length)) return {};
+            const std::string_view s = data.substr(pos, length);
+            pos += length;
+            return s;
+        }
+
+        //everything not read yet, for a list that runs to the end of the frame
+        std::string_view remainder()
+        {
+            const std::string_view rest = failed ? std::string_view() : data.substr(pos);
+            pos = data.size();
+            return rest;
+        }
+
+        [[nodiscard]] bool ok() const { return !failed; }
+        [[nodiscard]] size_t remaining() const { return data.size() - pos; }
+        [[nodiscard]] bool atEnd() const { return failed || pos == data.size(); }
+
+    private:
+        std::string_view data;
+        size_t pos = 0;
+        bool failed = false;
+
+        bool require(const size_t bytes)
+        {
+            if (failed || data.size() - pos < bytes)
+            {
+                failed = true;
+                return false;
+            }
+            return true;
+        }
+    };
+
+    enum class ParseError : uint8_t
+    {
+        NONE,
+        MISSING_FIELD, //ran out of fields
+        BAD_NUMBER,    //not a number, or junk after it
+        OUT_OF_RANGE,
+    };
+
+    inline const char* parseErrorName(const ParseError error)
+    {
+        switch (error)
+        {
+        case ParseError::NONE: return "none";
+        case ParseError::MISSING_FIELD: return "missing field";
+        case ParseError::BAD_NUMBER: return "bad number";
+        case ParseError::OUT_OF_RANGE: return "out of range";
+        default: return "unknown";
+        }
+    }
+
+    //vector kernels for parseU16List, picked at startup from what the cpu supports
+    enum class U16ListKernel : uint8_t
+    {
+        SCALAR,
+        SSE2,
+        AVX2,
+    };
+
+    inline const char* u16ListKernelName(const U16ListKernel kernel)
+    {
+        switch (kernel)
+        {
+        case U16ListKernel::SCALAR: return "scalar";
+        case U16ListKernel::SSE2: return "sse2";
+        case U16ListKernel::AVX2: return "avx2";
+        default: return "unknown";
+        }
+    }
+
+    //up to maxCount comma separated decimals (0..65535) from the front of text into out, stopping early if the
+    //text runs out. text is left at the separator after the last value read, the first problem goes into error
+    //(if it is still NONE) and everything before it is kept. see DecimalList.cpp
+    size_t parseU16List(std::string_view& text, uint16_t* out, size_t maxCount, ParseError& error);
+    [[nodiscard]] U16ListKernel u16ListKernel();
+    bool setU16ListKernel(U16ListKernel kernel); //false if the cpu cant run it, to compare kernels in a replay
+
+    //walks the fields of a text (v1) message in place, the text counterpart of BinaryReader.
+    //fields are views into the message so nothing is copied or allocated, numbers go through from_chars.
+    //splits like getline would: empty fields are kept, a trailing empty one isnt.
+    //the first problem sticks, later reads return 0/empty and ok() stays false
+    class TextReader
+    {
+    public:
+        explicit TextReader(const std::string_view text, const char separator = ',') : rest(text), separator(separator) {}
+
+        std::string_view field()
+        {
+            if (atEnd())
+            {
+                fail(ParseError::MISSING_FIELD);
+                return {};
+            }
+
+            const size_t pos = rest.find(separator);
+            const std::string_view f = rest.substr(0, pos);
+            if (pos == std::string_view::npos)
+                finished = true;
+            else
+                rest.remove_prefix(pos + 1);
+            return f;
+        }
+        void skip(size_t fields = 1)
+        {
+            while (fields-- > 0) field();
+        }
+
+        //same getters as BinaryReader so Messages.h can decode either encoding from one field list,
+        //a decimal that doesnt fit the field type is OUT_OF_RANGE
+        int32_t i32() { return integer<int32_t>(); }
+        uint16_t u16() { return integer<uint16_t>(); }
+        uint8_t u8() { return integer<uint8_t>(); }
+        uint64_t u64() { return integer<uint64_t>(); }
+        int64_t i64() { return integer<int64_t>(); }
+        uint32_t varint() { return integer<uint32_t>(); }
+        std::string_view str() { return field(); }
+        char chr()
+        {
+            const std::string_view f = field();
+            if (!failed() && f.size() != 1) fail(ParseError::BAD_NUMBER);
+            return failed() ? '\0' : f.front();
+        }
+        float f32()
+        {
+            const std::string_view f = field();
+            float v = 0.0f;
+            if (failed()) return 0.0f;
+#if defined(__cpp_lib_to_chars)
+            const auto [end, ec] = std::from_chars(f.data(), f.data() + f.size(), v);
+            return check(ec, end == f.data() + f.size()) ? v : 0.0f;
+#else
+            //no floating point from_chars in this standard library, strtof wants a terminated copy
+            char buffer[64];
+            if (f.empty() || f.size() >= sizeof(buffer))
+            {
+                fail(ParseError::BAD_NUMBER);
+                return 0.0f;
+            }
+            std::memcpy(buffer, f.data(), f.size());
+            buffer[f.size()] = '\0';
+            char* end = nullptr;
+            v = std::strtof(buffer, &end);
+            return check(std::errc(), end == buffer + f.size()) ? v : 0.0f;
+#endif
+        }
+
+        //the next maxCount fields (or as many as are left) as small unsigned numbers, much faster than field by field
+        size_t u16List(uint16_t* out, const size_t maxCount)
+        {
+            if (failed() || atEnd()) return 0;
+            const size_t read = parseU16List(rest, out, maxCount, error);
+            if (rest.empty())
+                finished = true;
+            else if (rest.front() == separator && !failed())
+                rest.remove_prefix(1);
+            return read;
+        }
+
+        //everything not read yet, for a list that runs to the end of the line
+        std::string_view remainder()
+        {
+            const std::string_view r = atEnd() || failed() ? std::string_view() : rest;
+            finished = true;
+            return r;
+        }
+
+        //no fields left, a lone trailing separator counts as none
+        [[nodiscard]] bool atEnd() const { return finished || rest.empty(); }
+        [[nodiscard]] bool ok() const { return error == ParseError::NONE; }
+        [[nodiscard]] ParseError getError() const { return error; }
+
+    private:
+        std::string_view rest;
+        char separator;
+        bool finished = false;
+        ParseError error = ParseError::NONE;
+
+        [[nodiscard]] bool failed() const { return error != ParseError::NONE; }
+        template<typename T>
+        T integer()
+        {
+            const std::string_view f = field();
+            T v = 0;
+            if (failed()) return 0;
+            const auto [end, ec] = std::from_chars(f.data(), f.data() + f.size(), v);
+            return check(ec, end == f.data() + f.size()) ? v : 0;
+        }
+        void fail(const ParseError e)
+        {
+            if (error == ParseError::NONE) error = e;
+        }
+        bool check(const std::errc ec, const bool consumedAll)
+        {
+            if (ec == std::errc::result_out_of_range) fail(ParseError::OUT_OF_RANGE);
+            else if (ec != std::errc() || !consumedAll) fail(ParseError::BAD_NUMBER);
+            return !failed();
+        }
+    };
+}
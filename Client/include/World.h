@@ -2,7 +2,16 @@
 
 #include "Chunk.h"
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
+
+//what a client already holds, sent on reconnect so the server only resends chunks that changed
+struct HeldChunk
+{
+    int chunkX, chunkY;
+    uint64_t hash;
+};
 
 class World
 {
@@ -19,6 +28,15 @@ public:
         chunks[key] = std::move(chunk);
     }
 
+    [[nodiscard]] std::vector<HeldChunk> heldChunks() const
+    {
+        std::vector<HeldChunk> held;
+        held.reserve(chunks.size());
+        for (const auto& [key, chunk] : chunks)
+            held.push_back({ chunk->chunkX, chunk->chunkY, chunk->hash });
+        return held;
+    }
+
     Chunk* getChunk(const int cx, const int cy)
     {
         const std::string key = std::to_string(cx) + "," + std::to_string(cy);
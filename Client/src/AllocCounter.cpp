@@ -0,0 +1,74 @@
+#include "../include/AllocCounter.h"
+#include <cstdlib>
+#include <cstddef>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#include <new>
+
+#ifdef SWAGARIA_COUNT_ALLOCS
+
+namespace
+{
+    //plain thread_local integers, no constructor so theyre usable before main and from any thread
+    thread_local uint64_t allocations = 0;
+    thread_local uint64_t bytes = 0;
+
+    void* countedAlloc(const std::size_t size)
+    {
+        allocations++;
+        bytes += size;
+        if (void* p = std::malloc(size != 0 ? size : 1))
+            return p;
+        throw std::bad_alloc();
+    }
+
+    //over-aligned types and pmr::new_delete_resource go through the aligned forms, so those have to be counted too
+    void* countedAlignedAlloc(std::size_t size, const std::align_val_t align)
+    {
+        allocations++;
+        bytes += size;
+        const auto alignment = static_cast<std::size_t>(align);
+#ifdef _WIN32
+        if (void* p = _aligned_malloc(size != 0 ? size : 1, alignment))
+#else
+        size = (size + alignment - 1) / alignment * alignment; //aligned_alloc wants a multiple of the alignment
+        if (void* p = std::aligned_alloc(alignment, size != 0 ? size : alignment))
+#endif
+            return p;
+        throw std::bad_alloc();
+    }
+
+    void alignedFree(void* p)
+    {
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+}
+
+uint64_t AllocCounter::threadAllocations() { return allocations; }
+uint64_t AllocCounter::threadBytes() { return bytes; }
+
+//the nothrow forms fall through to these
+void* operator new(const std::size_t size) { return countedAlloc(size); }
+void* operator new[](const std::size_t size) { return countedAlloc(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void* operator new(const std::size_t size, const std::align_val_t align) { return countedAlignedAlloc(size, align); }
+void* operator new[](const std::size_t size, const std::align_val_t align) { return countedAlignedAlloc(size, align); }
+void operator delete(void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { alignedFree(p); }
+
+#else
+
+uint64_t AllocCounter::threadAllocations() { return 0; }
+uint64_t AllocCounter::threadBytes() { return 0; }
+
+#endif
@@ -0,0 +1,93 @@
+#include "../include/ChunkCodec.h"
+#include "../include/Messages.h"
+#include <iostream>
+
+namespace ChunkCodec
+{
+    namespace
+    {
+        constexpr int TILES_PER_LAYER = Chunk::SIZE * Chunk::SIZE;
+        static_assert(Messages::ChunkData::tilesCount == static_cast<uint32_t>(TILES_PER_LAYER) * TileLayer::NUM_LAYERS,
+                      "CHUNK_DATA in Messages.def has to match the chunk size");
+
+        //the ids are in wire order (layer, then rows, then columns)
+        std::unique_ptr<Chunk> build(const Messages::ChunkData& data)
+        {
+            uint16_t ids[Messages::ChunkData::tilesCount];
+            Protocol::ParseError error = Protocol::ParseError::NONE;
+            const size_t read = Messages::readArray(data.tiles, ids, error);
+
+            if (error != Protocol::ParseError::NONE && error != Protocol::ParseError::MISSING_FIELD)
+            {
+                std::cerr << "[ERROR] Bad CHUNK_DATA message: " << Protocol::parseErrorName(error) << std::endl;
+                return nullptr;
+            }
+            if (read < Messages::ChunkData::tilesCount)
+            {
+                std::cerr << "[ERROR] CHUNK_DATA message truncated. Missing tile data.\n";
+                return nullptr;
+            }
+
+            auto chunk = std::make_unique<Chunk>(data.chunkX, data.chunkY);
+            for (int layer = 0; layer < TileLayer::NUM_LAYERS; layer++)
+                for (int i = 0; i < TILES_PER_LAYER; i++)
+                    chunk->tiles[i / Chunk::SIZE][i % Chunk::SIZE][layer].type = ids[layer * TILES_PER_LAYER + i];
+            chunk->rehash();
+            return chunk;
+        }
+    }
+
+    std::unique_ptr<Chunk> decodeText(const std::string_view msg)
+    {
+        Protocol::TextReader reader(msg);
+        reader.skip(); //CHUNK_DATA
+        Messages::ChunkData data;
+        if (!Messages::read(reader, data))
+        {
+            std::cerr << "[ERROR] Bad CHUNK_DATA message: " << Protocol::parseErrorName(reader.getError()) << std::endl;
+            return nullptr;
+        }
+        return build(data);
+    }
+
+    std::unique_ptr<Chunk> decodeRaw(Protocol::BinaryReader& reader)
+    {
+        Messages::ChunkData data;
+        if (!Messages::read(reader, data))
+            return nullptr;
+        return build(data);
+    }
+
+    std::unique_ptr<Chunk> decodePacked(Protocol::BinaryReader& reader)
+    {
+        const int chunkX = reader.i32();
+        const int chunkY = reader.i32();
+
+        uint16_t palette[256];
+        const uint8_t paletteSize = reader.u8();
+        for (int i = 0; i < paletteSize; i++)
+            palette[i] = reader.u16();
+        if (!reader.ok() || paletteSize == 0)
+            return nullptr;
+
+        auto chunk = std::make_unique<Chunk>(chunkX, chunkY);
+        constexpr uint32_t tilesPerLayer = Chunk::SIZE * Chunk::SIZE;
+        for (int layer = 0; layer < TileLayer::NUM_LAYERS; layer++)
+        {
+            uint32_t i = 0;
+            while (i < tilesPerLayer)
+            {
+                const uint32_t runLength = reader.varint();
+                const uint8_t paletteIndex = reader.u8();
+                if (!reader.ok() || runLength == 0 || runLength > tilesPerLayer - i || paletteIndex >= paletteSize)
+                    return nullptr;
+
+                const uint16_t type = palette[paletteIndex];
+                for (const uint32_t end = i + runLength; i < end; i++)
+                    chunk->tiles[i / Chunk::SIZE][i % Chunk::SIZE][layer].type = type;
+            }
+        }
+        chunk->rehash();
+        return chunk;
+    }
+}
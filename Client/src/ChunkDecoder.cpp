@@ -0,0 +1,166 @@
+#include "../include/ChunkDecoder.h"
+#include "../include/ChunkCodec.h"
+#include "../include/Protocol.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+ChunkDecoder::ChunkDecoder(const unsigned workerCount)
+{
+    for (unsigned i = 0; i < workerCount; i++)
+        workers.emplace_back(&ChunkDecoder::workerLoop, this);
+}
+
+ChunkDecoder::~ChunkDecoder()
+{
+    {
+        std::lock_guard lock(jobMutex);
+        stopping = true;
+    }
+    jobCondition.notify_all();
+
+    for (std::thread& worker : workers)
+        if (worker.joinable()) worker.join();
+}
+
+unsigned ChunkDecoder::defaultWorkerCount()
+{
+    //leave room for the render and network threads
+    const unsigned cores = std::thread::hardware_concurrency();
+    return std::clamp(cores / 2, 1u, 4u);
+}
+
+void ChunkDecoder::submit(const Format format, const std::string_view payload, const size_t wireBytes)
+{
+    //only the coords are read here, the other ~500 ids are left for the worker
+    int chunkX, chunkY;
+    bool coordsOk;
+    if (format == Format::TEXT)
+    {
+        //CHUNK_DATA,chunkX,chunkY,...
+        Protocol::TextReader reader(payload);
+        reader.skip();
+        chunkX = reader.i32();
+        chunkY = reader.i32();
+        coordsOk = reader.ok();
+    }
+    else
+    {
+        Protocol::BinaryReader reader(payload.substr(1));
+        chunkX = reader.i32();
+        chunkY = reader.i32();
+        coordsOk = reader.ok();
+    }
+
+    //without coords nothing could be deferred on it or tell it apart from a real chunk, so it never reaches a worker
+    if (!coordsOk)
+    {
+        std::cerr << "[ERROR] Bad CHUNK_DATA message: unreadable chunk coordinates" << std::endl;
+        std::lock_guard lock(statsMutex);
+        stats.chunks++;
+        stats.failed++;
+        stats.wireBytes += wireBytes;
+        return;
+    }
+
+    auto job = std::make_unique<Job>();
+    job->format = format;
+    job->payload.assign(payload.data(), payload.size());
+    job->wireBytes = wireBytes;
+    job->chunkX = chunkX;
+    job->chunkY = chunkY;
+    pendingByCoords[coordsKey(job->chunkX, job->chunkY)]++;
+
+    {
+        std::lock_guard lock(jobMutex);
+        jobQueue.push_back(job.get());
+    }
+    jobCondition.notify_one();
+    inFlight.push_back(std::move(job));
+}
+
+void ChunkDecoder::reset()
+{
+    {
+        std::lock_guard lock(jobMutex);
+        //no worker will ever pick these up, mark them so the wait below skips them
+        for (Job* job : jobQueue)
+            job->done.store(true, std::memory_order_relaxed);
+        jobQueue.clear();
+    }
+
+    //the rest were taken by a worker that still writes into them
+    for (const std::unique_ptr<Job>& job : inFlight)
+        while (!job->done.load(std::memory_order_acquire))
+            std::this_thread::yield();
+
+    inFlight.clear();
+    pendingByCoords.clear();
+}
+
+bool ChunkDecoder::isPending(const int chunkX, const int chunkY) const
+{
+    return pendingByCoords.count(coordsKey(chunkX, chunkY)) > 0;
+}
+
+void ChunkDecoder::releasePending(const int chunkX, const int chunkY)
+{
+    if (const auto it = pendingByCoords.find(coordsKey(chunkX, chunkY)); it != pendingByCoords.end() && --it->second <= 0)
+        pendingByCoords.erase(it);
+}
+
+ChunkDecoder::Stats ChunkDecoder::getStats()
+{
+    std::lock_guard lock(statsMutex);
+    return stats;
+}
+
+void ChunkDecoder::resetStats()
+{
+    std::lock_guard lock(statsMutex);
+    stats = {};
+}
+
+void ChunkDecoder::workerLoop()
+{
+    while (true)
+    {
+        Job* job;
+        {
+            std::unique_lock lock(jobMutex);
+            jobCondition.wait(lock, [this] { return stopping || !jobQueue.empty(); });
+            if (stopping)
+                return;
+
+            job = jobQueue.front();
+            jobQueue.pop_front();
+        }
+
+        decode(*job);
+    }
+}
+
+void ChunkDecoder::decode(Job& job)
+{
+    const auto decodeStart = std::chrono::steady_clock::now();
+
+    if (job.format == Format::TEXT)
+        job.result = ChunkCodec::decodeText(job.payload);
+    else
+    {
+        Protocol::BinaryReader reader(std::string_view(job.payload).substr(1));
+        job.result = job.format == Format::RAW ? ChunkCodec::decodeRaw(reader) : ChunkCodec::decodePacked(reader);
+    }
+
+    const auto decodeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - decodeStart).count();
+    {
+        std::lock_guard lock(statsMutex);
+        stats.chunks++;
+        stats.failed += job.result ? 0 : 1;
+        stats.wireBytes += job.wireBytes;
+        stats.decodeNs += static_cast<uint64_t>(decodeNs);
+    }
+
+    //last touch, the main thread owns the job again after this
+    job.done.store(true, std::memory_order_release);
+}
@@ -0,0 +1,110 @@
+#include "../include/ChunkStreamer.h"
+#include <algorithm>
+
+ChunkRect ChunkRect::grown(const int by) const
+{
+    return { std::max(0, minX - by), std::max(0, minY - by),
+             std::min(World::WORLD_WIDTH_IN_CHUNKS - 1, maxX + by), std::min(World::WORLD_HEIGHT_IN_CHUNKS - 1, maxY + by) };
+}
+
+int ChunkStreamer::indexOf(const int cx, const int cy)
+{
+    if (cx < 0 || cy < 0 || cx >= World::WORLD_WIDTH_IN_CHUNKS || cy >= World::WORLD_HEIGHT_IN_CHUNKS)
+        return -1;
+    return cy * World::WORLD_WIDTH_IN_CHUNKS + cx;
+}
+
+void ChunkStreamer::reset()
+{
+    states.fill(State::MISSING);
+    inFlight = 0;
+    nextBackground = {};
+    stats = {};
+}
+
+void ChunkStreamer::update(const ChunkRect& view, const std::chrono::steady_clock::time_point now, std::vector<ChunkCoord>& out)
+{
+    //give up on requests that never came back so they can go out again
+    for (int i = 0; i < CHUNK_COUNT; i++)
+    {
+        if (states[i] == State::REQUESTED && now - requestedAt[i] >= REQUEST_TIMEOUT)
+        {
+            states[i] = State::MISSING;
+            inFlight--;
+            stats.rerequested++;
+        }
+    }
+
+    const int budget = MAX_IN_FLIGHT - inFlight;
+    if (budget <= 0 || view.empty())
+        return;
+
+    if (const ChunkRect wanted = view.grown(VIEW_MARGIN); !isLoaded(wanted))
+    {
+        request(wanted, view, budget, now, out);
+        return;
+    }
+
+    //everything on screen is here, fill in the rest of the world slowly
+    if (now < nextBackground)
+        return;
+    nextBackground = now + BACKGROUND_INTERVAL;
+    request({ 0, 0, World::WORLD_WIDTH_IN_CHUNKS - 1, World::WORLD_HEIGHT_IN_CHUNKS - 1 }, view, std::min(budget, BACKGROUND_PER_STEP), now, out);
+}
+
+void ChunkStreamer::request(const ChunkRect& area, const ChunkRect& view, const int budget,
+                            const std::chrono::steady_clock::time_point now, std::vector<ChunkCoord>& out)
+{
+    //distances are doubled so the centre of an even sized view stays on whole numbers
+    const int centreX = view.minX + view.maxX;
+    const int centreY = view.minY + view.maxY;
+    std::vector<std::pair<int, ChunkCoord>> missing;
+    for (int cy = area.minY; cy <= area.maxY; cy++)
+    {
+        for (int cx = area.minX; cx <= area.maxX; cx++)
+        {
+            if (states[indexOf(cx, cy)] != State::MISSING)
+                continue;
+            const int dx = cx * 2 - centreX, dy = cy * 2 - centreY;
+            missing.push_back({ dx * dx + dy * dy, { cx, cy } });
+        }
+    }
+
+    const size_t count = std::min(missing.size(), static_cast<size_t>(budget));
+    std::partial_sort(missing.begin(), missing.begin() + static_cast<std::ptrdiff_t>(count), missing.end());
+    for (size_t i = 0; i < count; i++)
+    {
+        const auto [cx, cy] = missing[i].second;
+        const int index = indexOf(cx, cy);
+        states[index] = State::REQUESTED;
+        requestedAt[index] = now;
+        inFlight++;
+        stats.requested++;
+        out.push_back({ cx, cy });
+    }
+}
+
+void ChunkStreamer::onChunkReceived(const int cx, const int cy)
+{
+    const int index = indexOf(cx, cy);
+    if (index < 0)
+        return;
+
+    if (states[index] == State::REQUESTED)
+    {
+        inFlight--;
+        stats.received++;
+    }
+    else if (states[index] == State::MISSING)
+        stats.unrequested++;
+    states[index] = State::LOADED;
+}
+
+bool ChunkStreamer::isLoaded(const ChunkRect& rect) const
+{
+    for (int cy = rect.minY; cy <= rect.maxY; cy++)
+        for (int cx = rect.minX; cx <= rect.maxX; cx++)
+            if (const int index = indexOf(cx, cy); index >= 0 && states[index] != State::LOADED)
+                return false;
+    return true;
+}
@@ -0,0 +1,133 @@
+#include "../include/ClockSync.h"
+#include <algorithm>
+
+namespace
+{
+    int64_t toNs(const ClockSync::Clock::time_point t)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+    }
+}
+
+void ClockSync::reset()
+{
+    std::lock_guard lock(mutex);
+    recent.clear();
+    kept.clear();
+    probes = 0;
+    refNs = 0;
+    offsetUs = 0.0;
+    driftPpm = 0.0;
+    bestRttMs = 0.0;
+}
+
+void ClockSync::addProbe(const int64_t sentNs, const int64_t receivedNs, const int64_t serverUs)
+{
+    if (receivedNs < sentNs)
+        return;
+
+    const int64_t midNs = sentNs + (receivedNs - sentNs) / 2;
+    const Probe probe{ midNs, static_cast<double>(serverUs) - static_cast<double>(midNs) / 1000.0, receivedNs - sentNs };
+
+    std::lock_guard lock(mutex);
+    probes++;
+    recent.push_back(probe);
+    if (recent.size() > FILTER_WINDOW)
+        recent.pop_front();
+
+    //keep the window's best probe whenever that changes, either because this one beat it or the old best aged out
+    const Probe& best = *std::min_element(recent.begin(), recent.end(), [](const Probe& a, const Probe& b) { return a.rttNs < b.rttNs; });
+    if (!kept.empty() && kept.back().localNs == best.localNs)
+        return;
+    kept.push_back(best);
+    if (kept.size() > FIT_WINDOW)
+        kept.pop_front();
+    refit();
+}
+
+void ClockSync::refit()
+{
+    const Probe& latest = kept.back();
+    bestRttMs = static_cast<double>(latest.rttNs) / 1e6;
+    refNs = latest.localNs;
+
+    //only probes close to the best round trip seen go into the line, a slow one can be lopsided by up to half its rtt
+    int64_t bestRttNs = latest.rttNs;
+    for (const Probe& p : kept)
+        bestRttNs = std::min(bestRttNs, p.rttNs);
+    const int64_t fitRttNs = bestRttNs + bestRttNs / 2 + FIT_RTT_SLACK_NS;
+
+    const Probe* first = nullptr;
+    size_t fitted = 0;
+    double sumT = 0.0, sumO = 0.0, sumTT = 0.0, sumTO = 0.0;
+    for (const Probe& p : kept)
+    {
+        if (p.rttNs > fitRttNs)
+            continue;
+        if (!first) first = &p;
+        fitted++;
+
+        //least squares offset = a + b * seconds since the latest probe, b in us per s is ppm
+        const double t = static_cast<double>(p.localNs - refNs) / 1e9;
+        sumT += t;
+        sumO += p.offsetUs;
+        sumTT += t * t;
+        sumTO += t * p.offsetUs;
+    }
+    if (fitted < 3 || latest.localNs - first->localNs < std::chrono::duration_cast<std::chrono::nanoseconds>(MIN_DRIFT_SPAN).count())
+    {
+        offsetUs = fitted > 0 ? sumO / static_cast<double>(fitted) : latest.offsetUs;
+        driftPpm = 0.0;
+        return;
+    }
+
+    const auto n = static_cast<double>(fitted);
+    const double denominator = n * sumTT - sumT * sumT;
+    const double slope = denominator != 0.0 ? (n * sumTO - sumT * sumO) / denominator : 0.0;
+
+    driftPpm = std::clamp(slope, -MAX_DRIFT_PPM, MAX_DRIFT_PPM);
+    offsetUs = (sumO - driftPpm * sumT) / n;
+}
+
+double ClockSync::offsetAt(const int64_t localNs) const
+{
+    return offsetUs + driftPpm * static_cast<double>(localNs - refNs) / 1e9;
+}
+
+bool ClockSync::isSynced() const
+{
+    std::lock_guard lock(mutex);
+    return !kept.empty();
+}
+
+int64_t ClockSync::toServerUs(const Clock::time_point local) const
+{
+    const int64_t localNs = toNs(local);
+    std::lock_guard lock(mutex);
+    return localNs / 1000 + static_cast<int64_t>(kept.empty() ? 0.0 : offsetAt(localNs));
+}
+
+ClockSync::Clock::time_point ClockSync::toLocal(const int64_t serverUs) const
+{
+    std::lock_guard lock(mutex);
+    if (kept.empty())
+        return Clock::time_point(std::chrono::microseconds(serverUs));
+
+    //the drift term needs a local time, the one the current offset gives is off by a few ppm at most
+    const auto approxLocalNs = static_cast<int64_t>((static_cast<double>(serverUs) - offsetUs) * 1000.0);
+    const double offset = offsetAt(approxLocalNs);
+    return Clock::time_point(std::chrono::nanoseconds(static_cast<int64_t>((static_cast<double>(serverUs) - offset) * 1000.0)));
+}
+
+ClockSync::Estimate ClockSync::estimate() const
+{
+    const int64_t nowNs = toNs(Clock::now());
+    std::lock_guard lock(mutex);
+    Estimate e;
+    e.synced = !kept.empty();
+    e.offsetUs = e.synced ? offsetAt(nowNs) : 0.0;
+    e.driftPpm = driftPpm;
+    e.bestRttMs = bestRttMs;
+    e.probes = probes;
+    return e;
+}
@@ -0,0 +1,269 @@
+#include "../include/Protocol.h"
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SWAGARIA_X86 1
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//comma separated lists of small decimals, the bulk of a text CHUNK_DATA (512 tile ids) and INV_SYNC.
+//a vector kernel classifies 64 bytes at a time into digit and comma bitmasks, the commas are then walked with
+//a bit scan and each number in between is converted with one SWAR multiply chain instead of digit by digit.
+//the scalar loop handles whatever the masks cant: the last few bytes, the end of the list and every error
+namespace
+{
+    constexpr size_t BLOCK = 64;
+    constexpr size_t MAX_DIGITS = 5; //65535
+
+    bool isDigit(const char c) { return static_cast<unsigned char>(c - '0') < 10; }
+
+    int lowestSetBit(const uint64_t v)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long index;
+#if defined(_M_X64) || defined(_M_ARM64)
+        _BitScanForward64(&index, v);
+#else
+        if (!_BitScanForward(&index, static_cast<unsigned long>(v)))
+        {
+            _BitScanForward(&index, static_cast<unsigned long>(v >> 32));
+            index += 32;
+        }
+#endif
+        return static_cast<int>(index);
+#else
+        return __builtin_ctzll(v);
+#endif
+    }
+
+    //1..8 ascii digits starting at p, p must have 8 readable bytes
+    uint32_t swarDigits(const char* p, const size_t length)
+    {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        //the borrow from bytes past the number only runs upwards, into the bytes the shift drops.
+        //little endian like the rest of the wire code
+        v -= 0x3030303030303030ull;
+        v <<= 8 * (8 - length);
+        v = (v * 10 + (v >> 8)) & 0x00FF00FF00FF00FFull;
+        v = (v * 100 + (v >> 16)) & 0x0000FFFF0000FFFFull;
+        v = (v * 10000 + (v >> 32)) & 0xFFFFFFFFull;
+        return static_cast<uint32_t>(v);
+    }
+
+    struct ListState
+    {
+        const char* numberStart; //first byte of the number being read
+        size_t written = 0;
+        Protocol::ParseError error = Protocol::ParseError::NONE;
+    };
+
+    //one number ending right before separator, false stops the list
+    bool takeNumber(ListState& state, const char* separator, uint16_t* out)
+    {
+        const auto length = static_cast<size_t>(separator - state.numberStart);
+        if (length == 0 || length > MAX_DIGITS)
+        {
+            state.error = length == 0 ? Protocol::ParseError::BAD_NUMBER : Protocol::ParseError::OUT_OF_RANGE;
+            return false;
+        }
+        const uint32_t value = swarDigits(state.numberStart, length);
+        if (value > 0xFFFF)
+        {
+            state.error = Protocol::ParseError::OUT_OF_RANGE;
+            return false;
+        }
+        out[state.written++] = static_cast<uint16_t>(value);
+        state.numberStart = separator + 1;
+        return true;
+    }
+
+    //from state.numberStart to the end of the list, returns where it stopped
+    const char* scalarList(ListState& state, const char* end, uint16_t* out, const size_t maxCount)
+    {
+        const char* p = state.numberStart;
+        while (state.written < maxCount)
+        {
+            uint32_t value = 0;
+            const char* start = p;
+            while (p != end && isDigit(*p) && static_cast<size_t>(p - start) <= MAX_DIGITS)
+                value = value * 10 + static_cast<uint32_t>(*p++ - '0');
+
+            if (p == start)
+            {
+                state.error = Protocol::ParseError::BAD_NUMBER;
+                return start;
+            }
+            if (static_cast<size_t>(p - start) > MAX_DIGITS || value > 0xFFFF)
+            {
+                state.error = Protocol::ParseError::OUT_OF_RANGE;
+                return start;
+            }
+            out[state.written++] = static_cast<uint16_t>(value);
+
+            if (p == end)
+                return p;
+            if (*p != ',')
+            {
+                state.error = Protocol::ParseError::BAD_NUMBER; //junk after the digits
+                return p;
+            }
+            //like TextReader a lone trailing comma ends the list instead of starting an empty number
+            if (state.written == maxCount || p + 1 == end)
+                return p;
+            p++;
+        }
+        return p;
+    }
+
+    //bit i of digits/commas says what byte i of the 64 byte block is
+    using Classify = void (*)(const char* block, uint64_t& digits, uint64_t& commas);
+
+    //returns where the list stopped if it finished here, nullptr if the scalar loop has to carry on from state.numberStart
+    const char* vectorList(ListState& state, const char* p, const char* end, uint16_t* out, const size_t maxCount, const Classify classify)
+    {
+        //a number ending in a block can start a few bytes before it, its 8 byte SWAR load has to stay in bounds
+        while (end - p >= static_cast<ptrdiff_t>(BLOCK + 8))
+        {
+            uint64_t digits, commas;
+            classify(p, digits, commas);
+            if ((digits | commas) != ~0ull)
+                return nullptr; //the list ends (or goes bad) in here, the scalar loop sorts out which
+
+            for (; commas != 0; commas &= commas - 1)
+            {
+                const char* separator = p + lowestSetBit(commas);
+                if (!takeNumber(state, separator, out))
+                    return state.numberStart;
+                if (state.written == maxCount)
+                    return separator;
+            }
+            p += BLOCK;
+        }
+        return nullptr;
+    }
+
+#ifdef SWAGARIA_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SWAGARIA_TARGET(isa)
+#else
+#define SWAGARIA_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+    //only needs SSE2, which every x86-64 has, so on 64 bit builds this is the floor
+    SWAGARIA_TARGET("sse2")
+    void classifySse2(const char* block, uint64_t& digits, uint64_t& commas)
+    {
+        digits = 0;
+        commas = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+            const __m128i offset = _mm_sub_epi8(bytes, _mm_set1_epi8('0'));
+            //unsigned offset <= 9, via min since there is no unsigned byte compare
+            const __m128i digit = _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(9)), offset);
+            digits |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(digit))) << (i * 16);
+            commas |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(','))))) << (i * 16);
+        }
+    }
+
+    SWAGARIA_TARGET("avx2")
+    void classifyAvx2(const char* block, uint64_t& digits, uint64_t& commas)
+    {
+        digits = 0;
+        commas = 0;
+        for (int i = 0; i < 2; i++)
+        {
+            const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i * 32));
+            const __m256i offset = _mm256_sub_epi8(bytes, _mm256_set1_epi8('0'));
+            const __m256i digit = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, _mm256_set1_epi8(9)), offset);
+            digits |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(digit))) << (i * 32);
+            commas |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(','))))) << (i * 32);
+        }
+    }
+
+    bool cpuHasSse2()
+    {
+#if defined(__x86_64__) || defined(_M_X64)
+        return true;
+#elif defined(_MSC_VER)
+        int regs[4];
+        __cpuid(regs, 1);
+        return regs[3] & (1 << 26);
+#else
+        return __builtin_cpu_supports("sse2");
+#endif
+    }
+
+    bool cpuHasAvx2()
+    {
+#ifdef _MSC_VER
+        int regs[4];
+        __cpuid(regs, 0);
+        if (regs[0] < 7) return false;
+        __cpuid(regs, 1);
+        const bool osSavesYmm = (regs[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6; //OSXSAVE, then XMM and YMM state enabled
+        __cpuidex(regs, 7, 0);
+        return osSavesYmm && (regs[1] & (1 << 5));
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    Protocol::U16ListKernel bestKernel()
+    {
+#ifdef SWAGARIA_X86
+        if (cpuHasAvx2()) return Protocol::U16ListKernel::AVX2;
+        if (cpuHasSse2()) return Protocol::U16ListKernel::SSE2;
+        return Protocol::U16ListKernel::SCALAR;
+#else
+        return Protocol::U16ListKernel::SCALAR;
+#endif
+    }
+
+    std::atomic<Protocol::U16ListKernel> activeKernel{bestKernel()};
+}
+
+namespace Protocol
+{
+    size_t parseU16List(std::string_view& text, uint16_t* out, const size_t maxCount, ParseError& error)
+    {
+        if (maxCount == 0 || text.empty())
+            return 0;
+
+        const char* end = text.data() + text.size();
+        ListState state{text.data()};
+        const char* stopped = nullptr;
+
+        switch (activeKernel.load(std::memory_order_relaxed))
+        {
+#ifdef SWAGARIA_X86
+        case U16ListKernel::AVX2: stopped = vectorList(state, text.data(), end, out, maxCount, classifyAvx2); break;
+        case U16ListKernel::SSE2: stopped = vectorList(state, text.data(), end, out, maxCount, classifySse2); break;
+#endif
+        default: break;
+        }
+        if (!stopped)
+            stopped = scalarList(state, end, out, maxCount);
+
+        if (state.error != ParseError::NONE && error == ParseError::NONE)
+            error = state.error;
+        text.remove_prefix(static_cast<size_t>(stopped - text.data()));
+        return state.written;
+    }
+
+    U16ListKernel u16ListKernel() { return activeKernel.load(std::memory_order_relaxed); }
+
+    bool setU16ListKernel(const U16ListKernel kernel)
+    {
+        if (kernel > bestKernel())
+            return false;
+        activeKernel.store(kernel, std::memory_order_relaxed);
+        return true;
+    }
+}
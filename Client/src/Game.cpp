@@ -2,6 +2,9 @@
 #include "../include/Network.h"
 #include "../include/TextureManager.h"
 #include "../include/ItemRegistry.h"
+#include "../include/Protocol.h"
+#include "../include/ChunkCodec.h"
+#include "../include/AllocCounter.h"
 #include <algorithm>
 #include <cmath>
 #include <sstream>
@@ -12,17 +15,21 @@
 
 class TextureManager;
 
-Game::Game() : camera(800, 600)
+Game::Game(const bool headless) : headless(headless), camera(800, 600),
+    chunkDecoder(headless ? 1 : ChunkDecoder::defaultWorkerCount()) //hundreds of bots share the cores
 {
     std::cout << "[CLIENT] Started!" << std::endl;
 
-    if (TTF_Init() == -1)
-        std::cerr << "[SDL_TTF] Failed to initialize: " << TTF_GetError() << std::endl;
-    else
+    if (!headless)
     {
-        font = TTF_OpenFont("assets/fonts/Andy Bold.ttf", 24);
-        if (!font)
-            std::cerr << "[SDL_TTF] Failed to load font: " << TTF_GetError() << std::endl;
+        if (TTF_Init() == -1)
+            std::cerr << "[SDL_TTF] Failed to initialize: " << TTF_GetError() << std::endl;
+        else
+        {
+            font = TTF_OpenFont("assets/fonts/Andy Bold.ttf", 24);
+            if (!font)
+                std::cerr << "[SDL_TTF] Failed to load font: " << TTF_GetError() << std::endl;
+        }
     }
 
     world = std::make_unique<World>();
@@ -36,261 +43,460 @@ Game::~Game()
         TTF_CloseFont(font);
         font = nullptr;
     }
-    TTF_Quit();
+    if (!headless)
+        TTF_Quit();
 
     std::cout << "[CLIENT] Closed." << std::endl;
 }
 
-void Game::pushNetworkMessage(const std::string& msg)
+bool Game::pushNetworkMessage(const std::string_view msg, const std::atomic<bool>& keepWaiting)
 {
-    std::lock_guard lock(incomingMutex);
-    incomingMessages.push(msg);
+    return incomingMessages.push(msg, keepWaiting);
 }
 
 void Game::processNetworkMessages()
 {
-    std::lock_guard lock(incomingMutex);
-    while (!incomingMessages.empty())
+    trackJoinBurstFrame();
+    const uint64_t allocationsBefore = AllocCounter::threadAllocations();
+
+    //no lock held here, the network thread can keep filling free slots while chunks are decoded
+    incomingMessages.drain([this](const std::string& msg)
     {
-        std::string msg = incomingMessages.front();
-        incomingMessages.pop();
-        handleOneNetworkMessage(msg);
-    }
+        const auto parseStart = std::chrono::steady_clock::now();
+        const uint64_t messageAllocationsBefore = AllocCounter::threadAllocations();
+
+        if (!submitChunk(msg))
+        {
+            if (Protocol::isBinaryFrame(msg))
+                handleBinaryMessage(msg);
+            else
+                handleOneNetworkMessage(msg);
+        }
+
+        if (network)
+            network->getTelemetry().recordParse(Protocol::messageOpcode(msg),
+                static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - parseStart).count()),
+                AllocCounter::threadAllocations() - messageAllocationsBefore);
+    });
+
+    //newest movement last, so a datagram wins over an older TCP move handled above
+    incomingDatagrams.drain([this](const std::string& payload) { handleBinaryMessage(payload); });
+
+    //only the message handling above is counted, installing chunks allocates by design
+    const uint64_t allocations = AllocCounter::threadAllocations() - allocationsBefore;
+    messageAllocs.frames++;
+    messageAllocs.total += allocations;
+    messageAllocs.worst = std::max(messageAllocs.worst, allocations);
+    frameArena.reset();
+
+    chunkDecoder.collect(CHUNK_INSTALL_BUDGET, [this](std::unique_ptr<Chunk> chunk) { installChunk(std::move(chunk)); });
 }
 
-void Game::handleOneNetworkMessage(const std::string& msg)
+void Game::discardSession()
 {
-    std::istringstream ss(msg);
-    std::string token;
-    std::vector<std::string> parts;
+    incomingMessages.drain([](const std::string&) {});
+    incomingDatagrams.drain([](const std::string&) {});
+    chunkDecoder.reset();
+    deferredTileUpdates.clear();
+}
 
-    while (std::getline(ss, token, ','))
-        parts.push_back(token);
-    if (parts.empty())
-        return;
+//hands chunk payloads to the decoder pool before anything tokenizes them, returns false for every other message
+bool Game::submitChunk(const std::string_view msg)
+{
+    if (Protocol::isBinaryFrame(msg))
+    {
+        const auto opcode = static_cast<Protocol::Opcode>(msg[0]);
+        if (opcode == Protocol::Opcode::CHUNK_DATA)
+            chunkDecoder.submit(ChunkDecoder::Format::RAW, msg, msg.size() + 2); //+~2 for the length prefix
+        else if (opcode == Protocol::Opcode::CHUNK_DATA_PACKED)
+            chunkDecoder.submit(ChunkDecoder::Format::PACKED, msg, msg.size() + 2);
+        else
+            return false;
+        return true;
+    }
 
-    if (const std::string& cmd = parts[0]; cmd == "ASSIGN_ID")
-        localPlayerId = std::stoi(parts[1]);
-    else if (cmd == "SPAWN")
+    if (msg.rfind("CHUNK_DATA,", 0) != 0)
+        return false;
+    chunkDecoder.submit(ChunkDecoder::Format::TEXT, msg, msg.size() + 1); //+1 for the newline
+    return true;
+}
+
+void Game::installChunk(std::unique_ptr<Chunk> chunk)
+{
+    const int chunkX = chunk->chunkX, chunkY = chunk->chunkY;
+    chunkStreamer.onChunkReceived(chunkX, chunkY);
+    onChunkData(std::move(chunk));
+
+    //replay anything that arrived for this chunk while it was decoding, in arrival order.
+    //if a newer copy of the chunk is still decoding they wait for that one instead
+    if (const auto it = deferredTileUpdates.find(ChunkDecoder::coordsKey(chunkX, chunkY));
+        it != deferredTileUpdates.end() && !chunkDecoder.isPending(chunkX, chunkY))
     {
-        const int id = std::stoi(parts[1]);
-        const float x = std::stof(parts[2]);
-        const float y = std::stof(parts[3]);
-        players[id] = { id, x, y, x, y, id == localPlayerId, "Player" + std::to_string(id) };
+        const std::vector<TileUpdate> waiting = std::move(it->second);
+        deferredTileUpdates.erase(it);
+        onUpdateRegion(waiting.data(), waiting.size(), false);
     }
-    else if (cmd == "ITEM_DEF_SYNC")
+
+    if (joinBurst.active && ++joinBurst.chunksInstalled >= World::WORLD_WIDTH_IN_CHUNKS * World::WORLD_HEIGHT_IN_CHUNKS
+        && chunkStreamer.isLoaded({ 0, 0, World::WORLD_WIDTH_IN_CHUNKS - 1, World::WORLD_HEIGHT_IN_CHUNKS - 1 }))
     {
-        ItemRegistry::getInstance().clear();
+        //report once the whole world has arrived
+        joinBurst.active = false;
+        joinBurst.completedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - joinBurst.started).count();
+        const ChunkDecoder::Stats stats = chunkDecoder.getStats();
+        const auto burstMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - joinBurst.started).count();
+
+        std::cout << "[CLIENT] Received " << stats.chunks << " chunks in " << burstMs << "ms: " << stats.wireBytes << " bytes on the wire ("
+                  << stats.wireBytes / std::max<uint64_t>(stats.chunks, 1) << " per chunk), decoded in " << stats.decodeNs / 1000 << "us on "
+                  << ChunkDecoder::defaultWorkerCount() << " workers (" << stats.decodeNs / std::max<uint64_t>(stats.chunks, 1) << "ns per chunk, "
+                  << stats.failed << " failed, text lists on " << Protocol::u16ListKernelName(Protocol::u16ListKernel()) << ")" << std::endl;
+        std::cout << "[CLIENT] Join burst frames: " << joinBurst.frames << " | worst " << joinBurst.worstFrameMs << "ms, avg "
+                  << (joinBurst.frames > 0 ? joinBurst.totalFrameMs / joinBurst.frames : 0.0) << "ms" << std::endl;
+    }
+}
 
-        //format:
-        //ITEM_DEF_SYNC,ID:Name:MaxStackSize:Type:Prop1:Prop2|ID:Name:MaxStackSize:Type:Prop1:Prop2|...
-        //TILE: ID:Name:MaxStackSize:T:TileTypeID
-        //TOOL: ID:Name:MaxStackSize:R:ToolType:Damage
+void Game::trackJoinBurstFrame()
+{
+    if (!joinBurst.active)
+        return;
 
-        if (parts.size() < 2) return;
-        std::istringstream defsSs(parts[1]);
-        std::string defString;
+    const auto now = std::chrono::steady_clock::now();
+    const double frameMs = std::chrono::duration<double, std::milli>(now - joinBurst.lastFrame).count();
+    joinBurst.lastFrame = now;
+    joinBurst.frames++;
+    joinBurst.totalFrameMs += frameMs;
+    joinBurst.worstFrameMs = std::max(joinBurst.worstFrameMs, frameMs);
+}
 
-        while (std::getline(defsSs, defString, '|'))
-        {
-            if (defString.empty()) continue;
+//every Messages.def message Game handles, the same entries for both encodings
+template<typename Reader>
+std::array<void (Game::*)(Reader&), Protocol::OPCODE_COUNT> Game::messageHandlers()
+{
+    std::array<void (Game::*)(Reader&), Protocol::OPCODE_COUNT> handlers{};
+    auto add = [&handlers](auto message)
+    {
+        using Message = decltype(message);
+        handlers[static_cast<uint8_t>(Message::OPCODE)] = &Game::handleMessage<Message, Reader>;
+    };
+    add(Messages::AssignId{});
+    add(Messages::Spawn{});
+    add(Messages::PlayerMove{});
+    add(Messages::PlayerJoin{});
+    add(Messages::PlayerLeave{});
+    add(Messages::UpdateTile{});
+    add(Messages::InvUpdate{});
+    add(Messages::ItemDefSync{});
+    add(Messages::UpdateRegion{});
+    add(Messages::InvSync{});
+    return handlers;
+}
 
-            std::istringstream itemSs(defString);
-            std::string itemPart;
-            std::vector<std::string> itemProps;
+//indexed by the opcode a text command interns to, anything without an entry is counted as unknown
+const std::array<Game::TextHandler, Protocol::OPCODE_COUNT> Game::textHandlers = messageHandlers<Protocol::TextReader>();
+const std::array<Game::BinaryHandler, Protocol::OPCODE_COUNT> Game::binaryHandlers = messageHandlers<Protocol::BinaryReader>();
 
-            // re-parse message using ":" to identify properties
-            while (std::getline(itemSs, itemPart, ':'))
-                itemProps.push_back(itemPart);
+void Game::handleOneNetworkMessage(const std::string_view msg)
+{
+    //fields are views into msg, nothing here allocates until a handler keeps something
+    Protocol::TextReader reader(msg);
+    const std::string_view cmd = reader.field();
+    if (cmd.empty())
+        return;
 
-            //needs: ID:Name:MaxStackSize:Type
-            if (itemProps.size() < 4) continue;
+    const TextHandler handler = textHandlers[static_cast<uint8_t>(Protocol::commandOpcode(cmd))];
+    if (!handler)
+    {
+        countUnknownMessage(msg);
+        return;
+    }
 
-            ItemDefinition itemDef;
-            itemDef.id = std::stoi(itemProps[0]);
-            itemDef.name = itemProps[1];
-            itemDef.maxStack = std::stoi(itemProps[2]);
+    (this->*handler)(reader);
+    if (!reader.ok())
+        std::cerr << "[ERROR] Bad " << cmd << " message (" << Protocol::parseErrorName(reader.getError()) << "): " << msg << std::endl;
+}
 
-            if (std::string typeCode = itemProps[3]; typeCode == "T")
-            {
-                if (itemProps.size() < 5) continue;
-                itemDef.isTile = true;
-                itemDef.tileTypeID = std::stoi(itemProps[4]);
-            }
-            else if (typeCode == "R")
-            {
-                if (itemProps.size() < 6) continue;
-                itemDef.isTile = false;
-                itemDef.tileTypeID = 0;
+//a server newer than us can send these every tick, so only the first one is worth a log line
+void Game::countUnknownMessage(const std::string_view msg)
+{
+    if (unknownMessages++ > 0)
+        return;
+    if (Protocol::isBinaryFrame(msg))
+        std::cerr << "[ERROR] Unknown opcode: " << static_cast<int>(static_cast<uint8_t>(msg[0]));
+    else
+        std::cerr << "[ERROR] Unknown command: " << msg.substr(0, msg.find(','));
+    std::cerr << " (further unknown messages are only counted)" << std::endl;
+}
 
-                const std::string& toolTypeName = itemProps[4];
-                const int damage = std::stoi(itemProps[5]);
-            }
-            else
-            {
-                 itemDef.isTile = false;
-                 itemDef.tileTypeID = 0;
-            }
+void Game::handleBinaryMessage(const std::string_view frame)
+{
+    const auto opcode = static_cast<Protocol::Opcode>(frame[0]);
+    Protocol::BinaryReader reader(frame.substr(1));
 
-            // generate textureID from name
-            std::string name = itemDef.name;
-            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
-            std::replace(name.begin(), name.end(), ' ', '_');
-            itemDef.textureID = name;
+    if (const auto op = static_cast<uint8_t>(opcode); op < Protocol::OPCODE_COUNT && binaryHandlers[op])
+    {
+        (this->*binaryHandlers[op])(reader);
+        return;
+    }
 
-            ItemRegistry::getInstance().addDefinition(itemDef);
+    switch (opcode)
+    {
+    case Protocol::Opcode::MOVE_BATCH:
+    {
+        //varint count | count * PLAYER_MOVE fields, comes in over UDP
+        const uint32_t count = reader.varint();
+        for (uint32_t i = 0; i < count; i++)
+        {
+            Messages::PlayerMove move;
+            if (!Messages::read(reader, move)) break;
+            on(move);
         }
+        break;
     }
-    else if (cmd == "PLAYER_MOVE")
+    case Protocol::Opcode::TEXT:
     {
-        const int id = std::stoi(parts[1]);
-        const float targetX = std::stof(parts[2]);
-        const float targetY = std::stof(parts[3]);
+        const std::string_view text = reader.str();
+        if (reader.ok()) handleOneNetworkMessage(text);
+        break;
+    }
+    default:
+        countUnknownMessage(frame);
+    }
+}
 
-        if (players.count(id))
-        {
-            //store targetX/Y for smoothing
-            players[id].targetX = targetX;
-            players[id].targetY = targetY;
+void Game::on(const Messages::AssignId& msg)
+{
+    localPlayerId = msg.id;
+    //a session left without discardSession (back to the menu) can still have chunks decoding
+    chunkDecoder.reset();
+    chunkDecoder.resetStats();
+    joinBurst = {};
+    joinBurst.active = true;
+    joinBurst.started = joinBurst.lastFrame = std::chrono::steady_clock::now();
+    inputHeld = inputLatched = inputSent = 0;
+    inputSequence = 0;
+    inputSamples = 0;
+    chunkStreamer.reset();
+    sentView = {};
+
+    //everyone comes back with SPAWN/PLAYER_JOIN, the world only survives a resumed session
+    players.clear();
+    deferredTileUpdates.clear();
+    if (!resuming && world)
+        world->chunks.clear();
+    resumePending = resuming;
+    resuming = false;
+}
 
-            //teleport in worst case scenario
-            if (float dist = std::sqrt(std::pow(players[id].visualX - targetX, 2) + std::pow(players[id].visualY - targetY, 2)); dist > 5.0f)
-            {
-                players[id].visualX = targetX;
-                players[id].visualY = targetY;
-            }
-        }
-    }
-    else if (cmd == "PLAYER_JOIN")
+bool Game::getPlayerPosition(const int id, float& x, float& y) const
+{
+    const auto it = players.find(id);
+    if (it == players.end())
+        return false;
+
+    x = it->second.targetX;
+    y = it->second.targetY;
+    return true;
+}
+
+void Game::on(const Messages::Spawn& msg)
+{
+    players[msg.id] = { msg.id, msg.x, msg.y, msg.x, msg.y, msg.id == localPlayerId, "Player" + std::to_string(msg.id) };
+}
+
+void Game::on(const Messages::ItemDefSync& msg)
+{
+    ItemDefList definitions(frameArena.resource());
+    const bool allRead = Messages::forEach(msg.items, [&definitions](const Messages::ItemDef& def)
     {
-        const int id = std::stoi(parts[1]);
-        const float x = std::stof(parts[2]);
-        const float y = std::stof(parts[3]);
-        players[id] = { id, x, y, x, y, false, "Player" + std::to_string(id) };
-        std::cout << "[SERVER] Player " << id << " joined\n";
+        ItemDefEntry& entry = definitions.emplace_back();
+        entry.id = def.id;
+        entry.name = def.name;
+        entry.maxStack = def.maxStack;
+        entry.isTile = def.type == 'T';
+        entry.tileTypeID = def.tileTypeId;
+    });
+
+    //a broken definition is skipped, the rest still load
+    if (!allRead)
+        std::cerr << "[ERROR] Bad ITEM_DEF_SYNC entries were skipped, " << definitions.size() << " loaded" << std::endl;
+    onItemDefinitions(definitions);
+}
+
+void Game::onItemDefinitions(const ItemDefList& definitions)
+{
+    //the registry is process wide, headless bots share a process and never draw items anyway
+    if (headless) return;
+
+    ItemRegistry::getInstance().clear();
+    for (const ItemDefEntry& entry : definitions)
+    {
+        ItemDefinition itemDef;
+        itemDef.id = entry.id;
+        itemDef.name = std::string(entry.name);
+        itemDef.maxStack = entry.maxStack;
+        itemDef.isTile = entry.isTile;
+        itemDef.tileTypeID = entry.tileTypeID;
+
+        // generate textureID from name
+        itemDef.textureID = itemDef.name;
+        std::transform(itemDef.textureID.begin(), itemDef.textureID.end(), itemDef.textureID.begin(), ::tolower);
+        std::replace(itemDef.textureID.begin(), itemDef.textureID.end(), ' ', '_');
+
+        ItemRegistry::getInstance().addDefinition(itemDef);
     }
-    else if (cmd == "PLAYER_LEAVE")
+}
+
+void Game::on(const Messages::PlayerMove& msg)
+{
+    if (msg.id == localPlayerId && moveProbePending)
     {
-        const int id = std::stoi(parts[1]);
-        players.erase(id);
-        std::cout << "[SERVER] Player " << id << " left\n";
+        moveProbePending = false;
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - moveProbeSent).count();
+        moveLatency.samples++;
+        moveLatency.totalMs += ms;
+        moveLatency.worstMs = std::max(moveLatency.worstMs, ms);
     }
-    else if (cmd == "CHUNK_DATA")
+
+    if (const auto it = players.find(msg.id); it != players.end())
     {
-        if (!world)
-            return;
+        Player& player = it->second;
+        //store targetX/Y for smoothing
+        player.targetX = msg.x;
+        player.targetY = msg.y;
 
-        int chunkX = std::stoi(parts[1]);
-        int chunkY = std::stoi(parts[2]);
-        auto chunk = std::make_unique<Chunk>(chunkX, chunkY);
+        //teleport in worst case scenario
+        if (float dist = std::sqrt(std::pow(player.visualX - msg.x, 2) + std::pow(player.visualY - msg.y, 2)); dist > 5.0f)
+        {
+            player.visualX = msg.x;
+            player.visualY = msg.y;
+        }
+    }
+}
 
-        constexpr int tilesPerLayer = Chunk::SIZE * Chunk::SIZE;
-        int tileIndexOffset = 3; //skip CHUNK_DATA, chunkX and chunkY
+void Game::on(const Messages::PlayerJoin& msg)
+{
+    players[msg.id] = { msg.id, msg.x, msg.y, msg.x, msg.y, false, "Player" + std::to_string(msg.id) };
+    std::cout << "[SERVER] Player " << msg.id << " joined\n";
+}
 
-        for (int layer = 0; layer < TileLayer::NUM_LAYERS; layer++)
-        {
-            for (int i = 0; i < tilesPerLayer; i++)
-            {
-                if (tileIndexOffset + i >= parts.size())
-                {
-                    std::cerr << "[ERROR] CHUNK_DATA message truncated. Missing tile data.\n";
-                    return;
-                }
+void Game::on(const Messages::PlayerLeave& msg)
+{
+    players.erase(msg.id);
+    std::cout << "[SERVER] Player " << msg.id << " left\n";
+}
 
-                const int type = std::stoi(parts[tileIndexOffset + i]);
-                const int x = i % Chunk::SIZE;
-                const int y = i / Chunk::SIZE;
+void Game::onChunkData(std::unique_ptr<Chunk> chunk)
+{
+    if (!world)
+        return;
 
-                chunk->setTile(x, y, layer, type);
-            }
-            tileIndexOffset += tilesPerLayer;
-        }
+    world->addChunk(std::move(chunk));
+}
 
-        world->addChunk(std::move(chunk));
-    }
-    else if (cmd == "UPDATE_TILE")
+void Game::on(const Messages::UpdateTile& msg)
+{
+    const TileUpdate update{ msg.worldX, msg.topDownWorldY, msg.tileType, msg.layer };
+    onUpdateRegion(&update, 1);
+}
+
+void Game::on(const Messages::UpdateRegion& msg)
+{
+    //everything before a bad entry still applies
+    std::pmr::vector<TileUpdate> regionUpdates(frameArena.resource());
+    const bool allRead = Messages::forEach(msg.updates, [&regionUpdates](const Messages::TileChange& change)
     {
-        if (!world) return;
-        if (parts.size() < 5) return;
+        regionUpdates.push_back({ static_cast<int>(change.worldX), static_cast<int>(change.topDownWorldY), change.tileType, change.layer });
+    });
+    if (!allRead)
+        std::cerr << "[ERROR] Bad UPDATE_REGION entry, applying the " << regionUpdates.size() << " before it" << std::endl;
+    onUpdateRegion(regionUpdates.data(), regionUpdates.size());
+}
+
+//UPDATE_TILE is just a region of one. the chunk lookup is reused while consecutive tiles share a chunk,
+//and a batch gets at most MAX_REGION_EFFECTS particle bursts and a single break sound
+void Game::onUpdateRegion(const TileUpdate* updates, const size_t count, const bool withEffects)
+{
+    if (!world) return;
 
-        const int worldX = std::stoi(parts[1]);
-        const int topDownWorldY = std::stoi(parts[2]);
-        const int newTileType = std::stoi(parts[3]);
-        const int layerIndex = std::stoi(parts[4]);
+    constexpr int worldWidthInTiles = World::WORLD_WIDTH_IN_CHUNKS * Chunk::SIZE;
+    constexpr int worldHeightInTiles = World::WORLD_HEIGHT_IN_CHUNKS * Chunk::SIZE;
 
-        if (layerIndex < 0 || layerIndex >= TileLayer::NUM_LAYERS) return;
+    Chunk* chunk = nullptr;
+    int cachedChunkX = -1, cachedChunkY = -1;
+    int effects = 0;
+    bool brokeSomething = false;
 
-        constexpr int worldWidthInTiles = World::WORLD_WIDTH_IN_CHUNKS * Chunk::SIZE;
-        constexpr int worldHeightInTiles = World::WORLD_HEIGHT_IN_CHUNKS * Chunk::SIZE;
+    for (size_t i = 0; i < count; i++)
+    {
+        const TileUpdate& update = updates[i];
+        if (update.layerIndex < 0 || update.layerIndex >= TileLayer::NUM_LAYERS) continue;
 
         //stop out of bounds
-        if (worldX < 0 || worldX >= worldWidthInTiles || topDownWorldY < 0 || topDownWorldY >= worldHeightInTiles)
-            return;
-
-        const int bottomUpWorldY = worldHeightInTiles - 1 - topDownWorldY;
-        const int chunkX = static_cast<int>(std::floor(static_cast<float>(worldX) / Chunk::SIZE));
-        const int chunkY_BottomUp = static_cast<int>(std::floor(static_cast<float>(bottomUpWorldY) / Chunk::SIZE));
+        if (update.worldX < 0 || update.worldX >= worldWidthInTiles || update.topDownWorldY < 0 || update.topDownWorldY >= worldHeightInTiles)
+            continue;
 
-        //another oob check
-        if (chunkX < 0 || chunkX >= World::WORLD_WIDTH_IN_CHUNKS || chunkY_BottomUp < 0 || chunkY_BottomUp >= World::WORLD_HEIGHT_IN_CHUNKS)
-            return;
+        const int bottomUpWorldY = worldHeightInTiles - 1 - update.topDownWorldY;
+        const int chunkX = update.worldX / Chunk::SIZE;
+        const int chunkY_BottomUp = bottomUpWorldY / Chunk::SIZE;
 
-        const int tileX = (worldX % Chunk::SIZE + Chunk::SIZE) % Chunk::SIZE;
-        const int tileY_BottomUp = (bottomUpWorldY % Chunk::SIZE + Chunk::SIZE) % Chunk::SIZE;
+        //the chunk is still on a decoder thread, setting the tile now would get overwritten when it lands
+        if (chunkDecoder.isPending(chunkX, chunkY_BottomUp))
+        {
+            deferredTileUpdates[ChunkDecoder::coordsKey(chunkX, chunkY_BottomUp)].push_back(update);
+            continue;
+        }
 
-        if (newTileType == 0)
+        if (chunkX != cachedChunkX || chunkY_BottomUp != cachedChunkY)
         {
-            if (Chunk* chunk = world->getChunk(chunkX, chunkY_BottomUp))
-                if (int prevBlock = chunk->getTile(tileX, tileY_BottomUp, layerIndex).type; prevBlock != 0)
-                    particleManager->spawnEffect(static_cast<float>(worldX), static_cast<float>(topDownWorldY), getTextureIDFromType(prevBlock));
-            AudioManager::getInstance().playSFX("block_break");
+            chunk = world->getChunk(chunkX, chunkY_BottomUp);
+            cachedChunkX = chunkX;
+            cachedChunkY = chunkY_BottomUp;
         }
+        if (!chunk) continue;
 
-        if (Chunk* chunk = world->getChunk(chunkX, chunkY_BottomUp))
-            chunk->setTile(tileX, tileY_BottomUp, layerIndex, newTileType);
-    }
-    else if (cmd == "INV_UPDATE")
-    {
-        //format: INV_UPDATE,playerID,slotIndex,itemID,quantity
-        if (parts.size() < 5) return;
-        const int slotIndex = std::stoi(parts[2]);
-        const int itemID = std::stoi(parts[3]);
-        const int quantity = std::stoi(parts[4]);
+        const int tileX = update.worldX % Chunk::SIZE;
+        const int tileY_BottomUp = bottomUpWorldY % Chunk::SIZE;
 
-        inventory.updateSlot(slotIndex, itemID, quantity);
-        if (ItemRegistry::getInstance().getDefinition(itemID).id == 0 && itemID != 0) {
-            std::cerr << "[WARNING] Received INV_UPDATE for unknown item ID: " << itemID
-                      << " in slot " << slotIndex << ". Check if ITEM_DEF_SYNC ran first.\n";
-        }
-    }
-    else if (cmd == "INV_SYNC")
-    {
-        //TODO: hardcoded because im lazy | change if java inventory size changes in the future x
-        constexpr int TOTAL_SLOTS = 40;
-        for (int i = 0; i < TOTAL_SLOTS; i++)
+        if (update.newTileType == 0 && withEffects && !headless)
         {
-            if (const int partIndex = 2 + (i * 2); partIndex + 1 < parts.size())
+            brokeSomething = true;
+            if (const int prevBlock = chunk->getTile(tileX, tileY_BottomUp, update.layerIndex).type; prevBlock != 0 && effects < MAX_REGION_EFFECTS)
             {
-                try
-                {
-                    const int itemID = std::stoi(parts[partIndex]);
-                    const int quantity = std::stoi(parts[partIndex + 1]);
-                    inventory.updateSlot(i, itemID, quantity);
-                }
-                catch (const std::exception& e)
-                {
-                    std::cerr << "[ERROR] Failed to parse INV_SYNC data for slot " << i << ": " << e.what() << std::endl;
-                    return; //if one slot is corrupted more might be so just stop
-                }
-            }
-            else //message is shorter than expected
-            {
-                std::cerr << "[ERROR] INV_SYNC message truncated, stopping load at slot: " << i << std::endl;
-                break;
+                particleManager->spawnEffect(static_cast<float>(update.worldX), static_cast<float>(update.topDownWorldY), getTextureIDFromType(prevBlock));
+                effects++;
             }
         }
+
+        chunk->setTile(tileX, tileY_BottomUp, update.layerIndex, update.newTileType);
     }
-    else std::cerr << "[ERROR] Unknown command: " << cmd << std::endl;
+
+    if (brokeSomething)
+        AudioManager::getInstance().playSFX("block_break");
+}
+
+void Game::on(const Messages::InvUpdate& msg)
+{
+    inventory.updateSlot(msg.slotIndex, msg.itemId, msg.quantity);
+    if (!headless && ItemRegistry::getInstance().getDefinition(msg.itemId).id == 0 && msg.itemId != 0) {
+        std::cerr << "[WARNING] Received INV_UPDATE for unknown item ID: " << msg.itemId
+                  << " in slot " << msg.slotIndex << ". Check if ITEM_DEF_SYNC ran first.\n";
+    }
+}
+
+void Game::on(const Messages::InvSync& msg)
+{
+    //TODO: hardcoded because im lazy | change if java inventory size changes in the future x
+    constexpr int TOTAL_SLOTS = 40;
+
+    //slots before a corrupted one still load, the bad one and everything after it dont
+    int loaded = 0;
+    const bool allRead = Messages::forEach(msg.slots, [this, &loaded](const Messages::InvSlot& slot)
+    {
+        if (loaded < TOTAL_SLOTS)
+            inventory.updateSlot(loaded++, slot.itemId, slot.quantity);
+    });
+    if (!allRead || loaded < TOTAL_SLOTS)
+        std::cerr << "[ERROR] INV_SYNC message truncated, stopping load at slot: " << loaded << std::endl;
 }
 
 void Game::handleInput(const SDL_Event& e)
@@ -303,10 +509,17 @@ void Game::handleInput(const SDL_Event& e)
         isInventoryOpen = !isInventoryOpen;
         return;
     }
+    //network overlay toggle
+    if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F3 && !e.key.repeat)
+    {
+        isNetOverlayOpen = !isNetOverlayOpen;
+        return;
+    }
     //freecam toggle
     if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F1 && !e.key.repeat)
     {
         isFreecamActive = !isFreecamActive;
+        inputHeld = 0; //keys held into freecam shouldnt keep the player walking
         if (isFreecamActive)
 
             //when active, anchor the camera's target to its exact screen position on the x/y
@@ -353,11 +566,7 @@ void Game::handleInput(const SDL_Event& e)
 
                 //tell server it needs to rearrange the items otherwise big problems (items are only a visual update 🤬)
                 if (network)
-                {
-                    std::ostringstream oss;
-                    oss << "INV_MOVE_ITEM," << targetSlotIndex << "," << targetSlot.itemID << "," << targetSlot.quantity;
-                    network->queueMessage(oss.str());
-                }
+                    network->sendInvMoveItem(targetSlotIndex, targetSlot.itemID, targetSlot.quantity);
             }
         }
         return;
@@ -367,27 +576,17 @@ void Game::handleInput(const SDL_Event& e)
     {
         bool isKeyDown = (e.type == SDL_KEYDOWN);
 
-        //player movement
+        //player movement, sent on the next input tick
         if (!isFreecamActive)
         {
-            std::string action;
             switch (e.key.keysym.sym)
             {
-                case SDLK_w: action = (isKeyDown ? "UP_DOWN" : "UP_UP"); break;       //jump
-                case SDLK_s: action = (isKeyDown ? "DOWN_DOWN" : "DOWN_UP"); break;   //unused for now
-                case SDLK_a: action = (isKeyDown ? "LEFT_DOWN" : "LEFT_UP"); break;   //move left
-                case SDLK_d: action = (isKeyDown ? "RIGHT_DOWN" : "RIGHT_UP"); break; //move right
+                case SDLK_w: setInputKey(Protocol::InputBits::JUMP, isKeyDown); break;
+                case SDLK_s: setInputKey(Protocol::InputBits::DOWN, isKeyDown); break; //unused for now
+                case SDLK_a: setInputKey(Protocol::InputBits::LEFT, isKeyDown); break;
+                case SDLK_d: setInputKey(Protocol::InputBits::RIGHT, isKeyDown); break;
                 default: break;
             }
-
-            if (!action.empty())
-            {
-                std::ostringstream oss;
-                oss << "INPUT," << localPlayerId << "," << action;
-
-                if (network)
-                    network->queueMessage(oss.str());
-            }
         }
 
         //freecam movement
@@ -424,10 +623,8 @@ void Game::handleInput(const SDL_Event& e)
         if (tileX <= 0 || tileX >= worldWidthInTiles - 1 || tileYFlipped <= 0 || tileYFlipped >= worldHeightInTiles - 1)
             return;
 
-        std::ostringstream oss;
-        oss << "USE_ITEM," << slotIndex << "," << tileX << "," << tileYFlipped;
         if (network)
-            network->queueMessage(oss.str());
+            network->sendUseItem(slotIndex, tileX, tileYFlipped);
     }
     //scroll wheel cycle for tiles/speed/zoom
     else if (e.type == SDL_MOUSEWHEEL)
@@ -545,6 +742,79 @@ int Game::getSlotIndexAt(const int mouseX, const int mouseY, const int winW, con
     return -1; //no slot found
 }
 
+ChunkRect Game::chunkRectAt(const float cameraX, const float cameraY, const float zoom, const int winW, const int winH)
+{
+    constexpr float CHUNK_SIZE_PX = static_cast<float>(Chunk::SIZE * World::TILE_PX_SIZE);
+    const int startChunkX = std::clamp(static_cast<int>(std::floor(-cameraX / zoom / CHUNK_SIZE_PX)), 0, World::WORLD_WIDTH_IN_CHUNKS - 1);
+    const int endChunkX = std::clamp(static_cast<int>(std::ceil((winW - cameraX) / zoom / CHUNK_SIZE_PX)) - 1, 0, World::WORLD_WIDTH_IN_CHUNKS - 1);
+    const int startChunkY_Down = std::clamp(static_cast<int>(std::floor(-cameraY / zoom / CHUNK_SIZE_PX)), 0, World::WORLD_HEIGHT_IN_CHUNKS - 1);
+    const int endChunkY_Down = std::clamp(static_cast<int>(std::ceil((winH - cameraY) / zoom / CHUNK_SIZE_PX)) - 1, 0, World::WORLD_HEIGHT_IN_CHUNKS - 1);
+
+    //flip to the server's bottom-up chunk rows
+    return { startChunkX, World::WORLD_HEIGHT_IN_CHUNKS - 1 - endChunkY_Down, endChunkX, World::WORLD_HEIGHT_IN_CHUNKS - 1 - startChunkY_Down };
+}
+
+ChunkRect Game::targetView() const
+{
+    const float zoom = camera.getZoom();
+    if (isFreecamActive)
+        return chunkRectAt(camera.getTargetX(), camera.getTargetY(), zoom, viewWidth, viewHeight);
+
+    //same centring as Camera::setTarget, worked out here so it also works headless where update() never runs
+    const auto it = players.find(localPlayerId);
+    if (it == players.end())
+        return {};
+    const float playerCentreX = it->second.targetX * World::TILE_PX_SIZE + World::TILE_PX_SIZE / 2.0f;
+    const float playerCentreY = it->second.targetY * World::TILE_PX_SIZE + World::TILE_PX_SIZE / 2.0f;
+    return chunkRectAt(viewWidth / 2.0f - playerCentreX * zoom, viewHeight / 2.0f - playerCentreY * zoom, zoom, viewWidth, viewHeight);
+}
+
+void Game::updateChunkStreaming(const std::chrono::steady_clock::time_point now)
+{
+    if (!network || localPlayerId == -1)
+        return;
+    //PROTO_ACK is in once the connection is binary, if it accepted RESUME only changed chunks are coming
+    if (resumePending && network->isBinaryProtocol())
+    {
+        resumePending = false;
+        if (network->isResumed() && world)
+        {
+            for (const auto& [key, chunk] : world->chunks)
+                chunkStreamer.onChunkReceived(chunk->chunkX, chunk->chunkY);
+            joinBurst.chunksInstalled = world->chunks.size();
+            std::cout << "[CLIENT] Resumed with " << world->chunks.size() << " chunks already held" << std::endl;
+        }
+    }
+
+    const ChunkRect view = targetView();
+    if (view.empty())
+        return; //not spawned yet
+
+    if (joinBurst.firstFullScreenMs < 0.0 && chunkStreamer.isLoaded(view))
+    {
+        joinBurst.firstFullScreenMs = std::chrono::duration<double, std::milli>(now - joinBurst.started).count();
+        std::cout << "[CLIENT] First full screen after " << joinBurst.firstFullScreenMs << "ms ("
+                  << (network->isStreamingChunks() ? "streamed" : "bulk push") << ", " << chunkStreamer.getStats().received
+                  + chunkStreamer.getStats().unrequested << " chunks in)" << std::endl;
+    }
+
+    if (!network->isStreamingChunks())
+        return;
+
+    if (view != sentView)
+    {
+        network->sendView(view);
+        sentView = view;
+    }
+
+    //requests can wait a frame while the send queue is backed up, the VIEW above is the one that matters
+    if (network->isSendBacklogged())
+        return;
+    chunkRequests.clear();
+    chunkStreamer.update(view, now, chunkRequests);
+    network->sendChunkRequests(chunkRequests, frameArena.resource()); //held until the next processNetworkMessages resets it
+}
+
 void Game::render(SDL_Renderer* renderer)
 {
     const TextureManager& texManager = TextureManager::getInstance();
@@ -569,10 +839,13 @@ void Game::render(SDL_Renderer* renderer)
     constexpr float TILE_PX_SIZE = static_cast<float>(World::TILE_PX_SIZE);
     constexpr float CHUNK_SIZE_PX = static_cast<float>(Chunk::SIZE * World::TILE_PX_SIZE);
 
-    int startChunkX = std::clamp(static_cast<int>(std::floor(cullLeftPix / CHUNK_SIZE_PX)), 0, World::WORLD_WIDTH_IN_CHUNKS - 1);
-    int endChunkX = std::clamp(static_cast<int>(std::ceil(cullRightPix / CHUNK_SIZE_PX)) - 1, 0, World::WORLD_WIDTH_IN_CHUNKS - 1);
-    int startChunkY_Down = std::clamp(static_cast<int>(std::floor(cullTopPix / CHUNK_SIZE_PX)), 0, World::WORLD_HEIGHT_IN_CHUNKS - 1);
-    int endChunkY_Down = std::clamp(static_cast<int>(std::ceil(cullBottomPix / CHUNK_SIZE_PX)) - 1, 0, World::WORLD_HEIGHT_IN_CHUNKS - 1);
+    viewWidth = winW;
+    viewHeight = winH;
+    const ChunkRect visible = chunkRectAt(cameraX, cameraY, zoom, winW, winH);
+    const int startChunkX = visible.minX;
+    const int endChunkX = visible.maxX;
+    const int startChunkY_Down = World::WORLD_HEIGHT_IN_CHUNKS - 1 - visible.maxY;
+    const int endChunkY_Down = World::WORLD_HEIGHT_IN_CHUNKS - 1 - visible.minY;
 
     //render the world layers
     for (int layer = TileLayer::NUM_LAYERS - 1; layer >= 0; --layer)
@@ -705,11 +978,164 @@ void Game::render(SDL_Renderer* renderer)
     if (isFreecamActive)
         drawText(renderer, "Explore Mode [WASD]", winW / 2 - 375, margin + 8, { 255, 255, 0, 255 });
 
+    if (isNetOverlayOpen)
+        renderNetOverlay(renderer);
+
     SDL_RenderPresent(renderer);
 }
 
+void Game::renderNetOverlay(SDL_Renderer* renderer)
+{
+    if (!network) return;
+
+    if (const auto now = std::chrono::steady_clock::now(); now - overlayRefreshed >= std::chrono::seconds(1))
+    {
+        overlayPrevious = overlayCurrent;
+        overlayCurrent = network->getTelemetry().snapshot();
+        overlayRefreshed = now;
+    }
+    const NetTelemetry::Snapshot& snap = overlayCurrent;
+    const double seconds = std::max(0.001, snap.elapsedSeconds - overlayPrevious.elapsedSeconds);
+
+    std::vector<std::string> lines;
+    std::ostringstream line;
+    line.precision(1);
+    line << std::fixed << "RTT " << snap.smoothedRttMs << "ms (last " << snap.lastRttMs << ", min " << snap.minRttMs << ")";
+    lines.push_back(line.str());
+
+    line.str("");
+    line << "In " << (snap.bytesIn - std::min(snap.bytesIn, overlayPrevious.bytesIn)) / seconds / 1024.0 << " KB/s  Out "
+         << (snap.bytesOut - std::min(snap.bytesOut, overlayPrevious.bytesOut)) / seconds / 1024.0 << " KB/s  "
+         << (network->isBinaryProtocol() ? "[v2]" : "[v1]");
+    lines.push_back(line.str());
+
+    line.str("");
+    line << "Queues: send " << snap.sendQueueDepth << " (max " << snap.maxSendQueueDepth << ")  recv " << snap.receiveQueueDepth
+         << " (max " << snap.maxReceiveQueueDepth << ")  chunks " << chunkDecoder.inFlightCount();
+    lines.push_back(line.str());
+
+    line.str("");
+    line << "Input: " << inputSequence << " states sent over " << inputSamples << " ticks";
+    lines.push_back(line.str());
+
+    line.str("");
+    if (const ClockSync::Estimate clock = network->getClock().estimate(); clock.synced)
+        line << "Clock: server " << (clock.offsetUs >= 0.0 ? "+" : "") << clock.offsetUs / 1000.0 << "ms  drift " << clock.driftPpm
+             << "ppm  best rtt " << clock.bestRttMs << "ms  (" << clock.probes << " probes)";
+    else
+        line << "Clock: not synced";
+    lines.push_back(line.str());
+
+    line.str("");
+    if (const UdpStats udp = network->getUdpStats(); udp.active)
+        line << "UDP: " << udp.datagramsIn << " in (" << udp.movesIn << " moves)  " << udp.datagramsOut << " out  stale " << udp.staleDropped
+             << "  dropped " << udp.queueDropped;
+    else
+        line << "UDP: off, movement on TCP";
+    if (moveLatency.samples > 0)
+        line << "  |  key->move " << moveLatency.totalMs / static_cast<double>(moveLatency.samples) << "ms avg, " << moveLatency.worstMs << "ms worst";
+    lines.push_back(line.str());
+
+    line.str("");
+    const SendQueueStats queued = network->getSendQueueStats();
+    line << "Send queue: merged " << queued.merged << "  deduped " << queued.deduplicated << "  dropped " << queued.dropped
+         << "  max " << queued.maxDepth << (network->isSendBacklogged() ? "  BACKLOGGED" : "");
+    lines.push_back(line.str());
+
+    line.str("");
+    if (AllocCounter::ENABLED)
+        line << "Allocs: " << static_cast<double>(messageAllocs.total) / static_cast<double>(std::max<uint64_t>(messageAllocs.frames, 1))
+             << " per frame handling messages (worst " << messageAllocs.worst << ")  arena " << (frameArena.isEnabled() ? "on" : "off")
+             << ", peak " << frameArena.highWaterBytes() / 1024 << "KB";
+    else
+        line << "Allocs: not counted, build with SWAGARIA_COUNT_ALLOCS";
+    lines.push_back(line.str());
+    if (unknownMessages > 0)
+        lines.push_back("Unknown messages: " + std::to_string(unknownMessages));
+
+    //busiest opcodes by bytes
+    std::vector<size_t> order;
+    for (size_t op = 0; op < Protocol::OPCODE_COUNT; op++)
+        if (snap.opcodes[op].messagesIn > 0 || snap.opcodes[op].messagesOut > 0)
+            order.push_back(op);
+    std::sort(order.begin(), order.end(), [&snap](const size_t a, const size_t b)
+    {
+        return snap.opcodes[a].bytesIn + snap.opcodes[a].bytesOut > snap.opcodes[b].bytesIn + snap.opcodes[b].bytesOut;
+    });
+    if (order.size() > 8) order.resize(8);
+
+    for (const size_t op : order)
+    {
+        const NetTelemetry::OpcodeCounters& counters = snap.opcodes[op];
+        line.str("");
+        line << Protocol::opcodeName(static_cast<uint8_t>(op)) << "  in " << counters.messagesIn << " / " << counters.bytesIn / 1024.0 << "KB";
+        if (counters.messagesIn > 0)
+            line << " (" << static_cast<double>(counters.parseNs) / counters.messagesIn / 1000.0 << "us)";
+        if (counters.messagesOut > 0)
+            line << "  out " << counters.messagesOut << " / " << counters.bytesOut / 1024.0 << "KB";
+        lines.push_back(line.str());
+    }
+
+    constexpr int lineHeight = 22;
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+    const SDL_Rect background = { 5, 45, 560, static_cast<int>(lines.size()) * lineHeight + 10 };
+    SDL_RenderFillRect(renderer, &background);
+
+    for (size_t i = 0; i < lines.size(); i++)
+        drawText(renderer, lines[i], 12, 50 + static_cast<int>(i) * lineHeight, { 200, 255, 200, 255 });
+}
+
+void Game::setInputKey(const uint8_t bit, const bool down)
+{
+    if (down)
+    {
+        inputHeld |= bit;
+        inputLatched |= bit;
+    }
+    else inputHeld &= ~bit;
+}
+
+void Game::sampleInput(const std::chrono::steady_clock::time_point now)
+{
+    if (localPlayerId == -1 || !network || now - lastInputSample < INPUT_TICK)
+        return;
+    lastInputSample = now;
+    inputSamples++;
+
+    const uint8_t state = inputHeld | inputLatched;
+    inputLatched = 0;
+    if (moveProbePending && now - moveProbeSent > MOVE_PROBE_TIMEOUT)
+        moveProbePending = false;
+
+    if (state == inputSent)
+    {
+        //nothing changed since the last state the server got, but a datagram can be lost so UDP gets a few repeats
+        if (inputRepeats > 0 && network->isUdpActive())
+        {
+            inputRepeats--;
+            network->sendInputState(inputSequence, state, state, localPlayerId);
+        }
+        return;
+    }
+
+    constexpr uint8_t movementBits = Protocol::InputBits::LEFT | Protocol::InputBits::RIGHT | Protocol::InputBits::JUMP;
+    if (!moveProbePending && (state & ~inputSent & movementBits))
+    {
+        moveProbePending = true;
+        moveProbeSent = now;
+    }
+
+    network->sendInputState(++inputSequence, state, inputSent, localPlayerId);
+    inputSent = state;
+    inputRepeats = UDP_INPUT_REPEATS;
+}
+
 void Game::update()
 {
+    const auto now = std::chrono::steady_clock::now();
+    sampleInput(now);
+    updateChunkStreaming(now);
     if (particleManager) particleManager->update(0.016f); //idk the delta time sdl stuff
 
     float lerpSpeed = 0.8f; //lower = smoother but laggier | higher = snappier but more jitter
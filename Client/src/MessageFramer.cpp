@@ -0,0 +1,88 @@
+#include "../include/MessageFramer.h"
+#include "../include/Protocol.h"
+#include <cstring>
+
+MessageFramer::MessageFramer(const size_t capacity) : buffer(capacity) {}
+
+char* MessageFramer::prepareWrite()
+{
+    if (readPos == writePos)
+    {
+        //everything consumed, start over at the front for free
+        readPos = scanPos = writePos = 0;
+    }
+    else if (writeSpace() < MIN_READ_SPACE && readPos > 0)
+    {
+        //slide the partial message to the front, this is the only copy the framer ever does
+        const size_t pending = writePos - readPos;
+        std::memmove(buffer.data(), buffer.data() + readPos, pending);
+        scanPos -= readPos;
+        writePos = pending;
+        readPos = 0;
+    }
+
+    //a single message bigger than the buffer, grow so it can still be framed
+    if (writeSpace() < MIN_READ_SPACE)
+        buffer.resize(buffer.size() * 2);
+
+    return buffer.data() + writePos;
+}
+
+bool MessageFramer::nextLine(std::string_view& line)
+{
+    if (scanPos >= writePos)
+        return false;
+
+    const char* start = buffer.data() + scanPos;
+    const auto* newline = static_cast<const char*>(std::memchr(start, '\n', writePos - scanPos));
+    if (!newline)
+    {
+        scanPos = writePos; //dont rescan these bytes when more data arrives
+        return false;
+    }
+
+    const size_t end = static_cast<size_t>(newline - buffer.data());
+    size_t lineEnd = end;
+    if (lineEnd > readPos && buffer[lineEnd - 1] == '\r')
+        lineEnd--;
+
+    line = std::string_view(buffer.data() + readPos, lineEnd - readPos);
+    readPos = scanPos = end + 1;
+    return true;
+}
+
+bool MessageFramer::nextFrame(std::string_view& frame)
+{
+    if (error || readPos >= writePos)
+        return false;
+
+    uint32_t length = 0;
+    const size_t available = writePos - readPos;
+    const size_t prefixSize = Protocol::readVarint(buffer.data() + readPos, available, length);
+    if (prefixSize == 0)
+    {
+        //either the prefix hasnt fully arrived yet or it is longer than any valid varint
+        if (available >= Protocol::MAX_VARINT_BYTES)
+            error = true;
+        return false;
+    }
+
+    if (length == 0 || length > Protocol::MAX_FRAME_SIZE)
+    {
+        error = true;
+        return false;
+    }
+
+    if (available - prefixSize < length)
+        return false;
+
+    frame = std::string_view(buffer.data() + readPos + prefixSize, length);
+    readPos = scanPos = readPos + prefixSize + length;
+    return true;
+}
+
+void MessageFramer::reset()
+{
+    readPos = scanPos = writePos = 0;
+    error = false;
+}
@@ -0,0 +1,115 @@
+#include "../include/NetCapture.h"
+#include <cstring>
+#include <iostream>
+
+namespace NetCapture
+{
+    namespace
+    {
+        void putLE(std::ofstream& file, uint64_t value, const int bytes)
+        {
+            char out[8];
+            for (int i = 0; i < bytes; i++, value >>= 8)
+                out[i] = static_cast<char>(value & 0xFF);
+            file.write(out, bytes);
+        }
+
+        bool getLE(std::ifstream& file, uint64_t& value, const int bytes)
+        {
+            unsigned char in[8];
+            if (!file.read(reinterpret_cast<char*>(in), bytes))
+                return false;
+
+            value = 0;
+            for (int i = bytes - 1; i >= 0; i--)
+                value = (value << 8) | in[i];
+            return true;
+        }
+    }
+
+    bool Writer::open(const std::string& path)
+    {
+        if (file.is_open())
+        {
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+            putLE(file, static_cast<uint64_t>(ns), 8);
+            putLE(file, 0, 4);
+            sessions++;
+            std::cout << "[NETWORK] Capture continues with session " << sessions << " in " << path << std::endl;
+            return true;
+        }
+
+        buffer.resize(1 << 20);
+        file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            std::cerr << "[ERROR] Failed to open capture file: " << path << std::endl;
+            return false;
+        }
+
+        file.write(MAGIC, MAGIC_SIZE);
+        started = std::chrono::steady_clock::now();
+        messages = 0;
+        sessions = 1;
+        std::cout << "[NETWORK] Capturing incoming messages to " << path << std::endl;
+        return true;
+    }
+
+    void Writer::record(const std::string_view msg)
+    {
+        if (msg.size() > MAX_RECORD_SIZE)
+            return; //the reader would take it for corruption
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+        putLE(file, static_cast<uint64_t>(ns), 8);
+        putLE(file, msg.size(), 4);
+        file.write(msg.data(), static_cast<std::streamsize>(msg.size()));
+        messages++;
+    }
+
+    void Writer::flush()
+    {
+        if (file.is_open())
+            file.flush();
+    }
+
+    void Writer::close()
+    {
+        if (!file.is_open())
+            return;
+
+        file.close();
+        std::cout << "[NETWORK] Capture closed, " << messages << " messages recorded over " << sessions << " sessions" << std::endl;
+    }
+
+    bool Reader::open(const std::string& path)
+    {
+        file.open(path, std::ios::binary | std::ios::ate);
+        fileSize = file ? static_cast<uint64_t>(file.tellg()) : 0;
+        file.seekg(0);
+        char magic[MAGIC_SIZE];
+        if (!file || !file.read(magic, MAGIC_SIZE) || std::memcmp(magic, MAGIC, MAGIC_SIZE) != 0)
+        {
+            std::cerr << "[ERROR] " << path << " is not a capture file" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool Reader::next(Record& record)
+    {
+        uint64_t length;
+        if (!getLE(file, record.timestampNs, 8) || !getLE(file, length, 4))
+            return false;
+
+        const uint64_t left = fileSize - static_cast<uint64_t>(file.tellg());
+        if (length > MAX_RECORD_SIZE || length > left)
+        {
+            std::cerr << "[ERROR] Bad capture record: " << length << " bytes with " << left << " left in the file" << std::endl;
+            return false;
+        }
+
+        record.data.resize(length);
+        return static_cast<bool>(file.read(record.data.data(), static_cast<std::streamsize>(length)));
+    }
+}
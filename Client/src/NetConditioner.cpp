@@ -0,0 +1,263 @@
+#include "../include/NetConditioner.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+NetConditioner::Config NetConditioner::Config::fromArgs(const int argc, char* argv[])
+{
+    Config config;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--net-config")
+        {
+            std::ifstream file(argv[++i]);
+            if (!file)
+            {
+                std::cerr << "[ERROR] Failed to open net config: " << argv[i] << std::endl;
+                continue;
+            }
+
+            std::string line;
+            while (std::getline(file, line))
+            {
+                const size_t equals = line.find('=');
+                if (line.empty() || line[0] == '#' || equals == std::string::npos)
+                    continue;
+                if (!config.set(line.substr(0, equals), std::atoi(line.c_str() + equals + 1)))
+                    std::cerr << "[ERROR] Unknown net config key: " << line.substr(0, equals) << std::endl;
+            }
+        }
+        else if (arg.rfind("--net-", 0) == 0)
+        {
+            //--net-stall-every -> stall_every_ms etc
+            std::string key = arg.substr(6);
+            std::replace(key.begin(), key.end(), '-', '_');
+            if (key != "seed") key += key == "bandwidth" ? "_kbps" : "_ms";
+
+            if (config.set(key, std::atoi(argv[i + 1])))
+                i++;
+        }
+    }
+    return config;
+}
+
+bool NetConditioner::Config::set(const std::string& key, const int value)
+{
+    const int clamped = std::max(0, value);
+    if (key == "delay_ms") delayMs = clamped;
+    else if (key == "jitter_ms") jitterMs = clamped;
+    else if (key == "bandwidth_kbps") bandwidthKBps = clamped;
+    else if (key == "stall_every_ms") stallEveryMs = clamped;
+    else if (key == "stall_ms") stallMs = clamped;
+    else if (key == "seed") seed = static_cast<uint32_t>(value);
+    else return false;
+    return true;
+}
+
+NetConditioner::NetConditioner(TCPsocket socket, const Config& config)
+    : socket(socket), config(config),
+      uplink(this->config, config.seed, std::chrono::steady_clock::now()),
+      downlink(this->config, config.seed + 1, std::chrono::steady_clock::now())
+{
+    std::cout << "[NETWORK] Conditioner on: " << config.delayMs << "ms +-" << config.jitterMs << "ms one way, "
+              << (config.bandwidthKBps > 0 ? std::to_string(config.bandwidthKBps) + " KB/s" : "unlimited")
+              << ", stall " << config.stallMs << "ms every " << config.stallEveryMs << "ms, seed " << config.seed << std::endl;
+
+    uplinkThread = std::thread(&NetConditioner::uplinkLoop, this);
+    downlinkThread = std::thread(&NetConditioner::downlinkLoop, this);
+}
+
+NetConditioner::~NetConditioner()
+{
+    shutdown();
+    if (uplinkThread.joinable()) uplinkThread.join();
+    if (downlinkThread.joinable()) downlinkThread.join();
+}
+
+int NetConditioner::send(const char* data, const int len)
+{
+    uplink.push(data, static_cast<size_t>(len));
+    return len;
+}
+
+int NetConditioner::receive(char* dest, const int space)
+{
+    return static_cast<int>(downlink.pop(dest, static_cast<size_t>(space)));
+}
+
+void NetConditioner::shutdown()
+{
+    uplink.close(true);
+    downlink.close(true);
+}
+
+void NetConditioner::logStats() const
+{
+    auto log = [](const char* direction, const Stats& stats)
+    {
+        if (stats.segments == 0) return;
+        std::cout << "[NETWORK] Conditioner " << direction << ": " << stats.bytes << " bytes in " << stats.segments << " segments | delay avg "
+                  << stats.totalDelayUs / stats.segments / 1000 << "ms, max " << stats.maxDelayUs / 1000 << "ms, "
+                  << stats.stalledSegments << " held by stalls" << std::endl;
+    };
+    log("up", uplink.getStats());
+    log("down", downlink.getStats());
+}
+
+void NetConditioner::uplinkLoop()
+{
+    std::string segment;
+    while (uplink.waitForDue(segment))
+    {
+        if (SDLNet_TCP_Send(socket, segment.data(), static_cast<int>(segment.size())) < static_cast<int>(segment.size()))
+        {
+            downlink.close(true); //surfaces the failure to the receive loop like a real disconnect would
+            break;
+        }
+    }
+}
+
+void NetConditioner::downlinkLoop()
+{
+    char buffer[16384];
+    while (true)
+    {
+        const int bytes = SDLNet_TCP_Recv(socket, buffer, sizeof(buffer));
+        if (bytes <= 0)
+            break;
+        downlink.push(buffer, static_cast<size_t>(bytes));
+    }
+    downlink.close(false); //already queued bytes still drain before the close is seen
+}
+
+NetConditioner::DelayLine::DelayLine(const Config& config, const uint32_t seed, const std::chrono::steady_clock::time_point epoch)
+    : config(config), epoch(epoch), rng(seed), linkFreeAt(epoch), lastRelease(epoch)
+{
+}
+
+std::chrono::steady_clock::time_point NetConditioner::DelayLine::skipStall(const std::chrono::steady_clock::time_point t, bool& stalled) const
+{
+    stalled = false;
+    if (config.stallEveryMs <= 0 || config.stallMs <= 0)
+        return t;
+
+    //stall windows sit at the end of every period so the first stallEvery ms are clean
+    const auto period = std::chrono::milliseconds(config.stallEveryMs + config.stallMs);
+    const auto intoPeriod = (t - epoch) % period;
+    if (intoPeriod < std::chrono::milliseconds(config.stallEveryMs))
+        return t;
+
+    stalled = true;
+    return t - intoPeriod + period;
+}
+
+std::chrono::steady_clock::time_point NetConditioner::DelayLine::releaseTime(const size_t bytes)
+{
+    const auto now = std::chrono::steady_clock::now();
+
+    //serialise onto the capped link first, then fly for delay +- jitter
+    auto sent = std::max(now, linkFreeAt);
+    if (config.bandwidthKBps > 0)
+        sent += std::chrono::microseconds(bytes * 1000000 / (static_cast<uint64_t>(config.bandwidthKBps) * 1024));
+    linkFreeAt = sent;
+
+    int delayMs = config.delayMs;
+    if (config.jitterMs > 0)
+        delayMs += std::uniform_int_distribution(-config.jitterMs, config.jitterMs)(rng);
+
+    bool stalled;
+    const auto release = skipStall(std::max(sent + std::chrono::milliseconds(std::max(0, delayMs)), lastRelease), stalled);
+    lastRelease = release;
+
+    const auto delayUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(release - now).count());
+    stats.segments++;
+    stats.bytes += bytes;
+    stats.totalDelayUs += delayUs;
+    stats.maxDelayUs = std::max(stats.maxDelayUs, delayUs);
+    stats.stalledSegments += stalled ? 1 : 0;
+    return release;
+}
+
+void NetConditioner::DelayLine::push(const char* data, const size_t len)
+{
+    {
+        std::lock_guard lock(mutex);
+        for (size_t offset = 0; offset < len; offset += SEGMENT_SIZE)
+        {
+            const size_t size = std::min(SEGMENT_SIZE, len - offset);
+            const auto release = releaseTime(size);
+            segments.push_back({ release, std::string(data + offset, size) });
+        }
+    }
+    condition.notify_all();
+}
+
+bool NetConditioner::DelayLine::waitForHead(std::unique_lock<std::mutex>& lock)
+{
+    while (!aborted)
+    {
+        if (segments.empty())
+        {
+            if (closed) return false;
+            condition.wait(lock);
+        }
+        else if (segments.front().release <= std::chrono::steady_clock::now())
+            return true;
+        else
+            condition.wait_until(lock, segments.front().release);
+    }
+    return false;
+}
+
+size_t NetConditioner::DelayLine::pop(char* dest, const size_t space)
+{
+    std::unique_lock lock(mutex);
+    if (!waitForHead(lock))
+        return 0;
+
+    //hand out everything thats due, up to space
+    size_t copied = 0;
+    const auto now = std::chrono::steady_clock::now();
+    while (copied < space && !segments.empty() && segments.front().release <= now)
+    {
+        Segment& head = segments.front();
+        const size_t take = std::min(space - copied, head.bytes.size() - head.offset);
+        std::memcpy(dest + copied, head.bytes.data() + head.offset, take);
+        copied += take;
+        head.offset += take;
+        if (head.offset == head.bytes.size())
+            segments.pop_front();
+    }
+    return copied;
+}
+
+bool NetConditioner::DelayLine::waitForDue(std::string& out)
+{
+    std::unique_lock lock(mutex);
+    if (!waitForHead(lock))
+        return false;
+
+    Segment& head = segments.front();
+    out.assign(head.bytes, head.offset);
+    segments.pop_front();
+    return true;
+}
+
+void NetConditioner::DelayLine::close(const bool abort)
+{
+    {
+        std::lock_guard lock(mutex);
+        closed = true;
+        aborted = aborted || abort;
+    }
+    condition.notify_all();
+}
+
+NetConditioner::Stats NetConditioner::DelayLine::getStats() const
+{
+    std::lock_guard lock(mutex);
+    return stats;
+}
@@ -0,0 +1,206 @@
+#include "../include/NetTelemetry.h"
+#include "../include/AllocCounter.h"
+#include <iostream>
+
+int64_t NetTelemetry::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void NetTelemetry::raiseMax(std::atomic<size_t>& max, const size_t value)
+{
+    size_t current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+void NetTelemetry::reset()
+{
+    for (AtomicCounters& counters : opcodes)
+    {
+        counters.messagesIn = 0;
+        counters.bytesIn = 0;
+        counters.parseNs = 0;
+        counters.parsed = 0;
+        counters.parseAllocs = 0;
+        counters.messagesOut = 0;
+        counters.bytesOut = 0;
+    }
+    for (std::atomic<int64_t>& sent : pingSentNs)
+        sent = 0;
+
+    rttSamples = 0;
+    lastRttUs = 0;
+    minRttUs = 0;
+    maxRttUs = 0;
+    smoothedRttUs = 0;
+    sendQueueDepth = 0;
+    maxSendQueueDepth = 0;
+    receiveQueueDepth = 0;
+    maxReceiveQueueDepth = 0;
+    wakeups = 0;
+    startedNs = nowNs();
+}
+
+void NetTelemetry::recordIn(const Protocol::Opcode opcode, const size_t wireBytes)
+{
+    AtomicCounters& counters = opcodes[static_cast<uint8_t>(opcode) % Protocol::OPCODE_COUNT];
+    counters.messagesIn.fetch_add(1, std::memory_order_relaxed);
+    counters.bytesIn.fetch_add(wireBytes, std::memory_order_relaxed);
+}
+
+void NetTelemetry::recordOut(const Protocol::Opcode opcode, const size_t wireBytes)
+{
+    AtomicCounters& counters = opcodes[static_cast<uint8_t>(opcode) % Protocol::OPCODE_COUNT];
+    counters.messagesOut.fetch_add(1, std::memory_order_relaxed);
+    counters.bytesOut.fetch_add(wireBytes, std::memory_order_relaxed);
+}
+
+void NetTelemetry::recordParse(const Protocol::Opcode opcode, const uint64_t ns, const uint64_t allocations)
+{
+    AtomicCounters& counters = opcodes[static_cast<uint8_t>(opcode) % Protocol::OPCODE_COUNT];
+    counters.parseNs.fetch_add(ns, std::memory_order_relaxed);
+    counters.parsed.fetch_add(1, std::memory_order_relaxed);
+    counters.parseAllocs.fetch_add(allocations, std::memory_order_relaxed);
+}
+
+void NetTelemetry::recordSendQueueDepth(const size_t depth)
+{
+    sendQueueDepth.store(depth, std::memory_order_relaxed);
+    raiseMax(maxSendQueueDepth, depth);
+}
+
+void NetTelemetry::recordReceiveQueueDepth(const size_t depth)
+{
+    receiveQueueDepth.store(depth, std::memory_order_relaxed);
+    raiseMax(maxReceiveQueueDepth, depth);
+}
+
+void NetTelemetry::recordPingSent(const uint32_t sequence)
+{
+    pingSentNs[sequence % PING_SLOTS].store(nowNs(), std::memory_order_relaxed);
+}
+
+int64_t NetTelemetry::recordPong(const uint32_t sequence)
+{
+    //exchange so a duplicated or very late PONG for a reused slot cant produce a bogus sample
+    const int64_t sentNs = pingSentNs[sequence % PING_SLOTS].exchange(0, std::memory_order_relaxed);
+    if (sentNs == 0)
+        return 0;
+
+    const auto rttUs = static_cast<uint64_t>((nowNs() - sentNs) / 1000);
+    lastRttUs.store(rttUs, std::memory_order_relaxed);
+
+    //same smoothing as tcp's srtt (1/8 gain)
+    const uint64_t samples = rttSamples.fetch_add(1, std::memory_order_relaxed);
+    const uint64_t smoothed = smoothedRttUs.load(std::memory_order_relaxed);
+    smoothedRttUs.store(samples == 0 ? rttUs : smoothed + (static_cast<int64_t>(rttUs) - static_cast<int64_t>(smoothed)) / 8, std::memory_order_relaxed);
+
+    if (const uint64_t min = minRttUs.load(std::memory_order_relaxed); samples == 0 || rttUs < min)
+        minRttUs.store(rttUs, std::memory_order_relaxed);
+    if (rttUs > maxRttUs.load(std::memory_order_relaxed))
+        maxRttUs.store(rttUs, std::memory_order_relaxed);
+    return sentNs;
+}
+
+NetTelemetry::Snapshot NetTelemetry::snapshot() const
+{
+    Snapshot snap;
+    for (size_t op = 0; op < Protocol::OPCODE_COUNT; op++)
+    {
+        const AtomicCounters& counters = opcodes[op];
+        OpcodeCounters& out = snap.opcodes[op];
+        out.messagesIn = counters.messagesIn.load(std::memory_order_relaxed);
+        out.bytesIn = counters.bytesIn.load(std::memory_order_relaxed);
+        out.parseNs = counters.parseNs.load(std::memory_order_relaxed);
+        out.parsed = counters.parsed.load(std::memory_order_relaxed);
+        out.parseAllocs = counters.parseAllocs.load(std::memory_order_relaxed);
+        out.messagesOut = counters.messagesOut.load(std::memory_order_relaxed);
+        out.bytesOut = counters.bytesOut.load(std::memory_order_relaxed);
+        snap.bytesIn += out.bytesIn;
+        snap.bytesOut += out.bytesOut;
+    }
+
+    snap.rttSamples = rttSamples.load(std::memory_order_relaxed);
+    snap.lastRttMs = static_cast<double>(lastRttUs.load(std::memory_order_relaxed)) / 1000.0;
+    snap.minRttMs = static_cast<double>(minRttUs.load(std::memory_order_relaxed)) / 1000.0;
+    snap.maxRttMs = static_cast<double>(maxRttUs.load(std::memory_order_relaxed)) / 1000.0;
+    snap.smoothedRttMs = static_cast<double>(smoothedRttUs.load(std::memory_order_relaxed)) / 1000.0;
+    snap.sendQueueDepth = sendQueueDepth.load(std::memory_order_relaxed);
+    snap.maxSendQueueDepth = maxSendQueueDepth.load(std::memory_order_relaxed);
+    snap.receiveQueueDepth = receiveQueueDepth.load(std::memory_order_relaxed);
+    snap.maxReceiveQueueDepth = maxReceiveQueueDepth.load(std::memory_order_relaxed);
+    snap.wakeups = wakeups.load(std::memory_order_relaxed);
+    snap.elapsedSeconds = static_cast<double>(nowNs() - startedNs.load(std::memory_order_relaxed)) / 1e9;
+    return snap;
+}
+
+void NetTelemetry::setDumpFile(const std::string& path, const std::chrono::milliseconds interval)
+{
+    dumpFile.open(path, std::ios::app);
+    if (!dumpFile)
+    {
+        std::cerr << "[ERROR] Failed to open telemetry file: " << path << std::endl;
+        return;
+    }
+    dumpInterval = interval;
+    nextDump = std::chrono::steady_clock::now() + interval;
+}
+
+void NetTelemetry::dumpIfDue()
+{
+    if (!dumpFile.is_open())
+        return;
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now < nextDump)
+        return;
+    nextDump = now + dumpInterval;
+
+    writeJson(dumpFile, snapshot());
+    dumpFile << '\n';
+    dumpFile.flush();
+}
+
+void NetTelemetry::writeJson(std::ostream& out, const Snapshot& snap)
+{
+    out << "{\"elapsed_s\":" << snap.elapsedSeconds
+        << ",\"bytes_in\":" << snap.bytesIn << ",\"bytes_out\":" << snap.bytesOut
+        << ",\"rtt_ms\":{\"last\":" << snap.lastRttMs << ",\"min\":" << snap.minRttMs << ",\"max\":" << snap.maxRttMs << ",\"smoothed\":" << snap.smoothedRttMs
+        << ",\"samples\":" << snap.rttSamples << "}"
+        << ",\"send_queue\":{\"depth\":" << snap.sendQueueDepth << ",\"max\":" << snap.maxSendQueueDepth << "}"
+        << ",\"receive_queue\":{\"depth\":" << snap.receiveQueueDepth << ",\"max\":" << snap.maxReceiveQueueDepth << "}"
+        << ",\"wakeups\":" << snap.wakeups
+        << ",\"opcodes\":{";
+
+    bool first = true;
+    for (size_t op = 0; op < Protocol::OPCODE_COUNT; op++)
+    {
+        const OpcodeCounters& counters = snap.opcodes[op];
+        if (counters.messagesIn == 0 && counters.messagesOut == 0)
+            continue;
+
+        if (!first) out << ',';
+        first = false;
+        out << '"' << Protocol::opcodeName(static_cast<uint8_t>(op)) << "\":{\"in\":" << counters.messagesIn << ",\"bytes_in\":" << counters.bytesIn
+            << ",\"parse_ns\":" << counters.parseNs << ",\"parse_allocs\":" << counters.parseAllocs << ",\"out\":" << counters.messagesOut << ",\"bytes_out\":" << counters.bytesOut << '}';
+    }
+    out << "}}";
+}
+
+void NetTelemetry::logParseRates(const Snapshot& snap)
+{
+    for (size_t op = 0; op < Protocol::OPCODE_COUNT; op++)
+    {
+        const OpcodeCounters& counters = snap.opcodes[op];
+        if (counters.parsed == 0)
+            continue;
+
+        //chunk opcodes only count handing the payload to the decoder pool, the decode itself is reported on its own
+        const double nsPerMessage = static_cast<double>(counters.parseNs) / static_cast<double>(counters.parsed);
+        std::cout << "[NETWORK] Parse " << Protocol::opcodeName(static_cast<uint8_t>(op)) << ": " << counters.parsed << " messages, "
+                  << nsPerMessage << "ns each, " << (nsPerMessage > 0.0 ? 1e9 / nsPerMessage : 0.0) << " messages/s";
+        if (AllocCounter::ENABLED)
+            std::cout << ", " << static_cast<double>(counters.parseAllocs) / static_cast<double>(counters.parsed) << " allocations each";
+        std::cout << std::endl;
+    }
+}
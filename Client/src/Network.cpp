@@ -1,6 +1,20 @@
 #include "../include/Network.h"
 #include "../include/Game.h"
+#include "../include/Messages.h"
 #include <algorithm>
+#include <cstdlib>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace
+{
+    //send queue coalescing key, the opcode in the top byte so different kinds never collide
+    uint64_t sendKey(const Protocol::Opcode kind, const uint64_t value)
+    {
+        return static_cast<uint64_t>(kind) << 56 | (value & 0x00FFFFFFFFFFFFFFull);
+    }
+}
 
 Network::Network()
 {
@@ -10,48 +24,236 @@ Network::Network()
 
 Network::~Network()
 {
+    cancelConnect();
     disconnect();
+    capture.close();
     SDLNet_Quit();
 }
 
-bool Network::connectToServer(const std::string& host, const int port)
+NetBackend Network::defaultBackend()
 {
-    disconnect(); //clean up olds threads
-    std::cout << "[NETWORK] Attempting to connect to " << host << ":" << port << "..." << std::endl;
+#ifdef __linux__
+    return NetBackend::EPOLL;
+#else
+    return NetBackend::SDL_NET;
+#endif
+}
+
+void Network::setBackend(const NetBackend backend)
+{
+#ifndef __linux__
+    if (backend == NetBackend::EPOLL)
+    {
+        std::cerr << "[NETWORK] epoll backend is linux only, staying on SDL_net" << std::endl;
+        return;
+    }
+#endif
+    preferredBackend = backend;
+}
+
+NetBackend Network::connectBackend() const
+{
+    //the conditioner wraps the SDL_net socket calls
+    return conditionerConfig.enabled() ? NetBackend::SDL_NET : preferredBackend;
+}
+
+//runs on whichever thread is connecting, SDL keeps its error string per thread
+Network::OpenedSocket Network::openSocket(const std::string& host, const int port, const NetBackend backend, std::string& error)
+{
+    std::cout << "[NETWORK] Attempting to connect to " << host << ":" << port << " (" << backendName(backend) << ")..." << std::endl;
 
+    OpenedSocket opened;
     IPaddress ip;
     if (SDLNet_ResolveHost(&ip, host.c_str(), port) < 0)
     {
+        error = "Failed to resolve host";
         std::cerr << "[NETWORK] Failed to resolve host: " << SDLNet_GetError() << std::endl;
-        return false;
+        return opened;
     }
+    opened.address = ip;
+
+#ifdef __linux__
+    if (backend == NetBackend::EPOLL)
+        opened.fd = openFd(ip, error);
+    else
+#endif
+    opened.socket = SDLNet_TCP_Open(&ip);
 
-    socket = SDLNet_TCP_Open(&ip);
-    if (!socket)
+    if (!opened)
     {
+        if (error.empty()) error = "Connection failed";
         //debugs in case the player cant connect for whatever reason
         std::cerr << "[NETWORK] Connection failed. Possible causes: \n"
                   << "1. Firewall blocking port " << port << " on Host\n"
                   << "2. Players are on different subnets\n"
                   << "3. Wrong IP address entered.\n"
-                  << "SDL_Net Error: " << SDLNet_GetError() << std::endl;
+                  << "Error: " << (backend == NetBackend::SDL_NET ? SDLNet_GetError() : error.c_str()) << std::endl;
+    }
+    return opened;
+}
+
+void Network::closeOpened(OpenedSocket& opened)
+{
+    if (opened.socket)
+        SDLNet_TCP_Close(opened.socket);
+#ifdef __linux__
+    if (opened.fd >= 0)
+        close(opened.fd);
+#endif
+    opened = {};
+}
+
+bool Network::connectToServer(const std::string& host, const int port)
+{
+    cancelConnect();
+    disconnect(); //clean up olds threads
+
+    const OpenedSocket opened = openSocket(host, port, connectBackend(), connectError);
+    if (!opened)
         return false;
+
+    startSession(opened);
+    return true;
+}
+
+void Network::beginConnect(const std::string& host, const int port, const std::chrono::milliseconds timeout)
+{
+    cancelConnect();
+    disconnect();
+
+    connectError.clear();
+    connectAttempt = std::make_shared<ConnectAttempt>();
+    connectDeadline = std::chrono::steady_clock::now() + timeout;
+
+    //detached because a blocking connect cant be interrupted, an abandoned attempt cleans up after itself
+    std::thread([attempt = connectAttempt, host, port, backend = connectBackend()]
+    {
+        std::string error;
+        OpenedSocket opened = openSocket(host, port, backend, error);
+
+        std::lock_guard lock(attempt->mutex);
+        if (attempt->abandoned)
+            closeOpened(opened);
+        else
+        {
+            attempt->socket = opened;
+            attempt->error = error;
+        }
+        attempt->finished = true;
+    }).detach();
+}
+
+ConnectEvent Network::pollConnect()
+{
+    //local copy so the attempt (and the mutex locked below) outlives connectAttempt being reset
+    const std::shared_ptr<ConnectAttempt> attempt = connectAttempt;
+    if (!attempt)
+        return ConnectEvent::NONE;
+
+    {
+        std::lock_guard lock(attempt->mutex);
+        if (attempt->finished)
+        {
+            const OpenedSocket opened = attempt->socket;
+            connectError = attempt->error;
+            attempt->socket = {};
+            connectAttempt.reset();
+
+            if (!opened)
+                return ConnectEvent::FAILED;
+
+            startSession(opened);
+            return ConnectEvent::CONNECTED;
+        }
+
+        if (std::chrono::steady_clock::now() < connectDeadline)
+            return ConnectEvent::CONNECTING;
     }
 
+    cancelConnect();
+    connectError = "Connection timed out";
+    std::cerr << "[NETWORK] Connection timed out" << std::endl;
+    return ConnectEvent::TIMED_OUT;
+}
+
+void Network::cancelConnect()
+{
+    const std::shared_ptr<ConnectAttempt> attempt = connectAttempt;
+    if (!attempt)
+        return;
+
+    {
+        std::lock_guard lock(attempt->mutex);
+        attempt->abandoned = true;
+        closeOpened(attempt->socket); //finished but never polled
+    }
+    connectAttempt.reset();
+}
+
+void Network::startSession(const OpenedSocket& opened)
+{
+    socket = opened.socket;
+    serverAddress = opened.address;
+    activeBackend = opened.fd >= 0 ? NetBackend::EPOLL : NetBackend::SDL_NET;
+    if (socket && conditionerConfig.enabled())
+        conditioner = std::make_unique<NetConditioner>(socket, conditionerConfig);
     connected = true;
     std::cout << "[NETWORK] Connected successfully!" << std::endl;
 
+    {
+        std::lock_guard lock(statsMutex);
+        sendStats = {};
+        receiveStats = {};
+    }
+    telemetry.reset();
+    framer.reset();
+    binaryReceive = false;
+    streamingChunks = false;
+    resumed = false;
+    {
+        std::lock_guard lock(sendMutex);
+        binarySend = false;
+        pingEnabled = false;
+        sendQueueStats = {};
+    }
+    pingSequence = 0;
+    clock.reset();
+    if (!capturePath.empty())
+        capture.open(capturePath);
+
+#ifdef __linux__
+    if (activeBackend == NetBackend::EPOLL)
+    {
+        socketFd = opened.fd;
+        if (!startReactor())
+        {
+            connected = false;
+            close(socketFd);
+            socketFd = -1;
+        }
+        return;
+    }
+#endif
+
     if (recvThread.joinable()) recvThread.join();
     if (sendThread.joinable()) sendThread.join();
 
     recvThread = std::thread(&Network::receiveLoop, this);
     sendThread = std::thread(&Network::sendLoop, this);
-    return true;
 }
 
 void Network::disconnect()
 {
+    const bool wasRunning = connected || recvThread.joinable() || sendThread.joinable()
+#ifdef __linux__
+        || reactorThread.joinable()
+#endif
+        ;
+
     connected = false;
+    wakeSender();
+    if (conditioner)
+        conditioner->shutdown();
 
     if (socket)
     {
@@ -61,73 +263,623 @@ void Network::disconnect()
 
     if (recvThread.joinable()) recvThread.join();
     if (sendThread.joinable()) sendThread.join();
+#ifdef __linux__
+    stopReactor();
+#endif
+    stopUdp(); //after the receive side, which is what starts it
+    if (conditioner)
+    {
+        conditioner->logStats();
+        conditioner.reset();
+    }
+    capture.flush(); //stays open, the next session appends to the same file
+    if (wasRunning && !replaying)
+        logSessionSummary();
+    replaying = false;
+
+    std::lock_guard lock(sendMutex);
+    sendQueue.clear(); //dont leak old messages into the next connection
+    sendBacklogged = false;
 }
 
 void Network::queueMessage(const std::string& msg)
+{
+    queueEncoded([&msg](const bool binary, std::string& out)
+    {
+        if (binary)
+        {
+            Protocol::BinaryWriter writer(out, Protocol::Opcode::TEXT);
+            writer.str(msg);
+            writer.finish();
+        }
+        else
+        {
+            out = msg;
+            if (out.empty() || out.back() != '\n') out.push_back('\n');
+        }
+    });
+}
+
+void Network::sendInput(const int playerId, const std::string& action)
+{
+    queueEncoded([&](const bool binary, std::string& out)
+    {
+        Messages::encode(out, Messages::Input{ playerId, action }, binary);
+    });
+}
+
+void Network::sendInputState(const uint32_t sequence, const uint8_t held, const uint8_t previous, const int playerId)
+{
+    //over UDP it doesnt wait behind chunk requests and the like, Game repeats it in case the datagram is lost
+    if (udpReady)
+    {
+        std::string fields;
+        Protocol::appendVarint(fields, sequence);
+        fields.push_back(static_cast<char>(held));
+        if (sendDatagram(Protocol::Opcode::INPUT_STATE, fields))
+            return;
+    }
+
+    queueEncoded([&](const bool binary, std::string& out)
+    {
+        if (binary)
+        {
+            Messages::encodeBinary(out, Messages::InputState{ sequence, held });
+            return;
+        }
+
+        static constexpr std::pair<uint8_t, const char*> keys[] = {
+            { Protocol::InputBits::LEFT, "LEFT" }, { Protocol::InputBits::RIGHT, "RIGHT" },
+            { Protocol::InputBits::JUMP, "UP" }, { Protocol::InputBits::DOWN, "DOWN" } };
+        for (const auto& [bit, name] : keys)
+            if ((held ^ previous) & bit)
+                Messages::encodeText(out, Messages::Input{ playerId, std::string(name) + ((held & bit) ? "_DOWN" : "_UP") });
+    });
+}
+
+void Network::setResumeChunks(std::vector<HeldChunk> held)
 {
     std::lock_guard lock(sendMutex);
-    sendQueue.push(msg);
+    resumeChunks = std::move(held);
 }
 
-void Network::receiveLoop()
+void Network::sendView(const ChunkRect& view)
+{
+    queueEncoded([&](const bool binary, std::string& out)
+    {
+        Messages::encode(out, Messages::View{ view.minX, view.minY, view.maxX, view.maxY }, binary);
+    }, { Coalesce::REPLACE, sendKey(Protocol::Opcode::VIEW, 0), false });
+}
+
+void Network::sendChunkRequests(const std::vector<ChunkStreamer::ChunkCoord>& chunks, std::pmr::memory_resource* scratch)
+{
+    if (chunks.empty())
+        return;
+
+    std::pmr::vector<Messages::ChunkPos> positions(scratch);
+    positions.reserve(chunks.size());
+    for (const auto& [cx, cy] : chunks)
+        positions.push_back({ static_cast<uint32_t>(cx), static_cast<uint32_t>(cy) });
+
+    queueEncoded([&](const bool binary, std::string& out)
+    {
+        Messages::ChunkRequest request;
+        request.chunks.entries = positions.data();
+        request.chunks.size = static_cast<uint32_t>(positions.size());
+        Messages::encode(out, request, binary);
+    }, { Coalesce::NONE, 0, true }); //the streamer asks again once the request times out
+}
+
+void Network::sendUseItem(const int slotIndex, const int tileX, const int tileY)
+{
+    //a held button or a bot can fire the same use many times before a flush, once is enough
+    const uint64_t target = static_cast<uint64_t>(static_cast<uint16_t>(slotIndex)) << 40
+        | static_cast<uint64_t>(static_cast<uint32_t>(tileX) & 0xFFFFF) << 20 | (static_cast<uint32_t>(tileY) & 0xFFFFF);
+    queueEncoded([&](const bool binary, std::string& out)
+    {
+        Messages::encode(out, Messages::UseItem{ slotIndex, tileX, tileY }, binary);
+    }, { Coalesce::DEDUPE, sendKey(Protocol::Opcode::USE_ITEM, target), true, sendKey(Protocol::Opcode::INV_MOVE_ITEM, static_cast<uint32_t>(slotIndex)) });
+}
+
+void Network::sendInvMoveItem(const int slotIndex, const int itemID, const int quantity)
+{
+    queueEncoded([&](const bool binary, std::string& out)
+    {
+        Messages::encode(out, Messages::InvMoveItem{ slotIndex, itemID, quantity }, binary);
+    }, { Coalesce::REPLACE, sendKey(Protocol::Opcode::INV_MOVE_ITEM, static_cast<uint32_t>(slotIndex)), false }); //the slot ends up as the last one says
+}
+
+//runs on the receive thread, returns true if the line was part of the handshake and shouldnt reach Game
+bool Network::handleHandshake(const std::string_view line)
+{
+    //ASSIGN_ID,<id>,<server protocol version> (old servers leave the version off)
+    if (line.rfind("ASSIGN_ID,", 0) == 0)
+    {
+        Protocol::TextReader reader(line);
+        reader.skip(2);
+        if (reader.atEnd())
+            return false;
+
+        //junk where the version should be is a failed handshake, the session carries on in text
+        const int32_t serverVersion = reader.i32();
+        if (!reader.ok())
+            std::cerr << "[NETWORK] Bad protocol version in ASSIGN_ID (" << Protocol::parseErrorName(reader.getError()) << "), staying on text: " << line << std::endl;
+        else if (serverVersion >= Protocol::BINARY_VERSION)
+        {
+            //PROTO goes out as the last text message, everything queued after it is binary
+            std::lock_guard lock(sendMutex);
+            std::string proto = "PROTO," + std::to_string(Protocol::BINARY_VERSION);
+            if (chunkStreamingWanted)
+                proto += "," + std::string(Protocol::STREAM_FEATURE);
+            if (!resumeChunks.empty())
+                proto += "," + std::string(Protocol::RESUME_FEATURE);
+            if (udpWanted)
+                proto += "," + std::string(Protocol::UDP_FEATURE);
+            sendQueue.push_back({ proto + "\n", std::chrono::steady_clock::now(), false });
+
+            //first binary message, the server holds the join chunks until it arrives so it can skip unchanged ones
+            if (!resumeChunks.empty())
+            {
+                std::vector<Messages::ChunkHash> held;
+                held.reserve(resumeChunks.size());
+                for (const HeldChunk& chunk : resumeChunks)
+                    held.push_back({ static_cast<uint32_t>(chunk.chunkX), static_cast<uint32_t>(chunk.chunkY), chunk.hash });
+
+                PendingMessage& hashes = sendQueue.emplace_back();
+                hashes.queuedAt = std::chrono::steady_clock::now();
+                hashes.binary = true;
+                Messages::ChunkHashes msg;
+                msg.chunks.entries = held.data();
+                msg.chunks.size = static_cast<uint32_t>(held.size());
+                Messages::encodeBinary(hashes.data, msg);
+                resumeChunks.clear(); //only ever offered once
+            }
+            binarySend = true;
+            pingEnabled = true;
+        }
+        notifySender();
+        return false;
+    }
+
+    //the server sends this as its last text line, every byte after it is a binary frame
+    if (line.rfind("PROTO_ACK,", 0) == 0)
+    {
+        //PROTO_ACK,<version>[,STREAM][,RESUME][,UDP]
+        Protocol::TextReader reader(line);
+        reader.skip(2);
+        bool stream = false, resume = false;
+        while (!reader.atEnd())
+        {
+            const std::string_view feature = reader.field();
+            stream |= feature == Protocol::STREAM_FEATURE;
+            resume |= feature == Protocol::RESUME_FEATURE;
+        }
+        streamingChunks = stream;
+        resumed = resume;
+        binaryReceive = true;
+        std::cout << "[NETWORK] Using binary protocol v" << Protocol::BINARY_VERSION
+                  << (streamingChunks ? ", chunks streamed on request" : "") << (resumed ? ", resuming the previous session" : "") << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+//runs on the receive thread, PONGs are timed here so main thread stalls dont inflate the rtt
+bool Network::handlePong(const std::string_view msg)
+{
+    const auto receivedAt = std::chrono::steady_clock::now();
+    Messages::Pong pong;
+    bool read;
+
+    if (Protocol::isBinaryFrame(msg))
+    {
+        if (static_cast<Protocol::Opcode>(msg[0]) != Protocol::Opcode::PONG)
+            return false;
+        Protocol::BinaryReader reader(msg.substr(1));
+        read = Messages::read(reader, pong);
+    }
+    else
+    {
+        if (msg.rfind("PONG,", 0) != 0)
+            return false;
+        Protocol::TextReader reader(msg);
+        reader.skip();
+        read = Messages::read(reader, pong);
+    }
+    if (!read)
+        return true; //a garbled probe is dropped, the next ping replaces it
+
+    //older servers only echo the sequence
+    const int64_t sentNs = telemetry.recordPong(static_cast<uint32_t>(pong.sequence));
+    if (!pong.serverUs || sentNs == 0)
+        return true;
+
+    const bool wasSynced = clock.isSynced();
+    clock.addProbe(sentNs, std::chrono::duration_cast<std::chrono::nanoseconds>(receivedAt.time_since_epoch()).count(), *pong.serverUs);
+    if (!wasSynced)
+    {
+        const ClockSync::Estimate estimate = clock.estimate();
+        std::cout << "[NETWORK] Clock synced to server, offset " << estimate.offsetUs / 1000.0 << "ms over a "
+                  << estimate.bestRttMs << "ms round trip" << std::endl;
+    }
+    return true;
+}
+
+//send thread only, called with the batch already taken from the queue
+void Network::appendPing(std::vector<PendingMessage>& batch)
+{
+    bool binary;
+    {
+        std::lock_guard lock(sendMutex);
+        if (!pingEnabled) return;
+        binary = binarySend;
+    }
+
+    PendingMessage& ping = batch.emplace_back();
+    ping.queuedAt = std::chrono::steady_clock::now();
+    ping.binary = binary;
+    Messages::encode(ping.data, Messages::Ping{ static_cast<int32_t>(pingSequence) }, binary);
+}
+
+Protocol::Opcode Network::framedOpcode(const PendingMessage& msg)
+{
+    if (!msg.binary)
+        return Protocol::messageOpcode(msg.data);
+
+    uint32_t length;
+    const size_t prefix = Protocol::readVarint(msg.data.data(), msg.data.size(), length);
+    return prefix > 0 && prefix < msg.data.size() ? static_cast<Protocol::Opcode>(msg.data[prefix]) : Protocol::Opcode::TEXT;
+}
+
+void Network::wakeSender()
+{
+    //take the lock so the wakeup cant slip in between the sender checking and starting to wait
+    {
+        std::lock_guard lock(sendMutex);
+    }
+    sendCondition.notify_all();
+#ifdef __linux__
+    if (wakeFd >= 0)
+    {
+        constexpr uint64_t one = 1;
+        [[maybe_unused]] const ssize_t written = write(wakeFd, &one, sizeof(one));
+    }
+#endif
+}
+
+void Network::notifySender()
+{
+#ifdef __linux__
+    if (activeBackend == NetBackend::EPOLL)
+    {
+        //only the first message since the reactor last drained the queue pays for the syscall
+        if (wakeFd >= 0 && !wakePending.exchange(true, std::memory_order_acq_rel))
+        {
+            constexpr uint64_t one = 1;
+            [[maybe_unused]] const ssize_t written = write(wakeFd, &one, sizeof(one));
+        }
+        return;
+    }
+#endif
+    sendCondition.notify_one();
+}
+
+Network::PendingMessage* Network::admitMessage(const SendRule& rule)
+{
+    bool replaced = false;
+    if (rule.coalesce != Coalesce::NONE)
+    {
+        //newest first, and never past a message that depends on what this one would merge with:
+        //set slot 3, use slot 3, set slot 3 again has to keep the first set, and a use after a set isnt the same use as before it
+        for (auto waiting = sendQueue.rbegin(); waiting != sendQueue.rend(); ++waiting)
+        {
+            if ((rule.reads != 0 && waiting->coalesceKey == rule.reads) || (waiting->reads != 0 && waiting->reads == rule.key))
+                break;
+            //only against messages framed the same way, a binary message must never move ahead of PROTO
+            if (waiting->coalesceKey != rule.key || waiting->binary != binarySend)
+                continue;
+
+            if (rule.coalesce == Coalesce::DEDUPE)
+            {
+                sendQueueStats.deduplicated++;
+                return nullptr;
+            }
+            //the newer one goes to the back, nothing after the old one depended on it
+            sendQueueStats.merged++;
+            sendQueue.erase(std::next(waiting).base());
+            replaced = true;
+            break;
+        }
+    }
+
+    if (!replaced && rule.droppable && sendQueue.size() >= MAX_SEND_QUEUE)
+    {
+        sendQueueStats.dropped++;
+        return nullptr;
+    }
+
+    PendingMessage& msg = sendQueue.emplace_back();
+    msg.queuedAt = std::chrono::steady_clock::now();
+    msg.binary = binarySend;
+    msg.coalesceKey = rule.coalesce != Coalesce::NONE ? rule.key : 0;
+    msg.reads = rule.reads;
+    sendQueueStats.maxDepth = std::max(sendQueueStats.maxDepth, sendQueue.size());
+    if (sendQueue.size() >= SEND_BACKLOG)
+        sendBacklogged = true;
+    return &msg;
+}
+
+void Network::takeSendQueue(std::vector<PendingMessage>& batch)
+{
+    batch.swap(sendQueue);
+    sendBacklogged = false;
+}
+
+SendQueueStats Network::getSendQueueStats()
+{
+    std::lock_guard lock(sendMutex);
+    return sendQueueStats;
+}
+
+SendStats Network::getSendStats()
+{
+    std::lock_guard lock(statsMutex);
+    return sendStats;
+}
+
+ReceiveStats Network::getReceiveStats()
+{
+    std::lock_guard lock(statsMutex);
+    return receiveStats;
+}
+
+int Network::readSocket(char* dest, const int space)
+{
+    return conditioner ? conditioner->receive(dest, space) : SDLNet_TCP_Recv(socket, dest, space);
+}
+
+int Network::writeSocket(const char* data, const int len)
 {
-    char buffer[4096];
-    std::string partial;
+    if (replaying)
+        return len; //nobody on the other end, whatever the game sends is dropped
+    return conditioner ? conditioner->send(data, len) : SDLNet_TCP_Send(socket, data, len);
+}
 
+void Network::receiveLoop()
+{
     while (connected)
     {
-        const int bytes = SDLNet_TCP_Recv(socket, buffer, sizeof(buffer) - 1);
+        //read straight into the framer so complete messages never get copied on this side
+        char* dest = framer.prepareWrite();
+        const int bytes = readSocket(dest, static_cast<int>(framer.writeSpace()));
+        telemetry.recordWakeup();
         if (bytes <= 0)
         {
             std::cerr << "[NETWORK] Connection lost or closed\n";
             connected = false;
+            wakeSender();
             break;
         }
+        framer.commitWrite(static_cast<size_t>(bytes));
 
-        buffer[bytes] = '\0';
-        partial += buffer;
+        if (!consumeReceived(static_cast<size_t>(bytes), true))
+            wakeSender();
+    }
+}
 
-        size_t pos;
-        while ((pos = partial.find('\n')) != std::string::npos)
-        {
-            std::string line = partial.substr(0, pos);
-            partial.erase(0, pos + 1);
+bool Network::startReplay(const std::string& path, const bool fast)
+{
+    disconnect();
 
-            line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
-            line.erase(std::remove(line.begin(), line.end(), '\n'), line.end());
-            if (!line.empty() && game)
-                game->pushNetworkMessage(line);
-        }
+    NetCapture::Reader reader;
+    if (!game || !reader.open(path))
+        return false;
+
+    replaying = true;
+    connected = true;
+    streamingChunks = false; //a streamed capture already holds the chunks it asked for
+    telemetry.reset();
+    {
+        std::lock_guard lock(sendMutex);
+        binarySend = false;
+        pingEnabled = false;
     }
+    std::cout << "[NETWORK] Replaying " << path << (fast ? " as fast as possible" : " at the recorded pace") << std::endl;
+
+    recvThread = std::thread(&Network::replayLoop, this, std::move(reader), fast);
+    sendThread = std::thread(&Network::sendLoop, this);
+    return true;
 }
 
-void Network::sendLoop(){
+//stands in for receiveLoop, same push into Game so parsing, world updates and rendering see what a live session saw
+void Network::replayLoop(NetCapture::Reader reader, const bool fast)
+{
+    const auto started = std::chrono::steady_clock::now();
+    uint64_t messages = 0, bytes = 0, lastTimestampNs = 0;
+    NetCapture::Record record;
+    while (connected && reader.next(record))
+    {
+        if (!fast)
+            std::this_thread::sleep_until(started + std::chrono::nanoseconds(record.timestampNs));
+        if (record.data.empty())
+            continue; //session marker, the live client dropped anything still queued there but replay has no reconnect to mirror
+
+        telemetry.recordIn(Protocol::messageOpcode(record.data), record.data.size());
+        if (!game->pushNetworkMessage(record.data, connected))
+            break;
+        messages++;
+        bytes += record.data.size();
+        lastTimestampNs = record.timestampNs;
+    }
+
+    //wait for the main thread to get through the queue so the time covers the whole pipeline, not just the push
+    while (connected && game->getIncomingQueue().size() > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    const double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "[NETWORK] Replay finished: " << messages << " messages, " << bytes << " bytes in " << elapsedMs
+              << "ms (recorded " << lastTimestampNs / 1000000 << "ms, "
+              << (elapsedMs > 0.0 ? static_cast<uint64_t>(messages * 1000.0 / elapsedMs) : 0) << " msgs/s)" << std::endl;
+
+    connected = false;
+    wakeSender();
+}
+
+//frames and dispatches everything committed to the framer so far, false if the connection has to go
+bool Network::consumeReceived(const size_t bytes, const bool newRead)
+{
+    const auto framingStart = std::chrono::steady_clock::now();
+    uint64_t lines = 0;
+    std::string_view msg;
+    while (binaryReceive ? framer.nextFrame(msg) : framer.nextLine(msg))
+    {
+        lines++;
+        if (!msg.empty())
+            telemetry.recordIn(Protocol::messageOpcode(msg), msg.size() + (binaryReceive ? Protocol::varintSize(static_cast<uint32_t>(msg.size())) : 1));
+        if (!binaryReceive && handleHandshake(msg))
+            continue;
+        if (handlePong(msg) || handleUdpOffer(msg))
+            continue;
+        if (!msg.empty() && capture.isOpen())
+            capture.record(msg);
+        if (!msg.empty() && game && !game->pushNetworkMessage(msg, connected))
+            break; //disconnected while waiting for the main thread
+    }
+    if (game)
+        telemetry.recordReceiveQueueDepth(game->getIncomingQueue().size());
+
+    const bool ok = !framer.hasError();
+    if (!ok)
+    {
+        std::cerr << "[NETWORK] Received a malformed frame, dropping connection\n";
+        connected = false;
+    }
+    const auto framingNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - framingStart).count();
+
+    std::lock_guard lock(statsMutex);
+    receiveStats.reads += newRead ? 1 : 0;
+    receiveStats.bytes += bytes;
+    receiveStats.messages += lines;
+    receiveStats.framingNs += static_cast<uint64_t>(framingNs);
+    receiveStats.largestBuffer = std::max(receiveStats.largestBuffer, framer.capacity());
+    return ok;
+}
+
+void Network::sendLoop()
+{
+    std::vector<PendingMessage> batch;
+    std::string buffer;
+    auto nextPing = std::chrono::steady_clock::now() + ClockSync::probeInterval(0);
+
     while (connected)
     {
-        std::string msg;
         {
-            std::lock_guard lock(sendMutex);
-            if (!sendQueue.empty())
-            {
-                msg = sendQueue.front();
-                sendQueue.pop();
-            }
+            //wakes for queued messages, or on its own when the next PING is due
+            std::unique_lock lock(sendMutex);
+            sendCondition.wait_until(lock, nextPing, [this] { return !sendQueue.empty() || !connected; });
+            takeSendQueue(batch); //take everything queued so far in one go
         }
+        telemetry.recordWakeup();
+        telemetry.recordSendQueueDepth(batch.size());
 
-        if (!msg.empty())
-        {
-            if (msg.back() != '\n') msg.push_back('\n');
-            const int len = static_cast<int>(msg.size());
+        const bool pingInBatch = addPingIfDue(batch, nextPing);
+        if (batch.empty())
+            continue;
 
-            if (const int result = SDLNet_TCP_Send(socket, msg.c_str(), len); result < len)
-            {
-                std::cerr << "[NETWORK] Send failed: " << SDLNet_GetError() << std::endl;
-                connected = false;
-            }
+        //coalesce the whole batch into one buffer so it goes out in a single send
+        buffer.clear();
+        for (const PendingMessage& msg : batch)
+            buffer += msg.data; //already framed (newline or length prefix) when it was queued
+        recordBatch(batch, buffer.size(), pingInBatch);
+
+        const int len = static_cast<int>(buffer.size());
+        if (const int result = writeSocket(buffer.data(), len); result < len)
+        {
+            std::cerr << "[NETWORK] Send failed: " << SDLNet_GetError() << std::endl;
+            connected = false;
         }
+        batch.clear();
+    }
+}
+
+bool Network::addPingIfDue(std::vector<PendingMessage>& batch, std::chrono::steady_clock::time_point& nextPing)
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (now < nextPing)
+        return false;
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    nextPing = now + ClockSync::probeInterval(pingSequence);
+    appendPing(batch);
+    return !batch.empty() && framedOpcode(batch.back()) == Protocol::Opcode::PING;
+}
+
+//called once per batch as it is handed to the socket
+void Network::recordBatch(const std::vector<PendingMessage>& batch, const size_t bytes, const bool pingInBatch)
+{
+    const auto flushTime = std::chrono::steady_clock::now();
+    uint64_t totalWaitUs = 0;
+    uint64_t maxWaitUs = 0;
+    for (const PendingMessage& msg : batch)
+    {
+        telemetry.recordOut(framedOpcode(msg), msg.data.size());
+
+        const auto waitUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(flushTime - msg.queuedAt).count());
+        totalWaitUs += waitUs;
+        maxWaitUs = std::max(maxWaitUs, waitUs);
     }
+
+    if (pingInBatch)
+        telemetry.recordPingSent(pingSequence++);
+
+    std::lock_guard lock(statsMutex);
+    sendStats.flushes++;
+    sendStats.messages += batch.size();
+    sendStats.bytes += bytes;
+    sendStats.largestBatch = std::max<uint64_t>(sendStats.largestBatch, batch.size());
+    sendStats.totalQueueWaitUs += totalWaitUs;
+    sendStats.maxQueueWaitUs = std::max(sendStats.maxQueueWaitUs, maxWaitUs);
+}
+
+//summary so batching and the two backends can be compared between runs
+void Network::logSessionSummary()
+{
+    const SendStats sent = getSendStats();
+    if (sent.flushes > 0)
+        std::cout << "[NETWORK] Sent " << sent.messages << " messages (" << sent.bytes << " bytes) in "
+                  << sent.flushes << " flushes | avg batch " << (static_cast<double>(sent.messages) / sent.flushes)
+                  << ", max batch " << sent.largestBatch
+                  << " | queue wait avg " << (sent.totalQueueWaitUs / sent.messages) << "us, max " << sent.maxQueueWaitUs << "us" << std::endl;
+
+    if (const SendQueueStats queued = getSendQueueStats(); queued.merged + queued.deduplicated + queued.dropped > 0)
+        std::cout << "[NETWORK] Send queue merged " << queued.merged << ", deduplicated " << queued.deduplicated
+                  << ", dropped " << queued.dropped << " messages | max depth " << queued.maxDepth << std::endl;
+
+    if (const UdpStats udp = getUdpStats(); udp.datagramsIn + udp.datagramsOut > 0)
+        std::cout << "[NETWORK] UDP " << udp.datagramsIn << " datagrams in (" << udp.movesIn << " moves), " << udp.datagramsOut
+                  << " out | " << udp.staleDropped << " stale, " << udp.queueDropped << " dropped on a full queue, "
+                  << udp.fallbacks << " fallbacks to TCP" << std::endl;
+
+    if (const ClockSync::Estimate estimate = clock.estimate(); estimate.synced)
+        std::cout << "[NETWORK] Server clock offset " << estimate.offsetUs / 1000.0 << "ms, drift " << estimate.driftPpm
+                  << "ppm, best round trip " << estimate.bestRttMs << "ms over " << estimate.probes << " probes" << std::endl;
+
+    const ReceiveStats received = getReceiveStats();
+    if (received.framingNs > 0)
+        std::cout << "[NETWORK] Received " << received.messages << " messages (" << received.bytes << " bytes) in "
+                  << received.reads << " reads | framed at " << (static_cast<double>(received.bytes) * 1000.0 / received.framingNs)
+                  << " MB/s, framer buffer " << received.largestBuffer << " bytes" << std::endl;
+    if (game)
+        std::cout << "[NETWORK] Incoming queue high-water " << game->getIncomingQueue().highWaterMark() << "/" << game->getIncomingQueue().capacity()
+                  << ", producer stalls " << game->getIncomingQueue().producerStalls() << std::endl;
+
+    const NetTelemetry::Snapshot snap = telemetry.snapshot();
+    const uint64_t messages = sent.messages + received.messages;
+    if (messages > 0 && snap.elapsedSeconds > 0.0)
+        std::cout << "[NETWORK] " << backendName(activeBackend) << " backend: " << snap.wakeups << " thread wakeups for " << messages << " messages ("
+                  << static_cast<double>(snap.wakeups) / messages << " per message) | "
+                  << static_cast<double>(sent.bytes + received.bytes) / snap.elapsedSeconds / 1024.0 << " KB/s over "
+                  << snap.elapsedSeconds << "s" << std::endl;
 }
 
 /*bool Network::isConnected() const
@@ -0,0 +1,272 @@
+#include "../include/Network.h"
+
+//linux backend: one non-blocking socket, one thread, woken by epoll for socket readiness or an eventfd poke
+//when something is queued. replaces the receive + send thread pair of the SDL_net backend
+#ifdef __linux__
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <iterator>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr size_t OVERFLOW_READ_SIZE = 64 * 1024; //second readv buffer so one syscall can empty the socket
+    constexpr int MAX_WRITE_IOVECS = 64;
+}
+
+//blocking connect (the caller is already off the main thread), then the fd is switched to non-blocking
+int Network::openFd(const IPaddress& ip, std::string& error)
+{
+    const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        error = std::string("Failed to create socket: ") + std::strerror(errno);
+        return -1;
+    }
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = ip.host; //SDL_net already keeps both in network byte order
+    address.sin_port = ip.port;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+    {
+        error = std::string("Connection failed: ") + std::strerror(errno);
+        ::close(fd);
+        return -1;
+    }
+
+    constexpr int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); //same as SDL_net does
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+bool Network::startReactor()
+{
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0)
+    {
+        std::cerr << "[NETWORK] Failed to create eventfd: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    wakePending = false;
+
+    if (reactorThread.joinable()) reactorThread.join();
+    reactorThread = std::thread(&Network::reactorLoop, this);
+    return true;
+}
+
+void Network::stopReactor()
+{
+    //connected is already false and wakeSender() has poked the eventfd
+    if (reactorThread.joinable()) reactorThread.join();
+
+    if (socketFd >= 0)
+    {
+        ::close(socketFd);
+        socketFd = -1;
+    }
+    if (wakeFd >= 0)
+    {
+        ::close(wakeFd);
+        wakeFd = -1;
+    }
+}
+
+void Network::reactorLoop()
+{
+    const int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event socketEvent{};
+    socketEvent.events = EPOLLIN | EPOLLRDHUP;
+    socketEvent.data.fd = socketFd;
+    epoll_event wakeEvent{};
+    wakeEvent.events = EPOLLIN;
+    wakeEvent.data.fd = wakeFd;
+    if (epollFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, socketFd, &socketEvent) < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &wakeEvent) < 0)
+    {
+        std::cerr << "[NETWORK] Failed to set up epoll: " << std::strerror(errno) << std::endl;
+        connected = false;
+        if (epollFd >= 0) ::close(epollFd);
+        return;
+    }
+
+    std::vector<char> overflow(OVERFLOW_READ_SIZE);
+    std::vector<PendingMessage> batch;
+    std::vector<PendingMessage> outgoing; //taken from the queue but not fully written yet
+    size_t outIndex = 0;
+    size_t outOffset = 0;
+    bool wantWrite = false;
+    auto nextPing = std::chrono::steady_clock::now() + ClockSync::probeInterval(0);
+
+    //drains the socket with readv into the framer plus the overflow buffer, false once the connection is gone
+    auto readAvailable = [&]
+    {
+        while (true)
+        {
+            char* dest = framer.prepareWrite();
+            const size_t space = framer.writeSpace();
+            iovec buffers[2] = { { dest, space }, { overflow.data(), overflow.size() } };
+
+            const ssize_t bytes = readv(socketFd, buffers, 2);
+            if (bytes == 0)
+                return false;
+            if (bytes < 0)
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+            const size_t direct = std::min(static_cast<size_t>(bytes), space);
+            framer.commitWrite(direct);
+            if (!consumeReceived(direct, true))
+                return false;
+
+            //whatever spilled into the overflow buffer goes through the framer in as many pieces as it takes
+            for (size_t copied = 0, spilled = static_cast<size_t>(bytes) - direct; copied < spilled;)
+            {
+                char* more = framer.prepareWrite();
+                const size_t take = std::min(spilled - copied, framer.writeSpace());
+                std::memcpy(more, overflow.data() + copied, take);
+                framer.commitWrite(take);
+                copied += take;
+                if (!consumeReceived(take, false))
+                    return false;
+            }
+
+            if (static_cast<size_t>(bytes) < space + overflow.size())
+                return true; //short read, the socket is empty so skip the EAGAIN round trip
+        }
+    };
+
+    //writev as much of outgoing as the socket takes, false on a hard error
+    auto flushOutgoing = [&]
+    {
+        while (outIndex < outgoing.size())
+        {
+            iovec buffers[MAX_WRITE_IOVECS];
+            int count = 0;
+            for (size_t i = outIndex; i < outgoing.size() && count < MAX_WRITE_IOVECS; i++, count++)
+            {
+                const size_t offset = i == outIndex ? outOffset : 0;
+                buffers[count] = { outgoing[i].data.data() + offset, outgoing[i].data.size() - offset };
+            }
+
+            ssize_t written = writev(socketFd, buffers, count);
+            if (written < 0)
+            {
+                if (errno == EINTR) continue;
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+
+            while (written > 0)
+            {
+                const size_t left = outgoing[outIndex].data.size() - outOffset;
+                if (static_cast<size_t>(written) >= left)
+                {
+                    written -= static_cast<ssize_t>(left);
+                    outIndex++;
+                    outOffset = 0;
+                }
+                else
+                {
+                    outOffset += static_cast<size_t>(written);
+                    written = 0;
+                }
+            }
+        }
+
+        outgoing.clear();
+        outIndex = 0;
+        outOffset = 0;
+        return true;
+    };
+
+    epoll_event events[4];
+    bool queueWaiting = false;
+    while (connected)
+    {
+        const auto untilPing = std::chrono::duration_cast<std::chrono::milliseconds>(nextPing - std::chrono::steady_clock::now()).count();
+        const int ready = epoll_wait(epollFd, events, 4, static_cast<int>(std::max<int64_t>(0, untilPing + 1)));
+        telemetry.recordWakeup();
+        if (ready < 0 && errno != EINTR)
+        {
+            std::cerr << "[NETWORK] epoll_wait failed: " << std::strerror(errno) << std::endl;
+            connected = false;
+            break;
+        }
+
+        bool queued = false;
+        bool lost = false;
+        for (int i = 0; i < ready; i++)
+        {
+            if (events[i].data.fd == wakeFd)
+            {
+                uint64_t pokes;
+                [[maybe_unused]] const ssize_t drained = ::read(wakeFd, &pokes, sizeof(pokes));
+                queued = true;
+                continue;
+            }
+
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                lost = lost || !readAvailable();
+            if (events[i].events & EPOLLOUT)
+                lost = lost || !flushOutgoing();
+        }
+        if (lost || !connected)
+        {
+            if (lost) std::cerr << "[NETWORK] Connection lost or closed\n";
+            connected = false;
+            break;
+        }
+
+        //while the kernel buffer is full new messages stay in sendQueue, where they can still be merged
+        //and count against its bound, instead of piling up behind the stalled write
+        queueWaiting = queueWaiting || queued;
+        if (queueWaiting && outIndex >= outgoing.size())
+        {
+            queueWaiting = false;
+            //cleared before taking the queue so a message queued after the swap always pokes again
+            wakePending.store(false, std::memory_order_release);
+            {
+                std::lock_guard lock(sendMutex);
+                takeSendQueue(batch);
+            }
+            telemetry.recordSendQueueDepth(batch.size());
+        }
+
+        const bool pingInBatch = addPingIfDue(batch, nextPing);
+        if (!batch.empty())
+        {
+            size_t bytes = 0;
+            for (const PendingMessage& msg : batch)
+                bytes += msg.data.size();
+            recordBatch(batch, bytes, pingInBatch);
+
+            std::move(batch.begin(), batch.end(), std::back_inserter(outgoing));
+            batch.clear();
+            if (!flushOutgoing())
+            {
+                std::cerr << "[NETWORK] Send failed: " << std::strerror(errno) << std::endl;
+                connected = false;
+                break;
+            }
+        }
+
+        //only ask for EPOLLOUT while the kernel buffer is full, otherwise it fires on every wait
+        if (const bool pending = outIndex < outgoing.size(); pending != wantWrite)
+        {
+            wantWrite = pending;
+            socketEvent.events = EPOLLIN | EPOLLRDHUP | (wantWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, socketFd, &socketEvent);
+        }
+    }
+
+    ::close(epollFd);
+}
+#endif
@@ -0,0 +1,200 @@
+#include "../include/Network.h"
+#include "../include/Game.h"
+#include "../include/Messages.h"
+#include <cstring>
+#include <iostream>
+
+//receive thread, UDP_OFFER only ever arrives right after PROTO_ACK
+bool Network::handleUdpOffer(const std::string_view msg)
+{
+    if (!Protocol::isBinaryFrame(msg) || static_cast<Protocol::Opcode>(msg[0]) != Protocol::Opcode::UDP_OFFER)
+        return false;
+
+    Protocol::BinaryReader reader(msg.substr(1));
+    Messages::UdpOffer offer;
+    if (Messages::read(reader, offer) && udpWanted && !replaying)
+        startUdp(offer.port, offer.token);
+    return true;
+}
+
+void Network::startUdp(const uint16_t port, const uint64_t token)
+{
+    stopUdp();
+
+    udpSocket = SDLNet_UDP_Open(0);
+    udpSendPacket = udpSocket ? SDLNet_AllocPacket(static_cast<int>(Protocol::MAX_DATAGRAM_SIZE)) : nullptr;
+    if (!udpSendPacket)
+    {
+        std::cerr << "[NETWORK] Couldnt open a UDP socket, movement stays on TCP: " << SDLNet_GetError() << std::endl;
+        stopUdp();
+        return;
+    }
+
+    udpServer = serverAddress;
+    SDLNet_Write16(port, &udpServer.port);
+    udpToken = token;
+    udpDatagramsIn = 0;
+    udpDatagramsOut = 0;
+    udpMovesIn = 0;
+    udpStaleDropped = 0;
+    udpQueueDropped = 0;
+    udpFallbacks = 0;
+    udpRunning = true;
+    udpThread = std::thread(&Network::udpLoop, this);
+}
+
+void Network::stopUdp()
+{
+    udpRunning = false;
+    udpReady = false;
+    if (udpThread.joinable()) udpThread.join();
+
+    std::lock_guard lock(udpSendMutex);
+    if (udpSendPacket)
+    {
+        SDLNet_FreePacket(udpSendPacket);
+        udpSendPacket = nullptr;
+    }
+    if (udpSocket)
+    {
+        SDLNet_UDP_Close(udpSocket);
+        udpSocket = nullptr;
+    }
+}
+
+//main thread (input) or udp thread (hello). false if the datagram couldnt be sent, the caller can fall back to TCP
+bool Network::sendDatagram(const Protocol::Opcode opcode, const std::string_view fields)
+{
+    std::lock_guard lock(udpSendMutex);
+    if (!udpSendPacket || Protocol::CLIENT_DATAGRAM_HEADER + 1 + fields.size() > Protocol::MAX_DATAGRAM_SIZE)
+        return false;
+
+    Uint8* out = udpSendPacket->data;
+    for (size_t i = 0; i < Protocol::CLIENT_DATAGRAM_HEADER; i++)
+        out[i] = static_cast<Uint8>(udpToken >> (8 * i));
+    out[Protocol::CLIENT_DATAGRAM_HEADER] = static_cast<Uint8>(opcode);
+    std::memcpy(out + Protocol::CLIENT_DATAGRAM_HEADER + 1, fields.data(), fields.size());
+    udpSendPacket->len = static_cast<int>(Protocol::CLIENT_DATAGRAM_HEADER + 1 + fields.size());
+    udpSendPacket->address = udpServer;
+
+    if (SDLNet_UDP_Send(udpSocket, -1, udpSendPacket) == 0)
+        return false;
+    udpDatagramsOut.fetch_add(1, std::memory_order_relaxed);
+    telemetry.recordOut(opcode, static_cast<size_t>(udpSendPacket->len));
+    return true;
+}
+
+//udp thread. the server only switches a client's movement over once it hears ready over TCP, and back on not ready
+void Network::setUdpReady(const bool ready)
+{
+    queueEncoded([ready](const bool binary, std::string& out)
+    {
+        Messages::encode(out, Messages::UdpReady{ static_cast<uint8_t>(ready ? 1 : 0) }, binary);
+    });
+    udpReady = ready;
+}
+
+void Network::udpLoop()
+{
+    SDLNet_SocketSet set = SDLNet_AllocSocketSet(1);
+    UDPpacket* packet = SDLNet_AllocPacket(static_cast<int>(Protocol::MAX_DATAGRAM_SIZE));
+    if (!set || !packet)
+    {
+        if (set) SDLNet_FreeSocketSet(set);
+        if (packet) SDLNet_FreePacket(packet);
+        std::cerr << "[NETWORK] UDP setup failed, movement stays on TCP: " << SDLNet_GetError() << std::endl;
+        return;
+    }
+    SDLNet_UDP_AddSocket(set, udpSocket);
+
+    int hellos = 0;
+    auto nextHello = std::chrono::steady_clock::now();
+    auto lastDatagram = nextHello;
+    bool anyTick = false;
+    uint32_t newestTick = 0;
+
+    while (udpRunning && connected)
+    {
+        //the server can only learn our address from a datagram, and every hello is answered so a quiet channel means a dead one
+        const auto now = std::chrono::steady_clock::now();
+        if (udpReady && now - lastDatagram > UDP_SILENCE_TIMEOUT)
+        {
+            setUdpReady(false);
+            udpFallbacks.fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "[NETWORK] Nothing over UDP for " << UDP_SILENCE_TIMEOUT.count() << "ms, movement back on TCP" << std::endl;
+            hellos = 0;
+            nextHello = now;
+        }
+        if (now >= nextHello)
+        {
+            if (!udpReady && hellos++ == UDP_HELLO_ATTEMPTS)
+            {
+                std::cerr << "[NETWORK] No answer over UDP after " << UDP_HELLO_ATTEMPTS << " tries, movement stays on TCP" << std::endl;
+                break;
+            }
+            sendDatagram(Protocol::Opcode::UDP_HELLO, {});
+            nextHello = now + (udpReady ? UDP_KEEPALIVE_INTERVAL : UDP_HELLO_INTERVAL);
+        }
+
+        if (SDLNet_CheckSockets(set, UDP_POLL_MS) <= 0)
+            continue;
+
+        while (udpRunning && SDLNet_UDP_Recv(udpSocket, packet) > 0)
+        {
+            //only the server we registered with, and at least a header plus an opcode
+            if (packet->address.host != udpServer.host || packet->address.port != udpServer.port
+                || packet->len <= static_cast<int>(Protocol::SERVER_DATAGRAM_HEADER))
+                continue;
+
+            uint32_t tick = 0;
+            for (size_t i = 0; i < Protocol::SERVER_DATAGRAM_HEADER; i++)
+                tick |= static_cast<uint32_t>(packet->data[i]) << (8 * i);
+
+            //a tick can span several datagrams so only strictly older ones are stale, compared with wraparound
+            if (anyTick && static_cast<int32_t>(tick - newestTick) < 0)
+            {
+                udpStaleDropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            anyTick = true;
+            newestTick = tick;
+            lastDatagram = std::chrono::steady_clock::now();
+            udpDatagramsIn.fetch_add(1, std::memory_order_relaxed);
+
+            const std::string_view payload(reinterpret_cast<const char*>(packet->data) + Protocol::SERVER_DATAGRAM_HEADER,
+                                           static_cast<size_t>(packet->len) - Protocol::SERVER_DATAGRAM_HEADER);
+            telemetry.recordIn(static_cast<Protocol::Opcode>(payload[0]), static_cast<size_t>(packet->len));
+            if (!udpReady)
+            {
+                setUdpReady(true);
+                std::cout << "[NETWORK] UDP channel up after " << hellos << " hello(s), movement goes over datagrams" << std::endl;
+            }
+
+            if (static_cast<Protocol::Opcode>(payload[0]) != Protocol::Opcode::MOVE_BATCH)
+                continue;
+            Protocol::BinaryReader reader(payload.substr(1));
+            const uint32_t moves = reader.varint();
+            if (moves == 0)
+                continue; //the hello answer
+            udpMovesIn.fetch_add(moves, std::memory_order_relaxed);
+            if (game && !game->pushDatagram(payload))
+                udpQueueDropped.fetch_add(1, std::memory_order_relaxed); //never wait here, a late move is worthless anyway
+        }
+    }
+
+    SDLNet_FreePacket(packet);
+    SDLNet_FreeSocketSet(set);
+}
+
+UdpStats Network::getUdpStats() const
+{
+    UdpStats stats;
+    stats.active = udpReady;
+    stats.datagramsIn = udpDatagramsIn.load(std::memory_order_relaxed);
+    stats.datagramsOut = udpDatagramsOut.load(std::memory_order_relaxed);
+    stats.movesIn = udpMovesIn.load(std::memory_order_relaxed);
+    stats.staleDropped = udpStaleDropped.load(std::memory_order_relaxed);
+    stats.queueDropped = udpQueueDropped.load(std::memory_order_relaxed);
+    stats.fallbacks = udpFallbacks.load(std::memory_order_relaxed);
+    return stats;
+}
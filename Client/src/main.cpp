@@ -1,12 +1,20 @@
 #include "SDL_image.h"
 #include "SDL_mixer.h"
+#include "../include/AllocCounter.h"
 #include "../include/AudioManager.h"
 #include "../include/Button.h"
 #include "../include/Game.h"
 #include "../include/Network.h"
 #include "../include/TextureManager.h"
+#include <cstring>
+#include <random>
 
-enum class AppState { MAIN_MENU, SETTINGS, IP_INPUT, CONNECTING, IN_GAME };
+enum class AppState { MAIN_MENU, SETTINGS, IP_INPUT, CONNECTING, RECONNECTING, IN_GAME };
+
+//a dropped session is retried with exponential backoff before giving up to the menu
+constexpr int MAX_RECONNECT_ATTEMPTS = 8;
+constexpr std::chrono::milliseconds RECONNECT_BASE_DELAY{500};
+constexpr std::chrono::milliseconds RECONNECT_MAX_DELAY{8000};
 
 int main(int argc, char* argv[])
 {
@@ -57,8 +65,57 @@ int main(int argc, char* argv[])
     audioManager.loadSFX("button_press", "assets/audio/ui/button_pressed.wav");
     audioManager.loadSFX("block_break", "assets/audio/game/block_break.wav");
 
+    //--connect-timeout <ms> | --telemetry <file.jsonl> | --net-backend sdl|epoll
+    //--capture <file> | --replay <file> [--replay-fast] | --chunks stream|bulk | --no-frame-arena | --udp
+    //--decimal-kernel scalar|sse2|avx2 (text CHUNK_DATA parsing, defaults to the best the cpu has)
+    std::chrono::milliseconds connectTimeout = Network::DEFAULT_CONNECT_TIMEOUT;
+    std::string telemetryPath, capturePath, replayPath;
+    NetBackend backend = Network::defaultBackend();
+    bool replayFast = false, streamChunks = true, frameArena = true, udp = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--replay-fast") == 0)
+            replayFast = true;
+        else if (std::strcmp(argv[i], "--no-frame-arena") == 0)
+            frameArena = false;
+        else if (std::strcmp(argv[i], "--udp") == 0)
+            udp = true;
+    }
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--connect-timeout") == 0)
+            connectTimeout = std::chrono::milliseconds(std::max(1, std::atoi(argv[++i])));
+        else if (std::strcmp(argv[i], "--telemetry") == 0)
+            telemetryPath = argv[++i];
+        else if (std::strcmp(argv[i], "--net-backend") == 0)
+            backend = std::strcmp(argv[++i], "epoll") == 0 ? NetBackend::EPOLL : NetBackend::SDL_NET;
+        else if (std::strcmp(argv[i], "--capture") == 0)
+            capturePath = argv[++i];
+        else if (std::strcmp(argv[i], "--replay") == 0)
+            replayPath = argv[++i];
+        else if (std::strcmp(argv[i], "--chunks") == 0)
+            streamChunks = std::strcmp(argv[++i], "bulk") != 0;
+        else if (std::strcmp(argv[i], "--decimal-kernel") == 0)
+        {
+            const char* name = argv[++i];
+            const Protocol::U16ListKernel kernel = std::strcmp(name, "avx2") == 0 ? Protocol::U16ListKernel::AVX2
+                : std::strcmp(name, "sse2") == 0 ? Protocol::U16ListKernel::SSE2 : Protocol::U16ListKernel::SCALAR;
+            if (!Protocol::setU16ListKernel(kernel))
+                std::cerr << "[CLIENT] This cpu cant run the " << name << " decimal kernel, staying on "
+                          << Protocol::u16ListKernelName(Protocol::u16ListKernel()) << std::endl;
+        }
+    }
+
     Network network;
+    network.setBackend(backend);
+    network.setConditioner(NetConditioner::Config::fromArgs(argc, argv));
+    network.setCaptureFile(capturePath);
+    network.setChunkStreaming(streamChunks);
+    network.setUdpEnabled(udp);
+    if (!telemetryPath.empty())
+        network.getTelemetry().setDumpFile(telemetryPath, std::chrono::seconds(5));
     Game game;
+    game.setFrameArenaEnabled(frameArena);
     network.setGame(&game);
     game.setNetwork(&network);
 
@@ -74,6 +131,69 @@ int main(int argc, char* argv[])
     Button joinButton = {{300, 350, 200, 50}, "JOIN SERVER", {50, 150, 50}, {70, 200, 70}};
     Button backButton = {{300, 420, 200, 50}, "BACK", {60, 60, 70}, {100, 100, 120}};
 
+    //frame pacing while the connect runs in the background, should stay flat even against a dead address
+    std::chrono::steady_clock::time_point connectStarted, lastConnectFrame;
+    double worstConnectFrameMs = 0.0;
+    int connectFrames = 0;
+
+    auto startConnecting = [&]
+    {
+        currentState = AppState::CONNECTING;
+        network.beginConnect(ipInput, 25565, connectTimeout);
+        connectStarted = lastConnectFrame = std::chrono::steady_clock::now();
+        worstConnectFrameMs = 0.0;
+        connectFrames = 0;
+    };
+    auto stopConnecting = [&](const AppState nextState, const std::string& outcome)
+    {
+        currentState = nextState;
+        const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - connectStarted).count();
+        std::cout << "[CLIENT] Connect " << outcome << " after " << elapsedMs << "ms | " << connectFrames
+                  << " frames, worst frame " << worstConnectFrameMs << "ms" << std::endl;
+    };
+
+    //a replay goes straight in game and quits when the capture runs out, its a benchmark run not a session
+    std::chrono::steady_clock::time_point lastReplayFrame;
+    double worstReplayFrameMs = 0.0, totalReplayFrameMs = 0.0;
+    int replayFrames = 0;
+    if (!replayPath.empty() && network.startReplay(replayPath, replayFast))
+    {
+        currentState = AppState::IN_GAME;
+        lastReplayFrame = std::chrono::steady_clock::now();
+    }
+
+    //reconnect state, the world is kept and offered back to the server as chunk hashes
+    int reconnectAttempt = 0;
+    bool reconnectInFlight = false;
+    std::chrono::steady_clock::time_point reconnectStarted, nextReconnectAt;
+    std::minstd_rand reconnectJitter(std::random_device{}());
+
+    auto scheduleReconnect = [&]
+    {
+        reconnectInFlight = false;
+        if (reconnectAttempt >= MAX_RECONNECT_ATTEMPTS)
+        {
+            std::cout << "[CLIENT] Giving up on reconnecting after " << reconnectAttempt << " attempts. Returning to menu." << std::endl;
+            network.setResumeChunks({});
+            game.prepareResume(false);
+            currentState = AppState::MAIN_MENU;
+            return;
+        }
+
+        //half fixed, half random so a restarted server isnt hit by every client in the same instant
+        const auto delay = std::min(RECONNECT_MAX_DELAY, RECONNECT_BASE_DELAY * (1 << reconnectAttempt));
+        nextReconnectAt = std::chrono::steady_clock::now() + delay / 2
+            + std::chrono::milliseconds(std::uniform_int_distribution<int64_t>(0, delay.count() / 2)(reconnectJitter));
+        reconnectAttempt++;
+    };
+    auto stopReconnecting = [&]
+    {
+        network.cancelConnect();
+        network.setResumeChunks({});
+        game.prepareResume(false);
+        currentState = AppState::MAIN_MENU;
+    };
+
     Uint32 fpsLastTime = SDL_GetTicks();
     Uint32 fpsFrames = 0;
     float fps = 0.0f;
@@ -115,10 +235,21 @@ int main(int argc, char* argv[])
                         }
                         if (currentState == AppState::IP_INPUT && joinButton.isHovering(mouseX, mouseY))
                         {
-                            currentState = AppState::CONNECTING;
+                            startConnecting();
                             clicked = true;
                         }
                     }
+                    else if (currentState == AppState::CONNECTING && backButton.isHovering(mouseX, mouseY))
+                    {
+                        network.cancelConnect();
+                        stopConnecting(AppState::IP_INPUT, "cancelled");
+                        clicked = true;
+                    }
+                    else if (currentState == AppState::RECONNECTING && backButton.isHovering(mouseX, mouseY))
+                    {
+                        stopReconnecting();
+                        clicked = true;
+                    }
 
                     if (clicked) audioManager.playSFX("button_press");
                 }
@@ -134,13 +265,20 @@ int main(int argc, char* argv[])
                             ipInput.pop_back();
                         if (event.key.keysym.sym == SDLK_RETURN)
                         {
-                            currentState = AppState::CONNECTING;
+                            startConnecting();
                             audioManager.playSFX("button_press");
                         }
                         if (event.key.keysym.sym == SDLK_ESCAPE)
                             currentState = AppState::MAIN_MENU;
                     }
                 }
+                else if (currentState == AppState::CONNECTING && event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE)
+                {
+                    network.cancelConnect();
+                    stopConnecting(AppState::IP_INPUT, "cancelled");
+                }
+                else if (currentState == AppState::RECONNECTING && event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE)
+                    stopReconnecting();
             }
             else game.handleInput(event);
         }
@@ -176,23 +314,103 @@ int main(int argc, char* argv[])
             }
             else if (currentState == AppState::CONNECTING)
             {
+                const auto now = std::chrono::steady_clock::now();
+                worstConnectFrameMs = std::max(worstConnectFrameMs, std::chrono::duration<double, std::milli>(now - lastConnectFrame).count());
+                lastConnectFrame = now;
+                connectFrames++;
+
                 game.drawText(renderer, "Connecting to " + ipInput + "...", 280, 300, {255, 255, 255, 255});
-                SDL_RenderPresent(renderer);
-                if (network.connectToServer(ipInput, 25565))
-                    currentState = AppState::IN_GAME;
-                else
-                    currentState = AppState::IP_INPUT;
+                backButton.render(renderer, game, mouseX, mouseY);
+
+                switch (network.pollConnect())
+                {
+                case ConnectEvent::CONNECTED:
+                    stopConnecting(AppState::IN_GAME, "succeeded");
+                    break;
+                case ConnectEvent::FAILED:
+                case ConnectEvent::TIMED_OUT:
+                    stopConnecting(AppState::IP_INPUT, "failed (" + network.getConnectError() + ")");
+                    break;
+                default:
+                    break;
+                }
+            }
+            else if (currentState == AppState::RECONNECTING)
+            {
+                game.drawText(renderer, "Connection lost, reconnecting (attempt " + std::to_string(reconnectAttempt) + "/"
+                              + std::to_string(MAX_RECONNECT_ATTEMPTS) + ")...", 200, 300, {255, 255, 255, 255});
+                backButton.render(renderer, game, mouseX, mouseY);
+
+                if (!reconnectInFlight && std::chrono::steady_clock::now() >= nextReconnectAt)
+                {
+                    //hashes are taken fresh every attempt, nothing touches the world while we're disconnected anyway
+                    game.prepareResume(true);
+                    network.setResumeChunks(game.getHeldChunks());
+                    network.beginConnect(ipInput, 25565, connectTimeout);
+                    reconnectInFlight = true;
+                }
+                else if (reconnectInFlight)
+                {
+                    switch (network.pollConnect())
+                    {
+                    case ConnectEvent::CONNECTED:
+                        std::cout << "[CLIENT] Reconnected after " << std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now() - reconnectStarted).count() << "ms (attempt " << reconnectAttempt << ")" << std::endl;
+                        currentState = AppState::IN_GAME;
+                        break;
+                    case ConnectEvent::FAILED:
+                    case ConnectEvent::TIMED_OUT:
+                        std::cout << "[CLIENT] Reconnect attempt " << reconnectAttempt << " failed (" << network.getConnectError() << ")" << std::endl;
+                        scheduleReconnect();
+                        break;
+                    default:
+                        break;
+                    }
+                }
             }
         }
         else
         {
             //check if still connected or not
-            if (!network.isConnected()) {
-                std::cout << "[CLIENT] Disconnected from server. Returning to menu." << std::endl;
-                currentState = AppState::MAIN_MENU;
+            if (network.isReplaying())
+            {
+                const auto now = std::chrono::steady_clock::now();
+                const double frameMs = std::chrono::duration<double, std::milli>(now - lastReplayFrame).count();
+                lastReplayFrame = now;
+                worstReplayFrameMs = std::max(worstReplayFrameMs, frameMs);
+                totalReplayFrameMs += frameMs;
+                replayFrames++;
+            }
+
+            if (!network.isConnected() && network.isReplaying())
+            {
+                std::cout << "[CLIENT] Replay rendered " << replayFrames << " frames, avg "
+                          << (replayFrames > 0 ? totalReplayFrameMs / replayFrames : 0.0) << "ms, worst " << worstReplayFrameMs
+                          << "ms, world loaded in " << game.getWorldLoadMs() << "ms" << std::endl;
+                if (AllocCounter::ENABLED)
+                {
+                    const Game::AllocStats& allocs = game.getMessageAllocStats();
+                    std::cout << "[CLIENT] Replay message handling allocated " << allocs.total << " times over " << allocs.frames << " frames ("
+                              << static_cast<double>(allocs.total) / static_cast<double>(std::max<uint64_t>(allocs.frames, 1))
+                              << " per frame, worst " << allocs.worst << ", frame arena " << (frameArena ? "on" : "off") << ")" << std::endl;
+                }
+                NetTelemetry::logParseRates(network.getTelemetry().snapshot());
+                if (game.getUnknownMessages() > 0)
+                    std::cout << "[CLIENT] Replay had " << game.getUnknownMessages() << " messages nothing handles" << std::endl;
+                network.disconnect();
+                isRunning = false;
+            }
+            else if (!network.isConnected()) {
+                std::cout << "[CLIENT] Disconnected from server. Reconnecting." << std::endl;
                 network.disconnect(); //cleanup threads & socket
+                game.discardSession();
+                currentState = AppState::RECONNECTING;
+                reconnectAttempt = 0;
+                reconnectStarted = std::chrono::steady_clock::now();
+                scheduleReconnect();
             } else {
                 game.processNetworkMessages();
+                network.getTelemetry().dumpIfDue();
                 game.update();
                 game.render(renderer);
             }
@@ -0,0 +1,686 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <SDL.h>
+
+#include "../include/AllocCounter.h"
+#include "../include/ChunkCodec.h"
+#include "../include/Game.h"
+#include "../include/MessageFramer.h"
+#include "../include/NetCapture.h"
+#include "../include/Network.h"
+#include "../include/World.h"
+#include "DecimalDiff.h"
+
+//client_bench: headless parser benchmark. runs message corpora through the MessageFramer, the chunk decoders and
+//Game's handlers the same way a session does and reports ns and heap allocations per message for every opcode,
+//plus MB/s for the framer
+//  --capture <file> (recorded with the client's --capture, can be given more than once) --iterations <n>
+//  --decimal-kernel scalar|sse2|avx2 --no-frame-arena (ITEM_DEF_SYNC on plain new/delete, for a before/after comparison)
+//  --differential <lists> only checks the decimal list kernels against each other, exits non zero on a mismatch
+//the synthetic text and binary corpora always run, then the same chunks as raw CHUNK_DATA so text, raw and packed
+//chunks can be compared and a burst of input sends against a stalled send queue, followed by a malformed corpus cut
+//from them that only has to get through the handlers without taking the process down
+namespace
+{
+    struct Options
+    {
+        std::vector<std::string> capturePaths;
+        int iterations = 20;
+        bool frameArena = true;
+        int differentialLists = 0;
+    };
+
+    Options parseOptions(const int argc, char* argv[])
+    {
+        Options options;
+        for (int i = 1; i < argc; i++)
+        {
+            const std::string arg = argv[i];
+            if (arg == "--no-frame-arena")
+            {
+                options.frameArena = false;
+                continue;
+            }
+            if (i + 1 == argc)
+            {
+                std::cerr << "[BENCH] " << arg << " needs a value" << std::endl;
+                break;
+            }
+
+            const char* value = argv[++i];
+            if (arg == "--capture") options.capturePaths.emplace_back(value);
+            else if (arg == "--iterations") options.iterations = std::max(1, std::atoi(value));
+            else if (arg == "--differential") options.differentialLists = std::max(1, std::atoi(value));
+            else if (arg == "--decimal-kernel")
+            {
+                const Protocol::U16ListKernel kernel = std::strcmp(value, "avx2") == 0 ? Protocol::U16ListKernel::AVX2
+                    : std::strcmp(value, "sse2") == 0 ? Protocol::U16ListKernel::SSE2 : Protocol::U16ListKernel::SCALAR;
+                if (!Protocol::setU16ListKernel(kernel))
+                    std::cerr << "[BENCH] This cpu cant run the " << value << " decimal kernel" << std::endl;
+            }
+            else
+            {
+                std::cerr << "[BENCH] Unknown option " << arg << std::endl;
+                i--;
+            }
+        }
+        return options;
+    }
+
+    //messages exactly as Network hands them to Game, binary frames without their length prefix
+    struct Corpus
+    {
+        std::string name;
+        std::vector<std::string> messages;
+    };
+
+    //Game logs the join burst every session and every malformed message, none of which should be in the numbers
+    class Quiet
+    {
+    public:
+        Quiet() : out(std::cout.rdbuf(&sink)), err(std::cerr.rdbuf(&sink)) {}
+        ~Quiet()
+        {
+            std::cout.rdbuf(out);
+            std::cerr.rdbuf(err);
+        }
+
+    private:
+        struct NullBuffer : std::streambuf
+        {
+            int overflow(const int c) override { return c; }
+        };
+        NullBuffer sink; //declared first so it exists before the streams are pointed at it
+        std::streambuf* out;
+        std::streambuf* err;
+    };
+
+    uint64_t elapsedNs(const std::chrono::steady_clock::time_point start)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    //bytes is only given where the size on the wire matters, it adds bytes per message and MB/s
+    void logRate(const std::string& what, const uint64_t messages, const uint64_t ns, const uint64_t allocations, const uint64_t bytes = 0)
+    {
+        const double count = static_cast<double>(std::max<uint64_t>(messages, 1));
+        std::cout << "[BENCH] " << what << ": " << messages << " messages, " << static_cast<double>(ns) / count << "ns each";
+        if (bytes > 0)
+            std::cout << ", " << static_cast<double>(bytes) / count << " bytes each, "
+                      << static_cast<double>(bytes) * 1000.0 / static_cast<double>(std::max<uint64_t>(ns, 1)) << " MB/s";
+        if (AllocCounter::ENABLED)
+            std::cout << ", " << static_cast<double>(allocations) / count << " allocations each";
+        std::cout << std::endl;
+    }
+
+    template<typename Fields>
+    void addFrame(Corpus& corpus, const Protocol::Opcode opcode, Fields&& fields)
+    {
+        std::string frame;
+        Protocol::BinaryWriter writer(frame, opcode);
+        fields(writer);
+        writer.finish();
+        uint32_t length;
+        corpus.messages.push_back(frame.substr(Protocol::readVarint(frame.data(), frame.size(), length)));
+    }
+
+    //one join burst then a stretch of play, the same session in both encodings.
+    //31 other players walking around, a few hundred tile changes and the odd inventory update
+    struct Session
+    {
+        static constexpr int PLAYERS = 32;
+        static constexpr int CHUNKS_X = 8, CHUNKS_Y = 4;
+        static constexpr int MOVES = 2000;
+        static constexpr int TILE_UPDATES = 200;
+        static constexpr int REGIONS = 40, REGION_SIZE = 12;
+        static constexpr int INV_UPDATES = 50;
+
+        struct Item { int id; std::string name; int maxStack; bool isTile; int tileType; };
+        std::vector<Item> items;
+        std::vector<std::array<uint16_t, Chunk::SIZE * Chunk::SIZE * TileLayer::NUM_LAYERS>> chunks; //layer, then rows bottom up
+        std::vector<std::array<float, 3>> moves; //id, x, y
+        struct Update { int x, y, tile, layer; };
+        std::vector<Update> tileUpdates;
+        std::vector<std::vector<Update>> regions;
+        std::vector<std::array<int, 3>> invUpdates; //slot, item, quantity
+
+        explicit Session(const uint32_t seed)
+        {
+            std::mt19937 rng(seed);
+            items = { {1, "Dirt", 999, true, 1}, {2, "Stone", 999, true, 2}, {3, "Wood", 999, true, 3}, {4, "Torch", 99, true, 4},
+                      {5, "Copper Pickaxe", 1, false, 0}, {6, "Copper Axe", 1, false, 0}, {7, "Copper Hammer", 1, false, 0} };
+
+            //ground in the bottom half, mostly dirt with stone further down and a dirt wall behind it
+            chunks.resize(CHUNKS_X * CHUNKS_Y);
+            for (size_t c = 0; c < chunks.size(); c++)
+            {
+                const int chunkRow = static_cast<int>(c) / CHUNKS_X;
+                for (int layer = 0; layer < TileLayer::NUM_LAYERS; layer++)
+                    for (int y = 0; y < Chunk::SIZE; y++)
+                        for (int x = 0; x < Chunk::SIZE; x++)
+                        {
+                            const int depth = (CHUNKS_Y - chunkRow) * Chunk::SIZE - y;
+                            uint16_t tile = 0;
+                            if (depth > Chunk::SIZE * CHUNKS_Y / 2)
+                                tile = layer == 1 ? 1 : static_cast<uint16_t>(rng() % 8 == 0 || depth > Chunk::SIZE * 3 ? 2 : 1);
+                            chunks[c][(layer * Chunk::SIZE + y) * Chunk::SIZE + x] = tile;
+                        }
+            }
+
+            constexpr float width = CHUNKS_X * Chunk::SIZE;
+            for (int i = 0; i < MOVES; i++)
+                moves.push_back({ static_cast<float>(2 + i % (PLAYERS - 1)), std::uniform_real_distribution<float>(0.0f, width)(rng),
+                                  std::uniform_real_distribution<float>(20.0f, 40.0f)(rng) });
+
+            auto randomUpdate = [&rng]
+            {
+                constexpr int worldHeight = World::WORLD_HEIGHT_IN_CHUNKS * Chunk::SIZE;
+                const int bottomUpY = static_cast<int>(rng() % (CHUNKS_Y * Chunk::SIZE));
+                return Update{ static_cast<int>(rng() % (CHUNKS_X * Chunk::SIZE)), worldHeight - 1 - bottomUpY,
+                               static_cast<int>(rng() % 3), static_cast<int>(rng() % TileLayer::NUM_LAYERS) };
+            };
+            for (int i = 0; i < TILE_UPDATES; i++)
+                tileUpdates.push_back(randomUpdate());
+            for (int r = 0; r < REGIONS; r++)
+            {
+                regions.emplace_back();
+                for (int i = 0; i < REGION_SIZE; i++)
+                    regions.back().push_back(randomUpdate());
+            }
+            for (int i = 0; i < INV_UPDATES; i++)
+                invUpdates.push_back({ static_cast<int>(rng() % 40), 1 + static_cast<int>(rng() % items.size()), 1 + static_cast<int>(rng() % 99) });
+        }
+
+        [[nodiscard]] Corpus text() const
+        {
+            Corpus corpus{"synthetic text", {}};
+            std::vector<std::string>& out = corpus.messages;
+            out.emplace_back("ASSIGN_ID,1");
+
+            std::string defs = "ITEM_DEF_SYNC,";
+            for (const Item& item : items)
+            {
+                if (defs.back() != ',') defs += '|';
+                defs += std::to_string(item.id) + ':' + item.name + ':' + std::to_string(item.maxStack) + ':'
+                        + (item.isTile ? "T:" + std::to_string(item.tileType) : std::string("R:PICKAXE:4.5"));
+            }
+            out.push_back(defs);
+
+            out.emplace_back("SPAWN,1,64.0,30.0");
+            for (int id = 2; id <= PLAYERS; id++)
+                out.push_back("PLAYER_JOIN," + std::to_string(id) + ",64.0,30.0");
+
+            for (size_t c = 0; c < chunks.size(); c++)
+            {
+                std::string line = "CHUNK_DATA," + std::to_string(c % CHUNKS_X) + ',' + std::to_string(c / CHUNKS_X);
+                for (const uint16_t tile : chunks[c])
+                    line += ',' + std::to_string(tile);
+                out.push_back(line);
+            }
+
+            std::string inventory = "INV_SYNC,";
+            for (int slot = 0; slot < 40; slot++)
+                inventory += slot < 10 ? ',' + std::to_string(1 + slot % items.size()) + ",99" : std::string(",0,0");
+            out.push_back(inventory);
+
+            //play: moves every tick, tile changes and inventory updates mixed in between
+            size_t tile = 0, region = 0, inv = 0;
+            for (size_t i = 0; i < moves.size(); i++)
+            {
+                char line[96];
+                std::snprintf(line, sizeof(line), "PLAYER_MOVE,%d,%.3f,%.3f", static_cast<int>(moves[i][0]), moves[i][1], moves[i][2]);
+                out.emplace_back(line);
+
+                if (i % 10 == 0 && tile < tileUpdates.size())
+                {
+                    const Update& u = tileUpdates[tile++];
+                    out.push_back("UPDATE_TILE," + std::to_string(u.x) + ',' + std::to_string(u.y) + ',' + std::to_string(u.tile) + ',' + std::to_string(u.layer));
+                }
+                if (i % 50 == 0 && region < regions.size())
+                {
+                    std::string batch = "UPDATE_REGION";
+                    for (const Update& u : regions[region++])
+                        batch += ',' + std::to_string(u.x) + ',' + std::to_string(u.y) + ',' + std::to_string(u.tile) + ',' + std::to_string(u.layer);
+                    out.push_back(batch);
+                }
+                if (i % 40 == 0 && inv < invUpdates.size())
+                {
+                    const std::array<int, 3>& u = invUpdates[inv++];
+                    out.push_back("INV_UPDATE,1," + std::to_string(u[0]) + ',' + std::to_string(u[1]) + ',' + std::to_string(u[2]));
+                }
+            }
+            for (int id = PLAYERS; id > PLAYERS - 4; id--)
+                out.push_back("PLAYER_LEAVE," + std::to_string(id));
+            return corpus;
+        }
+
+        //the same chunks as plain CHUNK_DATA frames, every id as a u16. only the chunk decode runs on these so the
+        //three formats can be compared on size and decode time
+        [[nodiscard]] Corpus rawChunks() const
+        {
+            Corpus corpus{"synthetic raw chunks", {}};
+            for (size_t c = 0; c < chunks.size(); c++)
+                addFrame(corpus, Protocol::Opcode::CHUNK_DATA, [this, c](Protocol::BinaryWriter& w)
+                {
+                    w.i32(static_cast<int32_t>(c % CHUNKS_X));
+                    w.i32(static_cast<int32_t>(c / CHUNKS_X));
+                    for (const uint16_t tile : chunks[c])
+                        w.u16(tile);
+                });
+            return corpus;
+        }
+
+        [[nodiscard]] Corpus binary() const
+        {
+            using Protocol::BinaryWriter;
+            using Protocol::Opcode;
+            Corpus corpus{"synthetic binary", {}};
+            addFrame(corpus, Opcode::ASSIGN_ID, [](BinaryWriter& w) { w.i32(1); });
+            addFrame(corpus, Opcode::ITEM_DEF_SYNC, [this](BinaryWriter& w)
+            {
+                w.varint(static_cast<uint32_t>(items.size()));
+                for (const Item& item : items)
+                {
+                    w.i32(item.id);
+                    w.str(item.name);
+                    w.i32(item.maxStack);
+                    if (item.isTile)
+                    {
+                        w.u8('T');
+                        w.i32(item.tileType);
+                    }
+                    else
+                    {
+                        w.u8('R');
+                        w.str("PICKAXE");
+                        w.f32(4.5f);
+                    }
+                }
+            });
+
+            addFrame(corpus, Opcode::SPAWN, [](BinaryWriter& w) { w.i32(1); w.f32(64.0f); w.f32(30.0f); });
+            for (int id = 2; id <= PLAYERS; id++)
+                addFrame(corpus, Opcode::PLAYER_JOIN, [id](BinaryWriter& w) { w.i32(id); w.f32(64.0f); w.f32(30.0f); });
+
+            //what a v2 server sends, runs of one palette index per layer
+            for (size_t c = 0; c < chunks.size(); c++)
+                addFrame(corpus, Opcode::CHUNK_DATA_PACKED, [this, c](BinaryWriter& w)
+                {
+                    w.i32(static_cast<int32_t>(c % CHUNKS_X));
+                    w.i32(static_cast<int32_t>(c / CHUNKS_X));
+                    std::vector<uint16_t> palette;
+                    for (const uint16_t tile : chunks[c])
+                        if (std::find(palette.begin(), palette.end(), tile) == palette.end())
+                            palette.push_back(tile);
+                    w.u8(static_cast<uint8_t>(palette.size()));
+                    for (const uint16_t tile : palette)
+                        w.u16(tile);
+
+                    constexpr size_t tilesPerLayer = Chunk::SIZE * Chunk::SIZE;
+                    for (size_t layer = 0; layer < TileLayer::NUM_LAYERS; layer++)
+                        for (size_t i = 0; i < tilesPerLayer;)
+                        {
+                            const uint16_t tile = chunks[c][layer * tilesPerLayer + i];
+                            size_t run = 1;
+                            while (i + run < tilesPerLayer && chunks[c][layer * tilesPerLayer + i + run] == tile)
+                                run++;
+                            w.varint(static_cast<uint32_t>(run));
+                            w.u8(static_cast<uint8_t>(std::find(palette.begin(), palette.end(), tile) - palette.begin()));
+                            i += run;
+                        }
+                });
+
+            addFrame(corpus, Opcode::INV_SYNC, [this](BinaryWriter& w)
+            {
+                w.varint(40);
+                for (int slot = 0; slot < 40; slot++)
+                {
+                    w.i32(slot < 10 ? 1 + slot % static_cast<int>(items.size()) : 0);
+                    w.i32(slot < 10 ? 99 : 0);
+                }
+            });
+
+            size_t tile = 0, region = 0, inv = 0;
+            for (size_t i = 0; i < moves.size(); i++)
+            {
+                const std::array<float, 3>& m = moves[i];
+                addFrame(corpus, Opcode::PLAYER_MOVE, [&m](BinaryWriter& w) { w.i32(static_cast<int32_t>(m[0])); w.f32(m[1]); w.f32(m[2]); });
+
+                if (i % 10 == 0 && tile < tileUpdates.size())
+                {
+                    const Update& u = tileUpdates[tile++];
+                    addFrame(corpus, Opcode::UPDATE_TILE, [&u](BinaryWriter& w)
+                    {
+                        w.i32(u.x);
+                        w.i32(u.y);
+                        w.u16(static_cast<uint16_t>(u.tile));
+                        w.u8(static_cast<uint8_t>(u.layer));
+                    });
+                }
+                if (i % 50 == 0 && region < regions.size())
+                {
+                    const std::vector<Update>& batch = regions[region++];
+                    addFrame(corpus, Opcode::UPDATE_REGION, [&batch](BinaryWriter& w)
+                    {
+                        w.varint(static_cast<uint32_t>(batch.size()));
+                        for (const Update& u : batch)
+                        {
+                            w.varint(static_cast<uint32_t>(u.x));
+                            w.varint(static_cast<uint32_t>(u.y));
+                            w.u16(static_cast<uint16_t>(u.tile));
+                            w.u8(static_cast<uint8_t>(u.layer));
+                        }
+                    });
+                }
+                if (i % 40 == 0 && inv < invUpdates.size())
+                {
+                    const std::array<int, 3>& u = invUpdates[inv++];
+                    addFrame(corpus, Opcode::INV_UPDATE, [&u](BinaryWriter& w) { w.i32(1); w.i32(u[0]); w.i32(u[1]); w.i32(u[2]); });
+                }
+            }
+            for (int id = PLAYERS; id > PLAYERS - 4; id--)
+                addFrame(corpus, Opcode::PLAYER_LEAVE, [id](BinaryWriter& w) { w.i32(id); });
+            return corpus;
+        }
+    };
+
+    //the first few of every opcode, cut short at every byte and with each text field swapped for junk
+    Corpus malformed(const std::vector<const Corpus*>& sources)
+    {
+        static constexpr const char* JUNK[] = { "", "x", "-", "1e99", "99999999999", "0x10", "nan", "1.2.3", "--1" };
+        static constexpr int SAMPLES_PER_OPCODE = 3;
+        static constexpr size_t MAX_CUTS = 64; //a CHUNK_DATA line is a few kilobytes, every cut would just be more of the same
+
+        Corpus corpus{"malformed", {}};
+        std::map<uint8_t, int> taken;
+        for (const Corpus* source : sources)
+            for (const std::string& msg : source->messages)
+            {
+                if (taken[static_cast<uint8_t>(Protocol::messageOpcode(msg))]++ >= SAMPLES_PER_OPCODE)
+                    continue;
+
+                const size_t step = std::max<size_t>(1, msg.size() / MAX_CUTS);
+                for (size_t cut = 1; cut < msg.size(); cut += step)
+                    corpus.messages.push_back(msg.substr(0, cut));
+                if (Protocol::isBinaryFrame(msg))
+                    continue;
+
+                for (size_t start = msg.find(',') + 1, field = 0; start != 0 && field < MAX_CUTS; start = msg.find(',', start) + 1, field++)
+                {
+                    const size_t end = std::min(msg.find(',', start), msg.size());
+                    for (const char* junk : JUNK)
+                        corpus.messages.push_back(msg.substr(0, start) + junk + msg.substr(end));
+                }
+            }
+        return corpus;
+    }
+
+    //the socket side: the corpus as one byte stream, handed to the framer in socket sized reads
+    void benchFramer(const Corpus& corpus, const int iterations)
+    {
+        static constexpr size_t READ_SIZE = 16 * 1024;
+
+        for (const bool binary : { false, true })
+        {
+            std::string stream;
+            uint64_t expected = 0;
+            for (const std::string& msg : corpus.messages)
+            {
+                if (Protocol::isBinaryFrame(msg) != binary)
+                    continue;
+                if (binary)
+                    Protocol::appendVarint(stream, static_cast<uint32_t>(msg.size()));
+                stream += msg;
+                if (!binary)
+                    stream += '\n';
+                expected++;
+            }
+            if (expected == 0)
+                continue;
+
+            MessageFramer framer;
+            uint64_t messages = 0, ns = 0, allocations = 0, bytes = 0;
+            for (int iteration = 0; iteration <= iterations; iteration++) //the first pass only warms the buffer up
+            {
+                framer.reset();
+                uint64_t found = 0;
+                const uint64_t allocationsBefore = AllocCounter::threadAllocations();
+                const auto start = std::chrono::steady_clock::now();
+                for (size_t pos = 0; pos < stream.size() && !framer.hasError();)
+                {
+                    char* write = framer.prepareWrite();
+                    const size_t bytes = std::min({ framer.writeSpace(), READ_SIZE, stream.size() - pos });
+                    std::memcpy(write, stream.data() + pos, bytes);
+                    framer.commitWrite(bytes);
+                    pos += bytes;
+
+                    std::string_view msg;
+                    while (binary ? framer.nextFrame(msg) : framer.nextLine(msg))
+                        found++;
+                }
+                if (found != expected)
+                    std::cerr << "[BENCH] Framer found " << found << " of " << expected << " messages in " << corpus.name << std::endl;
+                if (iteration == 0)
+                    continue;
+                ns += elapsedNs(start);
+                allocations += AllocCounter::threadAllocations() - allocationsBefore;
+                messages += found;
+                bytes += stream.size();
+            }
+            logRate("Frame " + corpus.name + (binary ? " (binary)" : " (text)"), messages, ns, allocations, bytes);
+        }
+    }
+
+    //Game hands chunks to the decoder pool, so the decode itself is measured here on the calling thread
+    void benchChunkDecode(const Corpus& corpus, const int iterations)
+    {
+        std::map<uint8_t, std::array<uint64_t, 4>> rates; //messages, ns, allocations, bytes
+        for (int iteration = 0; iteration < iterations; iteration++)
+            for (const std::string& msg : corpus.messages)
+            {
+                const Protocol::Opcode opcode = Protocol::messageOpcode(msg);
+                if (opcode != Protocol::Opcode::CHUNK_DATA && opcode != Protocol::Opcode::CHUNK_DATA_PACKED)
+                    continue;
+
+                const uint64_t allocationsBefore = AllocCounter::threadAllocations();
+                const auto start = std::chrono::steady_clock::now();
+                std::unique_ptr<Chunk> chunk;
+                if (!Protocol::isBinaryFrame(msg))
+                    chunk = ChunkCodec::decodeText(msg);
+                else
+                {
+                    Protocol::BinaryReader reader(std::string_view(msg).substr(1));
+                    chunk = opcode == Protocol::Opcode::CHUNK_DATA ? ChunkCodec::decodeRaw(reader) : ChunkCodec::decodePacked(reader);
+                }
+                chunk.reset(); //freeing it is part of the cost, the allocation is counted anyway
+                const uint64_t ns = elapsedNs(start);
+                const uint64_t allocations = AllocCounter::threadAllocations() - allocationsBefore;
+
+                std::array<uint64_t, 4>& rate = rates[static_cast<uint8_t>(opcode)];
+                rate[0]++;
+                rate[1] += ns;
+                rate[2] += allocations;
+                rate[3] += msg.size(); //without the newline or length prefix, a byte or two either way
+            }
+
+        for (const auto& [opcode, rate] : rates)
+            logRate(std::string("Decode ") + Protocol::opcodeName(opcode) + " in " + corpus.name, rate[0], rate[1], rate[2], rate[3]);
+    }
+
+    //through the receive queue and processNetworkMessages, so the numbers are the ones the F3 overlay and a replay report
+    void runThroughGame(Game& game, const Corpus& corpus)
+    {
+        static constexpr size_t BATCH = MessageQueue::DEFAULT_CAPACITY / 4; //roughly a busy frame
+        const std::atomic<bool> keepWaiting{true};
+
+        for (size_t i = 0; i < corpus.messages.size(); i += BATCH)
+        {
+            for (size_t j = i; j < std::min(i + BATCH, corpus.messages.size()); j++)
+                game.pushNetworkMessage(corpus.messages[j], keepWaiting);
+            game.processNetworkMessages();
+
+            //install what the decoder pool made of this batch before the tile updates in the next one arrive
+            while (game.getChunksDecoding() > 0)
+            {
+                std::this_thread::yield();
+                game.processNetworkMessages();
+            }
+        }
+    }
+
+    void benchHandlers(Game& game, Network& network, const Corpus& corpus, const int iterations)
+    {
+        const uint64_t unknownBefore = game.getUnknownMessages();
+        {
+            Quiet quiet;
+            runThroughGame(game, corpus); //warm up, the world and the player map reach their steady size
+            network.getTelemetry().reset();
+            for (int iteration = 0; iteration < iterations; iteration++)
+                runThroughGame(game, corpus);
+        }
+
+        std::cout << "[BENCH] Handle " << corpus.name << ", " << corpus.messages.size() << " messages x " << iterations << ":" << std::endl;
+        NetTelemetry::logParseRates(network.getTelemetry().snapshot());
+        if (const uint64_t unknown = game.getUnknownMessages() - unknownBefore; unknown > 0)
+            std::cout << "[BENCH] " << unknown << " messages in " << corpus.name << " went to no handler" << std::endl;
+    }
+
+    //the outgoing side while the socket is stalled: every frame the view moves, the held mouse uses the tile under a
+    //sweeping cursor and an inventory drag moves a stack. nothing is connected, so everything waits in the send queue
+    //until disconnect clears it, which stands in for the send thread finally taking the batch
+    void benchSendQueue(const int iterations)
+    {
+        for (const int stallFrames : { 30, 600 }) //half a second, ten seconds at 60fps
+        {
+            Network network;
+            uint64_t calls = 0, ns = 0, allocations = 0;
+            for (int iteration = 0; iteration < iterations; iteration++)
+            {
+                const uint64_t allocationsBefore = AllocCounter::threadAllocations();
+                const auto start = std::chrono::steady_clock::now();
+                for (int frame = 0; frame < stallFrames; frame++)
+                {
+                    network.sendView({ frame / 20, 0, frame / 20 + 4, 3 });
+                    network.sendUseItem(0, 100 + frame / 2, 50);
+                    calls += 2;
+                    if (frame % 3 == 0)
+                    {
+                        network.sendInvMoveItem(10 + frame / 30 % 10, 1, 1 + frame % 99);
+                        calls++;
+                    }
+                }
+                ns += elapsedNs(start);
+                allocations += AllocCounter::threadAllocations() - allocationsBefore;
+                network.disconnect();
+            }
+
+            const SendQueueStats stats = network.getSendQueueStats();
+            logRate("Queue sends over a " + std::to_string(stallFrames) + " frame stall", calls, ns, allocations);
+            std::cout << "[BENCH] " << calls - stats.merged - stats.deduplicated - stats.dropped << " of " << calls << " left to send | merged "
+                      << stats.merged << ", deduplicated " << stats.deduplicated << ", dropped " << stats.dropped
+                      << " | max depth " << stats.maxDepth << std::endl;
+        }
+    }
+
+    bool loadCapture(const std::string& path, Corpus& corpus)
+    {
+        NetCapture::Reader reader;
+        if (!reader.open(path))
+            return false;
+
+        corpus.name = path;
+        NetCapture::Record record;
+        while (reader.next(record))
+            if (!record.data.empty()) //session markers
+                corpus.messages.push_back(std::move(record.data));
+        return true;
+    }
+
+    //same seed every run so a mismatch can be reproduced, the failing list is printed either way
+    bool checkDecimalKernels(const int lists)
+    {
+        std::mt19937 rng(1234);
+        for (int i = 0; i < lists; i++)
+        {
+            size_t maxCount;
+            const std::string list = DecimalDiff::randomList(rng, maxCount);
+            if (const Protocol::U16ListKernel kernel = DecimalDiff::firstMismatch(list, maxCount); kernel != Protocol::U16ListKernel::SCALAR)
+            {
+                std::cerr << "[BENCH] " << Protocol::u16ListKernelName(kernel) << " decimal kernel disagrees with scalar on list " << i
+                          << " (limit " << maxCount << "): " << list << std::endl;
+                return false;
+            }
+        }
+
+        std::cout << "[BENCH] Decimal kernels agree with scalar on " << lists << " lists (";
+        const char* separator = "";
+        for (const Protocol::U16ListKernel kernel : { Protocol::U16ListKernel::SSE2, Protocol::U16ListKernel::AVX2 })
+        {
+            const Protocol::U16ListKernel active = Protocol::u16ListKernel();
+            if (Protocol::setU16ListKernel(kernel))
+            {
+                std::cout << separator << Protocol::u16ListKernelName(kernel);
+                separator = ", ";
+            }
+            Protocol::setU16ListKernel(active);
+        }
+        std::cout << (*separator ? "" : "no vector kernels on this cpu") << ")" << std::endl;
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const Options options = parseOptions(argc, argv);
+    if (options.differentialLists > 0)
+        return checkDecimalKernels(options.differentialLists) ? 0 : 1;
+
+    std::cout << "[BENCH] " << options.iterations << " iterations, " << Protocol::u16ListKernelName(Protocol::u16ListKernel())
+              << " decimal kernel, frame arena " << (options.frameArena ? "on" : "off")
+              << (AllocCounter::ENABLED ? "" : ", allocation counting not built in") << std::endl;
+
+    const Session session(1234);
+    std::vector<Corpus> corpora = { session.text(), session.binary() };
+    for (const std::string& path : options.capturePaths)
+    {
+        if (Corpus capture; loadCapture(path, capture))
+            corpora.push_back(std::move(capture));
+        else
+            std::cerr << "[BENCH] Failed to read capture " << path << std::endl;
+    }
+
+    //never connects, it is only there to collect the parse telemetry Game records
+    Network network;
+    Game game(true);
+    game.setNetwork(&network);
+    game.setFrameArenaEnabled(options.frameArena);
+
+    for (const Corpus& corpus : corpora)
+    {
+        benchFramer(corpus, options.iterations);
+        benchChunkDecode(corpus, options.iterations);
+        benchHandlers(game, network, corpus, options.iterations);
+    }
+    benchChunkDecode(session.rawChunks(), options.iterations);
+    benchSendQueue(options.iterations);
+
+    //anything that throws or reads out of bounds in here takes the process down, getting to the end is the test
+    const Corpus broken = malformed({ &corpora[0], &corpora[1] });
+    {
+        Quiet quiet; //rates for junk mean nothing and every bad chunk logs
+        benchFramer(broken, 1);
+        benchChunkDecode(broken, 1);
+    }
+    benchHandlers(game, network, broken, 1);
+    std::cout << "[BENCH] " << broken.messages.size() << " malformed messages handled" << std::endl;
+    return 0;
+}
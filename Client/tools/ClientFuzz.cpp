@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+#include <string_view>
+#include <thread>
+
+#include "../include/Game.h"
+#include "../include/MessageFramer.h"
+#include "../include/Network.h"
+#include "DecimalDiff.h"
+
+//client_fuzz: libFuzzer target for the receive path. an input is a raw tcp stream the way the socket hands it over:
+//the first byte picks text or binary framing and how big the reads are, the rest is split by MessageFramer and goes
+//to Game through the same queue Network fills, so lines end up in handleOneNetworkMessage and frames in
+//handleBinaryMessage. text lines also go through the decimal kernel differential check.
+//  client_fuzz <corpus dir> [libFuzzer options], a capture from the client's --capture makes a good seed
+namespace
+{
+    //Game logs every bad message, at fuzzing speed that is most of the run time
+    class NullBuffer : public std::streambuf
+    {
+    protected:
+        int overflow(const int c) override { return c; }
+        std::streamsize xsputn(const char*, const std::streamsize count) override { return count; }
+    };
+
+    struct Harness
+    {
+        NullBuffer sink;
+        Network network; //never connects, Game only records telemetry through it
+        Game game{true};
+        MessageFramer framer;
+        const std::atomic<bool> keepWaiting{true};
+        size_t queued = 0;
+
+        Harness()
+        {
+            std::cout.rdbuf(&sink);
+            std::cerr.rdbuf(&sink);
+            game.setNetwork(&network);
+        }
+
+        //handles everything queued so far, including the chunks still on the decoder pool
+        void settle()
+        {
+            game.processNetworkMessages();
+            while (game.getChunksDecoding() > 0)
+            {
+                std::this_thread::yield();
+                game.processNetworkMessages();
+            }
+            queued = 0;
+        }
+
+        void deliver(const std::string_view msg)
+        {
+            //push blocks on a full queue and nothing else is draining it here
+            if (queued == MessageQueue::DEFAULT_CAPACITY)
+                settle();
+            game.pushNetworkMessage(msg, keepWaiting);
+            queued++;
+        }
+    };
+
+    Harness& harness()
+    {
+        static Harness* instance = new Harness(); //left to the process exit, Game and Network cant be torn down mid run
+        return *instance;
+    }
+
+    //the part of a text line after its command, every list parser starts from there
+    void checkDecimalKernels(const std::string_view line)
+    {
+        const size_t comma = line.find(',');
+        if (comma == std::string_view::npos)
+            return;
+        if (DecimalDiff::firstMismatch(line.substr(comma + 1), 512) != Protocol::U16ListKernel::SCALAR)
+            std::abort();
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, const size_t size)
+{
+    if (size == 0)
+        return 0;
+
+    Harness& h = harness();
+    const bool binary = data[0] & 1;
+    const size_t readSize = 1 + (data[0] >> 1) * 67; //1 byte up to about 8KB per read
+    const char* stream = reinterpret_cast<const char*>(data + 1);
+    const size_t streamSize = size - 1;
+
+    //every input is its own session, ASSIGN_ID drops the players and world the previous one left behind
+    h.deliver("ASSIGN_ID,1");
+    h.framer.reset();
+
+    for (size_t pos = 0; pos < streamSize && !h.framer.hasError();)
+    {
+        char* write = h.framer.prepareWrite();
+        const size_t bytes = std::min(std::min(h.framer.writeSpace(), readSize), streamSize - pos);
+        std::memcpy(write, stream + pos, bytes);
+        h.framer.commitWrite(bytes);
+        pos += bytes;
+
+        std::string_view msg;
+        while (binary ? h.framer.nextFrame(msg) : h.framer.nextLine(msg))
+        {
+            if (!binary)
+                checkDecimalKernels(msg);
+            h.deliver(msg);
+        }
+    }
+    h.settle();
+    return 0;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../include/Protocol.h"
+
+//differential check of the parseU16List kernels. every vector kernel this cpu can run has to agree with the scalar
+//loop on the values, the error and where the list stopped. client_bench --differential runs it over random lists,
+//client_fuzz over whatever the fuzzer comes up with
+namespace DecimalDiff
+{
+    struct Outcome
+    {
+        std::vector<uint16_t> values;
+        Protocol::ParseError error = Protocol::ParseError::NONE;
+        size_t rest = 0; //bytes left after the list
+
+        bool operator==(const Outcome& other) const { return values == other.values && error == other.error && rest == other.rest; }
+        bool operator!=(const Outcome& other) const { return !(*this == other); }
+    };
+
+    inline Outcome run(const Protocol::U16ListKernel kernel, const std::string_view list, const size_t maxCount)
+    {
+        Protocol::setU16ListKernel(kernel);
+
+        //an exact size heap copy, so a kernel reading past the end of the list trips the sanitizers
+        const std::unique_ptr<char[]> copy(new char[list.empty() ? 1 : list.size()]);
+        if (!list.empty())
+            std::memcpy(copy.get(), list.data(), list.size());
+        std::string_view text(copy.get(), list.size());
+
+        Outcome outcome;
+        outcome.values.resize(maxCount);
+        outcome.values.resize(Protocol::parseU16List(text, outcome.values.data(), maxCount, outcome.error));
+        outcome.rest = text.size();
+        return outcome;
+    }
+
+    //the first kernel that disagreed with scalar, SCALAR if they all agree. whichever kernel was active stays active
+    inline Protocol::U16ListKernel firstMismatch(const std::string_view list, const size_t maxCount)
+    {
+        const Protocol::U16ListKernel active = Protocol::u16ListKernel();
+        const Outcome expected = run(Protocol::U16ListKernel::SCALAR, list, maxCount);
+
+        Protocol::U16ListKernel mismatch = Protocol::U16ListKernel::SCALAR;
+        for (const Protocol::U16ListKernel kernel : { Protocol::U16ListKernel::SSE2, Protocol::U16ListKernel::AVX2 })
+        {
+            if (!Protocol::setU16ListKernel(kernel))
+                continue; //not on this cpu
+            if (run(kernel, list, maxCount) != expected)
+            {
+                mismatch = kernel;
+                break;
+            }
+        }
+        Protocol::setU16ListKernel(active);
+        return mismatch;
+    }
+
+    //a list like the tail of CHUNK_DATA or INV_SYNC: mostly small ids with the odd big or zero padded one,
+    //a limit that sometimes stops it early and every other one damaged a little
+    inline std::string randomList(std::mt19937& rng, size_t& maxCount)
+    {
+        static constexpr char JUNK[] = "0123456789,,a -99999";
+
+        const size_t count = rng() % 600;
+        std::string list;
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint32_t value = rng() % 4 == 0 ? rng() % 65536 : rng() % 40;
+            if (i > 0) list += ',';
+            if (rng() % 50 == 0 && value < 10000) list += '0';
+            list += std::to_string(value);
+        }
+        maxCount = rng() % 3 == 0 ? rng() % 700 : count;
+
+        if (rng() % 2 == 0)
+        {
+            for (int edits = 1 + static_cast<int>(rng() % 3); edits > 0 && !list.empty(); edits--)
+            {
+                const size_t pos = rng() % list.size();
+                const char c = JUNK[rng() % (sizeof(JUNK) - 1)];
+                switch (rng() % 3)
+                {
+                case 0: list[pos] = c; break;
+                case 1: list.insert(pos, 1, c); break;
+                default: list.erase(pos, 1); break;
+                }
+            }
+        }
+        if (rng() % 20 == 0 && count > 0)
+            list += ','; //trailing comma
+        return list;
+    }
+}
@@ -0,0 +1,202 @@
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//protocol_schema: writes the server's MessageSchema.java from Messages.def, so both ends get their layouts from one
+//file. the def is expanded twice, the entries first so the layouts after them can refer to them.
+//  protocol_schema <MessageSchema.java>          regenerate it
+//  protocol_schema --check <MessageSchema.java>  fail if it is out of date, the client build runs this
+namespace
+{
+    class JavaSchema
+    {
+    public:
+        enum class Pass { ENTRIES, LAYOUTS };
+        Pass pass = Pass::ENTRIES;
+        std::ostringstream out;
+
+        void entry(const char* name)
+        {
+            printing = pass == Pass::ENTRIES;
+            if (printing) out << "    static final Field[] " << constantName(name) << " = { ";
+            groups.push_back(true);
+        }
+        void endEntry()
+        {
+            groups.pop_back();
+            if (printing) out << " };\n";
+            printing = false;
+        }
+        void message(const char* op)
+        {
+            printing = pass == Pass::LAYOUTS;
+            if (printing) out << "            new Layout(" << op << ", \"" << op << "\"";
+            groups.push_back(false);
+        }
+        void endMessage()
+        {
+            groups.pop_back();
+            if (printing) out << "),\n";
+            printing = false;
+        }
+
+        void field(const char* kind, const char* type) { item(std::string("Field.") + kind + "(Type." + upper(type) + ")"); }
+        void list(const char* entryName, const char separator, const char fieldSeparator)
+        {
+            item("Field.list(" + charLiteral(separator) + ", " + charLiteral(fieldSeparator) + ", " + constantName(entryName) + ")");
+        }
+        void array(const char* type, const long count) { item("Field.array(Type." + upper(type) + ", " + std::to_string(count) + ")"); }
+
+        void beginSwitch(const char* type)
+        {
+            item("Field.select(Type." + upper(type));
+            groups.push_back(false);
+            caseOpen.push_back(false);
+        }
+        void beginCase(const char value)
+        {
+            if (caseOpen.back()) closeGroup();
+            item("new Case(" + charLiteral(value));
+            groups.push_back(false);
+            caseOpen.back() = true;
+        }
+        void endSwitch()
+        {
+            if (caseOpen.back()) closeGroup();
+            caseOpen.pop_back();
+            closeGroup();
+        }
+
+    private:
+        bool printing = false;
+        std::vector<bool> groups;   //argument lists still open, true until the first item goes in
+        std::vector<bool> caseOpen; //per SWITCH
+
+        void item(const std::string& text)
+        {
+            if (!groups.back() && printing) out << ", ";
+            groups.back() = false;
+            if (printing) out << text;
+        }
+        void closeGroup()
+        {
+            groups.pop_back();
+            if (printing) out << ")";
+        }
+
+        static std::string upper(const char* name)
+        {
+            std::string s(name);
+            for (char& c : s) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+            return s;
+        }
+        //TileChange -> TILE_CHANGE
+        static std::string constantName(const char* name)
+        {
+            std::string s;
+            for (const char* c = name; *c; c++)
+            {
+                if (c != name && std::isupper(static_cast<unsigned char>(*c))) s += '_';
+                s += static_cast<char>(std::toupper(static_cast<unsigned char>(*c)));
+            }
+            return s;
+        }
+        static std::string charLiteral(const char c)
+        {
+            if (c == '\'' || c == '\\') return std::string("'\\") + c + "'";
+            return std::string("'") + c + "'";
+        }
+    };
+
+    std::string generate()
+    {
+        JavaSchema schema;
+        schema.out << "//generated from Client/include/Messages.def by the client's protocol_schema tool, dont edit it by hand.\n"
+                      "//the client build fails while this is out of date, build its java_schema target to regenerate it\n"
+                      "package com.swagaria.network;\n"
+                      "\n"
+                      "import static com.swagaria.network.ProtocolCodec.*;\n"
+                      "\n"
+                      "final class MessageSchema\n"
+                      "{\n"
+                      "    //list entries\n";
+
+        for (const JavaSchema::Pass pass : { JavaSchema::Pass::ENTRIES, JavaSchema::Pass::LAYOUTS })
+        {
+            schema.pass = pass;
+            if (pass == JavaSchema::Pass::LAYOUTS)
+                schema.out << "\n    static final Layout[] LAYOUTS = {\n";
+
+#define ENTRY(Name) schema.entry(#Name);
+#define MESSAGE(Name, op) schema.message(#op);
+#define FIELD(type, name) schema.field("value", #type);
+#define OPTIONAL(type, name) schema.field("optional", #type);
+#define LIST(Entry, name) schema.list(#Entry, ',', ',');
+#define LIST_FIELD(Entry, name, separator, fieldSeparator) schema.list(#Entry, separator, fieldSeparator);
+#define ARRAY(type, name, count) schema.array(#type, count);
+#define SWITCH(type, name) schema.beginSwitch(#type);
+#define CASE(value) schema.beginCase(value);
+#define END_SWITCH schema.endSwitch();
+#define END_ENTRY schema.endEntry();
+#define END_MESSAGE schema.endMessage();
+#include "../include/Messages.def"
+#undef ENTRY
+#undef MESSAGE
+#undef FIELD
+#undef OPTIONAL
+#undef LIST
+#undef LIST_FIELD
+#undef ARRAY
+#undef SWITCH
+#undef CASE
+#undef END_SWITCH
+#undef END_ENTRY
+#undef END_MESSAGE
+        }
+
+        schema.out << "    };\n"
+                      "\n"
+                      "    private MessageSchema() {}\n"
+                      "}\n";
+        return schema.out.str();
+    }
+}
+
+int main(const int argc, char** argv)
+{
+    const bool check = argc == 3 && std::strcmp(argv[1], "--check") == 0;
+    if (argc != 2 && !check)
+    {
+        std::cerr << "usage: protocol_schema [--check] <MessageSchema.java>" << std::endl;
+        return 2;
+    }
+    const std::string path = argv[argc - 1];
+    const std::string java = generate();
+
+    if (check)
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream current;
+        current << in.rdbuf();
+        if (!in || current.str() != java)
+        {
+            std::cerr << "[SCHEMA] " << path << " is out of date with Messages.def, build the java_schema target to regenerate it" << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    out << java;
+    if (!out)
+    {
+        std::cerr << "[SCHEMA] Cant write " << path << std::endl;
+        return 1;
+    }
+    std::cout << "[SCHEMA] Wrote " << path << std::endl;
+    return 0;
+}
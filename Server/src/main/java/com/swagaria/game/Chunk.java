@@ -4,6 +4,7 @@ import com.swagaria.data.terrain.TerrainConfig;
 import com.swagaria.data.terrain.Tile;
 import com.swagaria.data.terrain.TileDefinition;
 import com.swagaria.data.terrain.TileLayer;
+import com.swagaria.network.ProtocolCodec;
 
 import java.util.Random;
 
@@ -15,6 +16,8 @@ public class Chunk
     private final World world;
     private final Tile[][][] tiles;
     private final Random random;
+    private long hash;                 //sum of tileHash over every tile, worked out on first use then kept up to date by setTile
+    private boolean hashValid = false; //generation writes tiles directly, so nothing is hashed until someone asks
 
     public Chunk(int chunkX, int chunkY, World world)
     {
@@ -163,6 +166,9 @@ public class Chunk
         }
     }
 
+    public int getChunkX() { return chunkX; }
+    public int getChunkY() { return chunkY; }
+
     public Tile getTile(int localX, int localY, int layer)
     {
         if (localX < 0 || localX >= SIZE || localY < 0 || localY >= SIZE || layer < 0 || layer >= TileLayer.NUM_LAYERS)
@@ -170,19 +176,48 @@ public class Chunk
         return tiles[localX][localY][layer];
     }
 
-    public void setTile(int localX, int localY, int layer, int tileTypeId)
+    public synchronized void setTile(int localX, int localY, int layer, int tileTypeId)
     {
         if (localX < 0 || localX >= SIZE || localY < 0 || localY >= SIZE || layer < 0 || layer >= TileLayer.NUM_LAYERS)
             return;
 
         //if tile exists then update it, else just make new instance of it
         Tile tile = tiles[localX][localY][layer];
+        if (hashValid)
+            hash += tileHash(localX, localY, layer, tileTypeId) - tileHash(localX, localY, layer, tile == null ? TileDefinition.ID_AIR : tile.getTileID());
         if (tile != null)
             tile.setTileID(tileTypeId);
         else
             tiles[localX][localY][layer] = new Tile(tileTypeId);
     }
 
+    public synchronized long getHash()
+    {
+        if (!hashValid)
+        {
+            hash = 0;
+            for (int x = 0; x < SIZE; x++)
+                for (int y = 0; y < SIZE; y++)
+                    for (int layer = 0; layer < TileLayer.NUM_LAYERS; layer++)
+                    {
+                        Tile t = tiles[x][y][layer];
+                        hash += tileHash(x, y, layer, t == null ? TileDefinition.ID_AIR : t.getTileID());
+                    }
+            hashValid = true;
+        }
+        return hash;
+    }
+
+    //must match Chunk::tileHash on the client: splitmix64 of position, layer and id, air adds nothing
+    public static long tileHash(int x, int y, int layer, int type)
+    {
+        if (type == TileDefinition.ID_AIR) return 0;
+        long z = ((long) ((y * SIZE + x) * TileLayer.NUM_LAYERS + layer) << 16 | (type & 0xFFFF)) + 0x9E3779B97F4A7C15L;
+        z = (z ^ (z >>> 30)) * 0xBF58476D1CE4E5B9L;
+        z = (z ^ (z >>> 27)) * 0x94D049BB133111EBL;
+        return z ^ (z >>> 31);
+    }
+
     public String serialize()
     {
         StringBuilder sb = new StringBuilder();
@@ -204,4 +239,20 @@ public class Chunk
         }
         return sb.toString();
     }
+
+    //palette + run-length binary frame for v2 clients, null if it cant be packed (send serialize() instead)
+    public byte[] serializePacked()
+    {
+        int[] ids = new int[TileLayer.NUM_LAYERS * SIZE * SIZE];
+        int i = 0;
+        for (int layer = 0; layer < TileLayer.NUM_LAYERS; layer++)
+            for (int y = 0; y < SIZE; y++) //same order as serialize()
+                for (int x = 0; x < SIZE; x++)
+                {
+                    Tile t = tiles[x][y][layer];
+                    ids[i++] = (t == null) ? TileDefinition.ID_AIR : t.getTileID();
+                }
+
+        return ProtocolCodec.encodePackedChunk(chunkX, chunkY, ids, SIZE * SIZE);
+    }
 }
\ No newline at end of file
@@ -12,6 +12,17 @@ public class Player
     private float lastX, lastY;
     private float vx = 0f, vy = 0f;
     private boolean up = false, left = false, right = false, down = false;
+    private long inputSequence = -1; //last INPUT_STATE applied, for prediction/reconciliation later
+
+    //udp clients get a position on the tick it changed and a few after, in case a datagram is lost
+    public static final int UDP_MOVE_REPEATS = 4;
+    private int udpRepeats = 0; //tick thread only
+
+    //INPUT_STATE bits, mirrors Protocol::InputBits on the client
+    public static final int INPUT_LEFT = 1;
+    public static final int INPUT_RIGHT = 1 << 1;
+    public static final int INPUT_JUMP = 1 << 2;
+    public static final int INPUT_DOWN = 1 << 3;
 
     //movement
     private static final float MOVE_SPEED = 6.0f;      //tiles/sec
@@ -76,6 +87,17 @@ public class Player
         }
     }
 
+    public void setInputState(int bits, long sequence)
+    {
+        left = (bits & INPUT_LEFT) != 0;
+        right = (bits & INPUT_RIGHT) != 0;
+        up = (bits & INPUT_JUMP) != 0;
+        down = (bits & INPUT_DOWN) != 0;
+        inputSequence = sequence;
+    }
+
+    public long getInputSequence() { return inputSequence; }
+
     public boolean overlapsTile(int tileX, int tileY)
     {
         return x < tileX + 1 &&
@@ -94,4 +116,14 @@ public class Player
         lastX = x;
         lastY = y;
     }
+
+    public void resetUdpRepeats() { udpRepeats = UDP_MOVE_REPEATS; }
+
+    //true while this tick should still carry the position over udp
+    public boolean takeUdpRepeat()
+    {
+        if (udpRepeats == 0) return false;
+        udpRepeats--;
+        return true;
+    }
 }
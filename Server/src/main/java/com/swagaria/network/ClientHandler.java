@@ -14,16 +14,72 @@ import com.swagaria.game.World;
 
 import java.io.*;
 import java.net.Socket;
+import java.net.SocketAddress;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayDeque;
+import java.util.ArrayList;
+import java.util.LinkedHashSet;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+import java.util.Set;
+import java.util.concurrent.atomic.AtomicInteger;
 
 public class ClientHandler implements Runnable
 {
     private final Socket socket;
     private final int clientId;
     private final Server server;
-    private PrintWriter out;
-    private BufferedReader in;
+    private OutputStream out;
+    private InputStream in;
     private volatile boolean running = true;
 
+    //everything sent to this client is queued here and written by its own writer thread,
+    //so the game tick and the other handlers never wait on a slow socket
+    private static final int MAX_OUTBOUND_BYTES = 4 * 1024 * 1024; //a client this far behind is dropped
+    private static final int CHUNK_OUTBOUND_BYTES = 256 * 1024;    //chunks wait while more than this is still queued
+    private final ArrayDeque<byte[]> outbound = new ArrayDeque<>(); //guarded by this
+    private int outboundBytes = 0;                                  //guarded by this
+    private Thread writer = null;                                   //guarded by this, nothing is queued before run() starts it
+
+    private volatile boolean binaryProtocol = false; //what we send, only flipped while holding the lock
+    private boolean binaryIn = false;                //what we read, only touched by this thread
+    private final ByteArrayOutputStream lineBuffer = new ByteArrayOutputStream();
+    private long lastInputSequence = -1; //newest INPUT_STATE applied, guarded by inputLock
+    private final Object inputLock = new Object(); //INPUT_STATE comes in over tcp and udp
+
+    //the chunks are most of the join, so they go out from the game tick once the encoding is settled: right after PROTO,
+    //or as text once an old client has had PROTO_WAIT_NS to answer. nothing else waits for it
+    private static final long PROTO_WAIT_NS = 250_000_000L;
+    private final long joinedAt = System.nanoTime();
+    private volatile boolean chunksReady = false;    //set by this thread, the tick sends them
+    private volatile boolean awaitingHashes = false; //RESUME was asked for, the chunks wait for CHUNK_HASHES
+    private boolean chunksSent = false;              //guarded by streamLock
+    private List<Chunk> joinChunks = null;           //tick thread only, null until the bulk send starts
+    private int joinChunksSent = 0;                  //tick thread only
+
+    //clients that asked for STREAM get no bulk send, their chunks go out on request from the game tick closest to
+    //their view first
+    private static final int STREAM_CHUNKS_PER_TICK = 8;
+    private volatile boolean streamChunks = false;
+    private final Object streamLock = new Object();
+    private final Set<Long> pendingChunks = new LinkedHashSet<>(); //guarded by streamLock
+    private int viewCentreX2 = 0, viewCentreY2 = 0;               //doubled so the centre stays whole, guarded by streamLock
+    private int chunksStreamed = 0;                                //tick thread only
+
+    //chunk hashes a reconnecting client sent after PROTO, those chunks are only resent if they changed
+    private boolean resumeRequested = false;
+    private Map<Long, Long> clientChunkHashes = null; //written by this thread before chunksReady, read by the tick after
+
+    //clients that asked for UDP get movement over datagrams once they said UDP_READY over tcp, and only while their
+    //keepalive hellos keep coming. otherwise a lost or blocked udp path would silently cost them every move
+    private static final long UDP_SILENCE_NS = 5_000_000_000L;
+    private long udpToken = 0;                      //0 until offered
+    private volatile SocketAddress udpAddress = null; //set by the udp thread
+    private volatile boolean udpConfirmed = false;    //last UDP_READY said 1
+    private volatile long lastDatagramAt = 0;         //System.nanoTime() of the newest datagram, set by the udp thread
+    private final AtomicInteger udpTick = new AtomicInteger();
+
     public ClientHandler(Socket socket, int clientId, Server server)
     {
         this.socket = socket;
@@ -32,67 +88,71 @@ public class ClientHandler implements Runnable
     }
 
     public int getClientId() { return clientId; }
+    public SocketAddress getUdpAddress() { return udpAddress; }
+    public void setUdpAddress(SocketAddress address) { udpAddress = address; }
+    public void onDatagram() { lastDatagramAt = System.nanoTime(); }
+
+    public boolean isUdpActive()
+    {
+        return udpConfirmed && udpAddress != null && running && System.nanoTime() - lastDatagramAt < UDP_SILENCE_NS;
+    }
+    public int nextUdpTick() { return udpTick.incrementAndGet(); }
+    public int currentUdpTick() { return udpTick.get(); }
 
     @Override
     public void run()
     {
         try
         {
-            in = new BufferedReader(new InputStreamReader(socket.getInputStream()));
-            out = new PrintWriter(socket.getOutputStream(), true);
+            in = new BufferedInputStream(socket.getInputStream());
+            out = new BufferedOutputStream(socket.getOutputStream());
+            synchronized (this)
+            {
+                writer = new Thread(this::writeLoop, "client-" + clientId + "-writer");
+                writer.setDaemon(true);
+                writer.start();
+            }
 
-            out.println("ASSIGN_ID," + clientId);
-            out.flush();
+            //ASSIGN_ID,<id>,<highest protocol version we speak>. nothing waits for the answer: a v2 client replies with
+            //PROTO whenever ASSIGN_ID reaches it and handleLine switches over then, old clients just stay on text
+            sendMessage("ASSIGN_ID," + clientId + "," + ProtocolCodec.BINARY_VERSION);
 
-            out.println(ItemRegistry.getDefinitionSync());
-            out.flush();
+            sendMessage(ItemRegistry.getDefinitionSync());
 
             //tell others about new client join
             for (Player p : server.getAllPlayers())
             {
                 if (p.getId() != clientId)
-                {
-                    out.println("PLAYER_JOIN," + p.getId() + "," + p.getX() + "," + p.getY());
-                    out.flush();
-                }
+                    sendMessage("PLAYER_JOIN," + p.getId() + "," + p.getX() + "," + p.getY());
             }
 
             //spawn client's player
             Player me = server.getPlayer(clientId);
             if (me != null)
             {
-                out.println(me.getInventory().serialize());
-                out.flush();
-
-                out.println("SPAWN," + clientId + "," + me.getX() + "," + me.getY());
-                out.flush();
-            }
-
-            try
-            {
-                System.out.println("[Server] Sending chunks to player #" + clientId + " (count=" + server.getWorld().getAllChunks().size() + ")");
-                for (Chunk chunk : server.getWorld().getAllChunks())
-                {
-                    String msg = chunk.serialize();
-                    out.println(msg);
-                    out.flush();
-                }
-                System.out.println("[Server] Sent " + server.getWorld().getAllChunks().size() + " chunks to player #" + clientId);
-            }
-            catch (Exception e)
-            {
-                //client probably disconnected while sending messages, log message and stop
-                System.err.println("[Server] Exception while sending chunks to player #" + clientId + ": " + e.getMessage());
-                running = false;
+                sendMessage(me.getInventory().serialize());
+                sendMessage("SPAWN," + clientId + "," + me.getX() + "," + me.getY());
             }
 
             if (me != null)
                 server.broadcastExcept("PLAYER_JOIN," + clientId + "," + me.getX() + "," + me.getY(), clientId);
 
             //main receive loop here VVV
-            String line;
-            while (running && (line = in.readLine()) != null)
-                handleLine(line);
+            while (running)
+            {
+                if (binaryIn)
+                {
+                    byte[] frame = readFrame();
+                    if (frame == null) break;
+                    handleFrame(frame);
+                }
+                else
+                {
+                    String line = readTextLine();
+                    if (line == null) break;
+                    handleLine(line);
+                }
+            }
 
         }
         catch (IOException e)
@@ -111,85 +171,199 @@ public class ClientHandler implements Runnable
         if (line == null || line.isEmpty()) return;
 
         //CMD_NAME,<VAR>,<VAR>,<VAR>...
-        String[] parts = line.split(",", 5);
-        if (parts.length == 0) return;
-
-        String cmd = parts[0].trim();
-        switch (cmd)
+        int comma = line.indexOf(',');
+        String cmd = (comma < 0 ? line : line.substring(0, comma)).trim();
+        if (cmd.equals("PROTO"))
         {
-            case "INPUT" -> handleInput(parts);
-            case "USE_ITEM" -> handleUseItem(parts);
-            case "INV_MOVE_ITEM" -> handleMoveItem(parts);
-            default -> System.out.println("[Server] Unknown command: " + line);
+            switchToBinary(line.split(","));
+            return;
         }
+
+        int opcode = ProtocolCodec.opcodeOf(cmd);
+        if (opcode < 0)
+            System.out.println("[Server] Unknown command: " + line);
+        else
+            handleMessage(opcode, ProtocolCodec.textFields(line));
     }
 
-    private void handleMoveItem(String[] parts)
+    //binary frame without its length prefix, its fields are read straight out of it
+    private void handleFrame(byte[] frame)
     {
-        if(parts.length < 4) return;
+        int opcode = frame[0] & 0xFF;
+        if (opcode == ProtocolCodec.TEXT)
+            handleLine(ProtocolCodec.textOf(frame));
+        else
+            handleMessage(opcode, ProtocolCodec.binaryFields(frame));
+    }
 
+    //text and binary messages both end up here, each handler reads its fields once and checks r.ok() before acting
+    private void handleMessage(int opcode, FieldReader r)
+    {
+        switch (opcode)
+        {
+            case ProtocolCodec.CHUNK_HASHES -> handleChunkHashes(r);
+            case ProtocolCodec.INPUT -> handleInput(r);
+            case ProtocolCodec.INPUT_STATE -> handleInputState(r);
+            case ProtocolCodec.VIEW -> handleView(r);
+            case ProtocolCodec.CHUNK_REQUEST -> handleChunkRequest(r);
+            case ProtocolCodec.USE_ITEM -> handleUseItem(r);
+            case ProtocolCodec.INV_MOVE_ITEM -> handleMoveItem(r);
+            case ProtocolCodec.UDP_READY -> handleUdpReady(r);
+            //echoed straight back for the client's rtt, stamped with our clock so it can work out server time
+            case ProtocolCodec.PING -> {
+                int sequence = r.i32();
+                if (r.ok()) sendMessage("PONG," + sequence + "," + System.nanoTime() / 1000);
+            }
+            default -> {
+                System.out.println("[Server] Unknown opcode from player #" + clientId + ": " + opcode);
+                return;
+            }
+        }
+        if (!r.ok())
+            System.err.println("[Server] Bad message (opcode " + opcode + ") from player #" + clientId);
+    }
+
+    //PROTO,<version>[,STREAM][,RESUME][,UDP]
+    private void switchToBinary(String[] parts)
+    {
+        int version;
         try
         {
-            int slotIndex = Integer.parseInt(parts[1].trim());
-            int itemID = Integer.parseInt(parts[2].trim());
-            int quantity = Integer.parseInt(parts[3].trim());
+            version = Integer.parseInt(parts[1].trim());
+        }
+        catch (NumberFormatException | ArrayIndexOutOfBoundsException e)
+        {
+            return;
+        }
+        if (version < ProtocolCodec.BINARY_VERSION || binaryIn) return;
 
-            Player p = server.getPlayer(clientId);
-            if(p == null) return;
+        //the client sends binary straight after its PROTO line
+        binaryIn = true;
 
-            p.getInventory().setSlot(slotIndex, itemID, quantity);
+        //PROTO_ACK is the last text line, nothing can be sent in between it and the switch
+        //a client that already got every chunk as text has nothing to stream or resume
+        boolean allowStreaming;
+        synchronized (streamLock)
+        {
+            allowStreaming = !chunksSent;
         }
-        catch (NumberFormatException e)
+        UdpChannel udp = server.getUdpChannel();
+        boolean udpRequested = false;
+        synchronized (this)
         {
-            System.err.println("[SERVER] Bad INV_MOVE_ITEM command from player #" + clientId + ":" + e.getMessage());
+            for (int i = 2; i < parts.length; i++)
+            {
+                streamChunks |= allowStreaming && parts[i].trim().equals(ProtocolCodec.STREAM_FEATURE);
+                resumeRequested |= allowStreaming && parts[i].trim().equals(ProtocolCodec.RESUME_FEATURE);
+                udpRequested |= udp != null && parts[i].trim().equals(ProtocolCodec.UDP_FEATURE);
+            }
+            sendMessage("PROTO_ACK," + ProtocolCodec.BINARY_VERSION + (streamChunks ? "," + ProtocolCodec.STREAM_FEATURE : "")
+                    + (resumeRequested ? "," + ProtocolCodec.RESUME_FEATURE : "")
+                    + (udpRequested ? "," + ProtocolCodec.UDP_FEATURE : ""));
+            binaryProtocol = true;
+
+            //UDP_OFFER,<port>,<token>: the client proves its datagrams are from this connection with the token
+            if (udpRequested)
+            {
+                udpToken = udp.register(this);
+                sendMessage("UDP_OFFER," + udp.getPort() + "," + udpToken);
+            }
         }
+        System.out.println("[Server] Player #" + clientId + " using binary protocol v" + ProtocolCodec.BINARY_VERSION);
+        if (streamChunks)
+            System.out.println("[Server] Streaming chunks to player #" + clientId + " on request");
+
+        //a resuming client sends its hashes straight after PROTO, the chunks wait for them
+        if (resumeRequested)
+            awaitingHashes = true;
+        else
+            chunksReady = true;
     }
 
-    private void handleUseItem(String[] parts)
+    private String readTextLine() throws IOException
     {
-        if (parts.length < 4) return;
+        int b;
+        while ((b = in.read()) != -1)
+        {
+            if (b == '\n')
+            {
+                String line = lineBuffer.toString(StandardCharsets.UTF_8);
+                lineBuffer.reset();
+                return line.endsWith("\r") ? line.substring(0, line.length() - 1) : line;
+            }
+            lineBuffer.write(b);
+        }
+        return null;
+    }
 
-        try
+    private byte[] readFrame() throws IOException
+    {
+        int length = 0;
+        for (int i = 0; ; i++)
         {
-            int slotIndex = Integer.parseInt(parts[1].trim());
-            int worldX = Integer.parseInt(parts[2].trim());
-            int worldY = Integer.parseInt(parts[3].trim());
+            int b = in.read();
+            if (b == -1) return null;
+            if (i >= 5) throw new IOException("Malformed frame length");
 
-            Player p = server.getPlayer(clientId);
-            if (p == null) return;
+            length |= (b & 0x7F) << (7 * i);
+            if ((b & 0x80) == 0) break;
+        }
 
-            ItemSlot slot = p.getInventory().getSlot(slotIndex);
-            Item item = slot.getItem();
-            if (item == null || slot.getQuantity() <= 0) //empty slot
-                return;
+        if (length <= 0 || length > ProtocolCodec.MAX_FRAME_SIZE)
+            throw new IOException("Bad frame length " + length);
+
+        byte[] frame = in.readNBytes(length);
+        return frame.length < length ? null : frame;
+    }
 
-            int worldHeight = TerrainConfig.WORLD_HEIGHT;
-            int worldHeightFlipped = worldHeight - 1 - worldY;
-            if (p.getServer().getWorld().calculateDistanceSq(p.getX(), p.getY(), worldX,worldHeightFlipped) > Player.MAX_REACH_DISTANCE_SQ)
-                return; //reach check
+    private void handleMoveItem(FieldReader r)
+    {
+        int slotIndex = r.i32();
+        int itemID = r.i32();
+        int quantity = r.i32();
+        if (!r.ok()) return;
+
+        Player p = server.getPlayer(clientId);
+        if(p == null) return;
+
+        p.getInventory().setSlot(slotIndex, itemID, quantity);
+    }
 
-            boolean worldModified = false;
-            if(item != null)
-                worldModified = item.use(p, worldX, worldHeightFlipped, slotIndex);
+    private void handleUseItem(FieldReader r)
+    {
+        int slotIndex = r.i32();
+        int worldX = r.i32();
+        int worldY = r.i32();
+        if (!r.ok()) return;
+
+        Player p = server.getPlayer(clientId);
+        if (p == null) return;
 
-            if(worldModified)
+        ItemSlot slot = p.getInventory().getSlot(slotIndex);
+        Item item = slot.getItem();
+        if (item == null || slot.getQuantity() <= 0) //empty slot
+            return;
+
+        int worldHeight = TerrainConfig.WORLD_HEIGHT;
+        int worldHeightFlipped = worldHeight - 1 - worldY;
+        if (p.getServer().getWorld().calculateDistanceSq(p.getX(), p.getY(), worldX,worldHeightFlipped) > Player.MAX_REACH_DISTANCE_SQ)
+            return; //reach check
+
+        boolean worldModified = false;
+        if(item != null)
+            worldModified = item.use(p, worldX, worldHeightFlipped, slotIndex);
+
+        if(worldModified)
+        {
+            if(item instanceof TileItem tileItem)
             {
-                if(item instanceof TileItem tileItem)
-                {
-                    TileDefinition def = TileDefinition.getDefinition(tileItem.getTileID());
-                    String updateMsg = "UPDATE_TILE," + worldX + "," + worldHeightFlipped + "," + tileItem.getTileID() + "," + def.layerToPlace;
-                    server.broadcast(updateMsg);
-                }
-                else if(item instanceof ToolItem toolItem)
-                {
-                    String updateMsg = "UPDATE_TILE," + worldX + "," + worldHeightFlipped + "," + TileDefinition.ID_AIR + "," + toolItem.layerToBreak;
-                    server.broadcast(updateMsg);
-                }
+                TileDefinition def = TileDefinition.getDefinition(tileItem.getTileID());
+                server.queueTileUpdate(worldX, worldHeightFlipped, tileItem.getTileID(), def.layerToPlace);
+            }
+            else if(item instanceof ToolItem toolItem)
+            {
+                server.queueTileUpdate(worldX, worldHeightFlipped, TileDefinition.ID_AIR, toolItem.layerToBreak);
             }
-        }
-        catch (NumberFormatException e)
-        {
-            System.err.println("[Server] Bad USE_ITEM command from player #" + clientId + ": " + e.getMessage());
         }
     }
 
@@ -230,19 +404,11 @@ public class ClientHandler implements Runnable
         return false;
     }
 
-    private void handleInput(String[] parts)
+    private void handleInput(FieldReader r)
     {
-        if (parts.length < 3) return;
-        int id;
-        try
-        {
-            id = Integer.parseInt(parts[1]);
-        }
-        catch (NumberFormatException ex)
-        {
-            return;
-        }
-        String action = parts[2];
+        int id = r.i32();
+        String action = r.str();
+        if (!r.ok()) return;
 
         Player p = server.getPlayer(id);
         if (p == null) return;
@@ -251,26 +417,324 @@ public class ClientHandler implements Runnable
         p.setInput(action, pressed);
     }
 
+    //called from the game tick once the encoding is settled, streaming clients ask for their chunks instead. the whole
+    //world goes out as fast as the writer drains it, only held back while more than CHUNK_OUTBOUND_BYTES is queued
+    public void sendJoinChunks()
+    {
+        if (!running) return;
+        if (joinChunks == null)
+        {
+            synchronized (streamLock)
+            {
+                if (chunksSent) return;
+                if (!chunksReady && (awaitingHashes || System.nanoTime() - joinedAt < PROTO_WAIT_NS)) return;
+                chunksSent = true;
+            }
+            if (streamChunks) return;
+
+            joinChunks = new ArrayList<>();
+            for (Chunk chunk : server.getWorld().getAllChunks())
+            {
+                if (!clientHasChunk(chunk))
+                    joinChunks.add(chunk);
+            }
+            System.out.println("[Server] Sending chunks to player #" + clientId + " (count=" + joinChunks.size() + ")");
+        }
+        if (joinChunksSent == joinChunks.size()) return;
+
+        while (joinChunksSent < joinChunks.size())
+        {
+            synchronized (this)
+            {
+                if (!running || outboundBytes > CHUNK_OUTBOUND_BYTES) return; //the rest go next tick
+            }
+            sendChunk(joinChunks.get(joinChunksSent++));
+        }
+        System.out.println("[Server] Sent " + joinChunksSent + " chunks to player #" + clientId
+                + (clientChunkHashes != null ? " (resumed, " + (server.getWorld().getAllChunks().size() - joinChunksSent) + " unchanged)" : ""));
+    }
+
+    //INPUT_STATE,<sequence>,<bits>: the whole held state, always for this connection's own player
+    private void handleInputState(FieldReader r)
+    {
+        long sequence = r.varint() & 0xFFFFFFFFL;
+        int bits = r.u8();
+        if (r.ok())
+            applyInputState(sequence, bits);
+    }
+
+    //UDP_READY,<0|1>: moves only go over udp while the client says it is getting them
+    private void handleUdpReady(FieldReader r)
+    {
+        boolean ready = r.u8() != 0;
+        if (!r.ok() || udpToken == 0 || ready == udpConfirmed) return;
+
+        udpConfirmed = ready;
+        System.out.println("[Server] Player #" + clientId + (ready ? " confirmed UDP, moves go over datagrams" : " lost UDP, moves back on TCP"));
+    }
+
+    //this thread or the udp one, repeated datagrams and tcp fallbacks for the same state land here too
+    public void applyInputState(long sequence, int bits)
+    {
+        synchronized (inputLock)
+        {
+            //older states are already superseded, nothing to replay
+            if (sequence <= lastInputSequence) return;
+            lastInputSequence = sequence;
+
+            Player p = server.getPlayer(clientId);
+            if (p != null)
+                p.setInputState(bits, sequence);
+        }
+    }
+
+    //VIEW,<minX>,<minY>,<maxX>,<maxY>: chunk rect the client is looking at, pending chunks nearest to it go first
+    private void handleView(FieldReader r)
+    {
+        int minX = r.i32();
+        int minY = r.i32();
+        int maxX = r.i32();
+        int maxY = r.i32();
+        if (!r.ok()) return;
+
+        synchronized (streamLock)
+        {
+            viewCentreX2 = minX + maxX;
+            viewCentreY2 = minY + maxY;
+        }
+    }
+
+    //CHUNK_REQUEST,<cx>,<cy>,<cx>,<cy>...
+    private void handleChunkRequest(FieldReader r)
+    {
+        if (!streamChunks) return; //bulk clients already got everything
+
+        int count = r.listCount(2);
+        synchronized (streamLock)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                int cx = r.varint();
+                int cy = r.varint();
+                if (!r.ok()) return; //the entries before it still count
+                if (server.getWorld().getChunk(cx, cy) != null)
+                    pendingChunks.add(((long) cx << 32) | (cy & 0xFFFFFFFFL));
+            }
+        }
+    }
+
+    //CHUNK_HASHES,<cx>,<cy>,<unsigned hash>... a bad entry ends the list, chunks without a hash are just resent
+    private static Map<Long, Long> parseChunkHashes(FieldReader r)
+    {
+        Map<Long, Long> hashes = new HashMap<>();
+        int count = r.listCount(3);
+        for (int i = 0; i < count; i++)
+        {
+            int cx = r.varint();
+            int cy = r.varint();
+            long hash = r.u64();
+            if (!r.ok()) break;
+            hashes.put(((long) cx << 32) | (cy & 0xFFFFFFFFL), hash);
+        }
+        return hashes;
+    }
+
+    private boolean clientHasChunk(Chunk chunk)
+    {
+        if (clientChunkHashes == null) return false;
+        Long hash = clientChunkHashes.get(((long) chunk.getChunkX() << 32) | (chunk.getChunkY() & 0xFFFFFFFFL));
+        return hash != null && hash == chunk.getHash();
+    }
+
+    //CHUNK_HASHES follows a PROTO with RESUME and releases the chunks. the bulk send skips unchanged ones, streaming
+    //clients only request chunks they dont have so anything they held that changed is pushed to them
+    private void handleChunkHashes(FieldReader r)
+    {
+        if (!awaitingHashes || clientChunkHashes != null) return;
+        clientChunkHashes = parseChunkHashes(r);
+        if (streamChunks)
+            queueChangedChunks();
+        chunksReady = true;
+    }
+
+    private void queueChangedChunks()
+    {
+        int changed = 0;
+        synchronized (streamLock)
+        {
+            for (long key : clientChunkHashes.keySet())
+            {
+                Chunk chunk = server.getWorld().getChunk((int) (key >> 32), (int) key);
+                if (chunk != null && !clientHasChunk(chunk))
+                {
+                    pendingChunks.add(key);
+                    changed++;
+                }
+            }
+        }
+        System.out.println("[Server] Player #" + clientId + " resumed with " + clientChunkHashes.size() + " chunks, " + changed + " changed since");
+    }
+
+    //called from the game tick, a few chunks per client per tick so one join cant hog the tick
+    public void streamPendingChunks()
+    {
+        if (!streamChunks || !running) return;
+        synchronized (this)
+        {
+            if (outboundBytes > CHUNK_OUTBOUND_BYTES) return; //still sending the last few, the rest stay pending
+        }
+
+        List<Chunk> batch = new ArrayList<>();
+        synchronized (streamLock)
+        {
+            while (!pendingChunks.isEmpty() && batch.size() < STREAM_CHUNKS_PER_TICK)
+            {
+                long nearest = 0;
+                int nearestDistance = Integer.MAX_VALUE;
+                for (long key : pendingChunks)
+                {
+                    int dx = (int) (key >> 32) * 2 - viewCentreX2;
+                    int dy = (int) key * 2 - viewCentreY2;
+                    if (dx * dx + dy * dy < nearestDistance)
+                    {
+                        nearestDistance = dx * dx + dy * dy;
+                        nearest = key;
+                    }
+                }
+                pendingChunks.remove(nearest);
+                batch.add(server.getWorld().getChunk((int) (nearest >> 32), (int) nearest));
+            }
+        }
+
+        for (Chunk chunk : batch)
+            sendChunk(chunk);
+        if (!batch.isEmpty() && (chunksStreamed += batch.size()) == server.getWorld().getAllChunks().size())
+            System.out.println("[Server] Streamed the whole world to player #" + clientId);
+    }
+
+    //called from the tick thread and other handlers too, only ever queues
     public void sendMessage(String msg)
     {
-        if (out != null)
+        send(new OutgoingMessage(msg));
+    }
+
+    //the same OutgoingMessage can go to every client, it is only encoded the first time one needs it
+    public synchronized void send(OutgoingMessage msg)
+    {
+        enqueue(binaryProtocol ? msg.frame() : msg.line());
+    }
+
+    //one tick worth of tile changes, binary clients get them as one UPDATE_REGION frame, text clients as UPDATE_TILE lines.
+    //region is ProtocolCodec.encodeRegion of the same changes, null when there is only the one change
+    public synchronized void sendTileUpdates(List<OutgoingMessage> tiles, byte[] region)
+    {
+        if (binaryProtocol && region != null)
         {
-            out.println(msg);
-            out.flush();
+            enqueue(region);
+            return;
         }
+        for (OutgoingMessage tile : tiles)
+            send(tile);
+    }
+
+    //binary clients get the palette/run-length version, everyone else the plain CHUNK_DATA line
+    public void sendChunk(Chunk chunk)
+    {
+        synchronized (this)
+        {
+            if (binaryProtocol)
+            {
+                byte[] packed = chunk.serializePacked();
+                if (packed != null)
+                {
+                    enqueue(packed);
+                    return;
+                }
+            }
+        }
+        sendMessage(chunk.serialize());
+    }
+
+    private synchronized void enqueue(byte[] bytes)
+    {
+        if (writer == null || !running) return;
+
+        if (outboundBytes + bytes.length > MAX_OUTBOUND_BYTES)
+        {
+            System.err.println("[Server] Player #" + clientId + " is " + outboundBytes + " bytes behind, disconnecting");
+            running = false;
+            closeSocket(); //wakes the receive loop, which cleans up
+            notifyAll();
+            return;
+        }
+        outbound.add(bytes);
+        outboundBytes += bytes.length;
+        notifyAll();
+    }
+
+    //writer thread, only flushes once the queue is empty so a burst goes out in as few packets as it can
+    private void writeLoop()
+    {
+        try
+        {
+            while (true)
+            {
+                byte[] bytes;
+                boolean last;
+                synchronized (this)
+                {
+                    while (running && outbound.isEmpty())
+                        wait();
+                    if (!running) return;
+
+                    bytes = outbound.poll();
+                    outboundBytes -= bytes.length;
+                    last = outbound.isEmpty();
+                }
+                out.write(bytes);
+                if (last)
+                    out.flush();
+            }
+        }
+        catch (IOException | InterruptedException e)
+        {
+            running = false; //client went away, the receive loop will clean up
+            closeSocket();
+        }
+    }
+
+    private void closeSocket()
+    {
+        try
+        {
+            socket.close();
+        }
+        catch (IOException ignored) {}
     }
 
     private void cleanup()
     {
         running = false;
+        synchronized (this)
+        {
+            outbound.clear();
+            outboundBytes = 0;
+            notifyAll(); //lets the writer thread finish
+        }
+        udpAddress = null;
+        if (udpToken != 0 && server.getUdpChannel() != null)
+            server.getUdpChannel().unregister(udpToken);
         try
         {
             if (in != null) in.close();
         }
         catch (IOException ignored) {}
 
-        if (out != null)
-            out.close();
+        try
+        {
+            if (out != null) out.close();
+        }
+        catch (IOException ignored) {}
 
         try
         {
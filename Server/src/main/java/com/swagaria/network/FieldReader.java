@@ -0,0 +1,20 @@
+package com.swagaria.network;
+
+/**
+ * the fields of one incoming message in order, the same getters whether it came as a text line or a binary frame
+ * so a handler reads its message once without caring which. see ProtocolCodec.binaryFields / textFields
+ * the first problem sticks: later reads return 0 or "" and ok() stays false, handlers check it once at the end
+ */
+public interface FieldReader
+{
+    int i32();
+    int u8();
+    int varint(); //unsigned, mask with 0xFFFFFFFFL for the whole range
+    long u64();
+    String str();
+
+    //entries left in a list of fieldsPerEntry fields that runs to the end of the message
+    int listCount(int fieldsPerEntry);
+
+    boolean ok();
+}
@@ -0,0 +1,42 @@
+//generated from Client/include/Messages.def by the client's protocol_schema tool, dont edit it by hand.
+//the client build fails while this is out of date, build its java_schema target to regenerate it
+package com.swagaria.network;
+
+import static com.swagaria.network.ProtocolCodec.*;
+
+final class MessageSchema
+{
+    //list entries
+    static final Field[] TILE_CHANGE = { Field.value(Type.VARINT), Field.value(Type.VARINT), Field.value(Type.U16), Field.value(Type.U8) };
+    static final Field[] INV_SLOT = { Field.value(Type.I32), Field.value(Type.I32) };
+    static final Field[] ITEM_DEF = { Field.value(Type.I32), Field.value(Type.STR), Field.value(Type.I32), Field.select(Type.CHR, new Case('T', Field.value(Type.I32)), new Case('R', Field.value(Type.STR), Field.value(Type.F32))) };
+    static final Field[] CHUNK_POS = { Field.value(Type.VARINT), Field.value(Type.VARINT) };
+    static final Field[] CHUNK_HASH = { Field.value(Type.VARINT), Field.value(Type.VARINT), Field.value(Type.U64) };
+
+    static final Layout[] LAYOUTS = {
+            new Layout(ASSIGN_ID, "ASSIGN_ID", Field.value(Type.I32)),
+            new Layout(SPAWN, "SPAWN", Field.value(Type.I32), Field.value(Type.F32), Field.value(Type.F32)),
+            new Layout(ITEM_DEF_SYNC, "ITEM_DEF_SYNC", Field.list('|', ':', ITEM_DEF)),
+            new Layout(PLAYER_MOVE, "PLAYER_MOVE", Field.value(Type.I32), Field.value(Type.F32), Field.value(Type.F32)),
+            new Layout(PLAYER_JOIN, "PLAYER_JOIN", Field.value(Type.I32), Field.value(Type.F32), Field.value(Type.F32)),
+            new Layout(PLAYER_LEAVE, "PLAYER_LEAVE", Field.value(Type.I32)),
+            new Layout(CHUNK_DATA, "CHUNK_DATA", Field.value(Type.I32), Field.value(Type.I32), Field.array(Type.U16, 512)),
+            new Layout(UPDATE_TILE, "UPDATE_TILE", Field.value(Type.I32), Field.value(Type.I32), Field.value(Type.U16), Field.value(Type.U8)),
+            new Layout(INV_UPDATE, "INV_UPDATE", Field.value(Type.I32), Field.value(Type.I32), Field.value(Type.I32), Field.value(Type.I32)),
+            new Layout(INV_SYNC, "INV_SYNC", Field.list(',', ',', INV_SLOT)),
+            new Layout(PONG, "PONG", Field.value(Type.I32), Field.optional(Type.I64)),
+            new Layout(UPDATE_REGION, "UPDATE_REGION", Field.list(',', ',', TILE_CHANGE)),
+            new Layout(UDP_OFFER, "UDP_OFFER", Field.value(Type.U16), Field.value(Type.U64)),
+            new Layout(INPUT, "INPUT", Field.value(Type.I32), Field.value(Type.STR)),
+            new Layout(USE_ITEM, "USE_ITEM", Field.value(Type.I32), Field.value(Type.I32), Field.value(Type.I32)),
+            new Layout(INV_MOVE_ITEM, "INV_MOVE_ITEM", Field.value(Type.I32), Field.value(Type.I32), Field.value(Type.I32)),
+            new Layout(PING, "PING", Field.value(Type.I32)),
+            new Layout(INPUT_STATE, "INPUT_STATE", Field.value(Type.VARINT), Field.value(Type.U8)),
+            new Layout(VIEW, "VIEW", Field.value(Type.I32), Field.value(Type.I32), Field.value(Type.I32), Field.value(Type.I32)),
+            new Layout(CHUNK_REQUEST, "CHUNK_REQUEST", Field.list(',', ',', CHUNK_POS)),
+            new Layout(CHUNK_HASHES, "CHUNK_HASHES", Field.list(',', ',', CHUNK_HASH)),
+            new Layout(UDP_READY, "UDP_READY", Field.value(Type.U8)),
+    };
+
+    private MessageSchema() {}
+}
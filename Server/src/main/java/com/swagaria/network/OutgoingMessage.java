@@ -0,0 +1,38 @@
+package com.swagaria.network;
+
+import java.nio.charset.StandardCharsets;
+
+/**
+ * one text message on its way to any number of clients. the text line and the binary frame are each built the first
+ * time a client needs them and then shared, so a broadcast encodes once instead of once per client.
+ * built and sent from a single thread, the byte arrays are never changed after that
+ */
+public final class OutgoingMessage
+{
+    private final String text;
+    private byte[] line = null;
+    private byte[] frame = null;
+
+    public OutgoingMessage(String text)
+    {
+        this.text = text;
+    }
+
+    public String text() { return text; }
+
+    //for text (v1) clients, newline included
+    public byte[] line()
+    {
+        if (line == null)
+            line = (text + "\n").getBytes(StandardCharsets.UTF_8);
+        return line;
+    }
+
+    //for binary (v2) clients, length prefix included
+    public byte[] frame()
+    {
+        if (frame == null)
+            frame = ProtocolCodec.encode(text);
+        return frame;
+    }
+}
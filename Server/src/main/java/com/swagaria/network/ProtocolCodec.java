@@ -0,0 +1,554 @@
+package com.swagaria.network;
+
+import java.io.ByteArrayOutputStream;
+import java.nio.BufferUnderflowException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.StandardCharsets;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+import java.util.regex.Pattern;
+
+/**
+ * binary (v2) encoding of the line based protocol, mirrors Client/include/Protocol.h
+ * frames are: varint length | opcode | little-endian fields
+ * the rest of the server still builds text messages, they get converted here for binary clients (see OutgoingMessage).
+ * incoming messages are read field by field through a FieldReader, whichever encoding they came in
+ */
+public final class ProtocolCodec
+{
+    public static final int TEXT_VERSION = 1;
+    public static final int BINARY_VERSION = 2;
+    public static final int MAX_FRAME_SIZE = 1 << 20;
+    //feature flags a client can append to PROTO, the accepted ones are echoed in PROTO_ACK
+    public static final String STREAM_FEATURE = "STREAM"; //chunks are sent on request
+    public static final String RESUME_FEATURE = "RESUME"; //CHUNK_HASHES follows PROTO, unchanged chunks are skipped
+    public static final String UDP_FEATURE = "UDP";       //UDP_OFFER follows PROTO_ACK, movement can go over datagrams
+
+    //UDP side channel, see UdpChannel
+    public static final int MAX_DATAGRAM_SIZE = 1200;
+    public static final int CLIENT_DATAGRAM_HEADER = 8; //u64 token
+    public static final int SERVER_DATAGRAM_HEADER = 4; //u32 tick
+
+    //server -> client
+    public static final int ASSIGN_ID = 0x01;
+    public static final int SPAWN = 0x02;
+    public static final int ITEM_DEF_SYNC = 0x03;
+    public static final int PLAYER_MOVE = 0x04;
+    public static final int PLAYER_JOIN = 0x05;
+    public static final int PLAYER_LEAVE = 0x06;
+    public static final int CHUNK_DATA = 0x07;
+    public static final int UPDATE_TILE = 0x08;
+    public static final int INV_UPDATE = 0x09;
+    public static final int INV_SYNC = 0x0A;
+    public static final int CHUNK_DATA_PACKED = 0x0B; //palette + run-length encoded CHUNK_DATA
+    public static final int PONG = 0x0C;          //i32 ping sequence | i64 server clock in us
+    public static final int UPDATE_REGION = 0x0D; //every UPDATE_TILE from one tick in a single frame
+    public static final int UDP_OFFER = 0x0E;     //u16 port | u64 token
+    public static final int MOVE_BATCH = 0x0F;    //UDP only: varint count | count * (i32 id, f32 x, f32 y)
+
+    //client -> server
+    public static final int INPUT = 0x10;
+    public static final int USE_ITEM = 0x11;
+    public static final int INV_MOVE_ITEM = 0x12;
+    public static final int PING = 0x13;
+    public static final int INPUT_STATE = 0x14; //varint sequence | u8 input bits (Player.INPUT_*)
+    public static final int VIEW = 0x15;          //i32 minX, minY, maxX, maxY chunk rect
+    public static final int CHUNK_REQUEST = 0x16; //varint count | count * (varint chunkX, varint chunkY)
+    public static final int CHUNK_HASHES = 0x17;  //varint count | count * (varint chunkX, varint chunkY, u64 hash)
+    public static final int UDP_HELLO = 0x18;     //UDP only, no fields
+    public static final int UDP_READY = 0x19;     //u8 ready, over TCP: the client hears our datagrams (1) or stopped hearing them (0)
+
+    //any text message without a binary layout, carried as-is
+    public static final int TEXT = 0x1F;
+
+    //field types, the same names as Client/include/Messages.def
+    enum Type { I32, U16, U8, U64, I64, F32, VARINT, STR, CHR }
+
+    /**
+     * one field of a layout, the kinds are the ones in Client/include/Messages.def
+     * a LIST has the fields of one entry, a SWITCH (select, switch is taken) adds the fields of the case matching its value
+     */
+    record Field(Kind kind, Type type, int count, char separator, char fieldSeparator, Field[] entry, Case[] cases)
+    {
+        enum Kind { VALUE, OPTIONAL, LIST, ARRAY, SWITCH }
+
+        static Field value(Type type) { return new Field(Kind.VALUE, type, 1, ',', ',', null, null); }
+        static Field optional(Type type) { return new Field(Kind.OPTIONAL, type, 1, ',', ',', null, null); }
+        static Field list(char separator, char fieldSeparator, Field[] entry) { return new Field(Kind.LIST, null, 0, separator, fieldSeparator, entry, null); }
+        static Field array(Type type, int count) { return new Field(Kind.ARRAY, type, count, ',', ',', null, null); }
+        static Field select(Type type, Case... cases) { return new Field(Kind.SWITCH, type, 1, ',', ',', null, cases); }
+    }
+
+    record Case(char value, Field... fields) {}
+
+    record Layout(int opcode, String name, Field... fields) {}
+
+    //every message with a schema layout, MessageSchema is generated from Client/include/Messages.def.
+    //CHUNK_DATA_PACKED, MOVE_BATCH and TEXT are encoded by hand
+    private static final Map<String, Layout> LAYOUT_BY_NAME = new HashMap<>();
+    private static final Layout[] LAYOUT_BY_OPCODE = new Layout[TEXT + 1];
+
+    static
+    {
+        for (Layout layout : MessageSchema.LAYOUTS)
+        {
+            LAYOUT_BY_NAME.put(layout.name(), layout);
+            LAYOUT_BY_OPCODE[layout.opcode()] = layout;
+        }
+    }
+
+    private ProtocolCodec() {}
+
+    //text message -> complete binary frame (length prefix included)
+    public static byte[] encode(String msg)
+    {
+        int comma = msg.indexOf(',');
+        Layout layout = LAYOUT_BY_NAME.get(comma < 0 ? msg : msg.substring(0, comma));
+        if (layout == null)
+            return encodeText(msg);
+
+        try
+        {
+            FrameWriter w = new FrameWriter(layout.opcode());
+            writeFields(w, layout.fields(), new TextFields(msg.split(",", -1), 1));
+            return w.toFrame();
+        }
+        catch (NumberFormatException | IndexOutOfBoundsException e)
+        {
+            //anything that doesnt fit its binary layout still gets through as text
+            return encodeText(msg);
+        }
+    }
+
+    //the opcode of a text message name, -1 for names without a schema layout
+    public static int opcodeOf(String name)
+    {
+        Layout layout = LAYOUT_BY_NAME.get(name);
+        return layout == null ? -1 : layout.opcode();
+    }
+
+    //the fields of a binary frame (without length prefix) after its opcode
+    public static FieldReader binaryFields(byte[] frame)
+    {
+        return binaryFields(frame, 1, frame.length - 1);
+    }
+
+    public static FieldReader binaryFields(byte[] data, int offset, int length)
+    {
+        return new BinaryFieldReader(data, offset, length);
+    }
+
+    //the fields of a text message after its name
+    public static FieldReader textFields(String msg)
+    {
+        return new TextFieldReader(msg);
+    }
+
+    //the message a TEXT frame carries, "" if it is cut short
+    public static String textOf(byte[] frame)
+    {
+        FieldReader r = binaryFields(frame);
+        String text = r.str();
+        return r.ok() ? text : "";
+    }
+
+    /**
+     * UPDATE_REGION straight from the updates, without building the text first
+     * updates are {x, topDownY, tile, layer} the way Server.queueTileUpdate collects them, in TileChange field order
+     */
+    public static byte[] encodeRegion(List<int[]> updates)
+    {
+        Field[] entry = LAYOUT_BY_OPCODE[UPDATE_REGION].fields()[0].entry();
+        FrameWriter w = new FrameWriter(UPDATE_REGION);
+        w.varint(updates.size());
+        for (int[] u : updates)
+        {
+            for (int i = 0; i < entry.length; i++)
+                writeInt(w, entry[i].type(), u[i]);
+        }
+        return w.toFrame();
+    }
+
+    //one text field per value, extra fields after the layout are ignored like the client does
+    private static void writeFields(FrameWriter w, Field[] fields, TextFields text)
+    {
+        for (Field field : fields)
+        {
+            switch (field.kind())
+            {
+                case VALUE -> writeValue(w, field.type(), text.next());
+                case OPTIONAL -> {
+                    if (!text.atEnd()) writeValue(w, field.type(), text.next());
+                }
+                case ARRAY -> {
+                    for (int i = 0; i < field.count(); i++)
+                        writeValue(w, field.type(), text.next());
+                }
+                case LIST -> writeList(w, field, text);
+                case SWITCH -> {
+                    String value = text.next();
+                    writeValue(w, field.type(), value);
+                    for (Case c : field.cases())
+                    {
+                        if (value.length() == 1 && value.charAt(0) == c.value())
+                            writeFields(w, c.fields(), text);
+                    }
+                }
+            }
+        }
+    }
+
+    //the count goes in front of the entries, so they are written aside until it is known
+    private static void writeList(FrameWriter w, Field list, TextFields text)
+    {
+        FrameWriter entries = new FrameWriter(-1);
+        int count = 0;
+        if (list.separator() == list.fieldSeparator())
+        {
+            text.skipEmpty(); //INV_SYNC has an empty field in front of its slots
+            while (!text.atEnd())
+            {
+                writeFields(entries, list.entry(), text);
+                count++;
+            }
+        }
+        else
+        {
+            //the whole list is one field, a bad entry is dropped the same way the client skips it
+            String field = text.atEnd() ? "" : text.next();
+            String fieldSeparator = Pattern.quote(String.valueOf(list.fieldSeparator()));
+            for (String entry : field.split(Pattern.quote(String.valueOf(list.separator()))))
+            {
+                if (entry.isEmpty()) continue;
+                FrameWriter one = new FrameWriter(-1);
+                try
+                {
+                    writeFields(one, list.entry(), new TextFields(entry.split(fieldSeparator, -1), 0));
+                }
+                catch (NumberFormatException | IndexOutOfBoundsException e)
+                {
+                    continue;
+                }
+                entries.bytes(one.body.toByteArray());
+                count++;
+            }
+        }
+
+        w.varint(count);
+        w.bytes(entries.body.toByteArray());
+    }
+
+    private static void writeValue(FrameWriter w, Type type, String part)
+    {
+        switch (type)
+        {
+            case U64 -> w.i64(Long.parseUnsignedLong(part));
+            case I64 -> w.i64(Long.parseLong(part));
+            case F32 -> w.f32(Float.parseFloat(part));
+            case STR -> w.str(part);
+            case CHR -> {
+                if (part.length() != 1) throw new NumberFormatException("not a single character: " + part);
+                w.u8(part.charAt(0));
+            }
+            case VARINT -> writeInt(w, type, Integer.parseUnsignedInt(part));
+            default -> writeInt(w, type, Integer.parseInt(part));
+        }
+    }
+
+    private static void writeInt(FrameWriter w, Type type, int v)
+    {
+        switch (type)
+        {
+            case I32 -> w.i32(v);
+            case U16 -> w.u16(v);
+            case U8 -> w.u8(v);
+            case VARINT -> w.varint(v);
+            default -> throw new IllegalArgumentException("not an int field: " + type);
+        }
+    }
+
+    /**
+     * CHUNK_DATA_PACKED: chunkX, chunkY, u8 palette size, u16 palette entries,
+     * then per layer (varint run length, u8 palette index) pairs covering the whole layer
+     * ids must be in the same order as Chunk.serialize(), returns null if there are too many distinct ids
+     */
+    public static byte[] encodePackedChunk(int chunkX, int chunkY, int[] ids, int tilesPerLayer)
+    {
+        int[] palette = new int[255];
+        int paletteSize = 0;
+        byte[] indices = new byte[ids.length];
+
+        //palette in order of first appearance, chunks only ever hold a handful of tile types
+        for (int i = 0; i < ids.length; i++)
+        {
+            int index = -1;
+            for (int p = 0; p < paletteSize; p++)
+            {
+                if (palette[p] == ids[i])
+                {
+                    index = p;
+                    break;
+                }
+            }
+
+            if (index < 0)
+            {
+                if (paletteSize == palette.length) return null;
+                index = paletteSize;
+                palette[paletteSize++] = ids[i];
+            }
+            indices[i] = (byte) index;
+        }
+
+        FrameWriter w = new FrameWriter(CHUNK_DATA_PACKED);
+        w.i32(chunkX);
+        w.i32(chunkY);
+        w.u8(paletteSize);
+        for (int p = 0; p < paletteSize; p++)
+            w.u16(palette[p]);
+
+        for (int layerStart = 0; layerStart < ids.length; layerStart += tilesPerLayer)
+        {
+            int layerEnd = layerStart + tilesPerLayer;
+            int i = layerStart;
+            while (i < layerEnd)
+            {
+                int run = i + 1;
+                while (run < layerEnd && indices[run] == indices[i])
+                    run++;
+
+                w.varint(run - i);
+                w.u8(indices[i]);
+                i = run;
+            }
+        }
+        return w.toFrame();
+    }
+
+    private static byte[] encodeText(String msg)
+    {
+        FrameWriter w = new FrameWriter(TEXT);
+        w.str(msg);
+        return w.toFrame();
+    }
+
+    private static int readVarint(ByteBuffer buf)
+    {
+        int value = 0;
+        for (int i = 0; i < 5; i++)
+        {
+            int b = buf.get() & 0xFF;
+            value |= (b & 0x7F) << (7 * i);
+            if ((b & 0x80) == 0)
+                return value;
+        }
+        throw new BufferUnderflowException();
+    }
+
+    //the text fields of a message or list entry, in order. next() past the end throws like indexing parts would
+    private static final class TextFields
+    {
+        private final String[] parts;
+        private int next;
+
+        TextFields(String[] parts, int first)
+        {
+            this.parts = parts;
+            this.next = first;
+        }
+
+        boolean atEnd() { return next >= parts.length; }
+        String next() { return parts[next++]; }
+
+        void skipEmpty()
+        {
+            if (!atEnd() && parts[next].isEmpty()) next++;
+        }
+    }
+
+    private static final class BinaryFieldReader implements FieldReader
+    {
+        private final ByteBuffer buf;
+        private boolean failed = false;
+
+        BinaryFieldReader(byte[] data, int offset, int length)
+        {
+            buf = ByteBuffer.wrap(data, offset, length).order(ByteOrder.LITTLE_ENDIAN);
+        }
+
+        @Override public int i32() { return has(4) ? buf.getInt() : 0; }
+        @Override public int u8() { return has(1) ? buf.get() & 0xFF : 0; }
+        @Override public long u64() { return has(8) ? buf.getLong() : 0; }
+        @Override public boolean ok() { return !failed; }
+
+        @Override
+        public int varint()
+        {
+            if (failed) return 0;
+            try
+            {
+                return readVarint(buf);
+            }
+            catch (BufferUnderflowException e)
+            {
+                failed = true;
+                return 0;
+            }
+        }
+
+        @Override
+        public String str()
+        {
+            int length = varint();
+            if (!has(length)) return "";
+            String s = new String(buf.array(), buf.arrayOffset() + buf.position(), length, StandardCharsets.UTF_8);
+            buf.position(buf.position() + length);
+            return s;
+        }
+
+        //every entry takes at least a byte per field, so a count the rest of the frame cant hold is a bad frame
+        @Override
+        public int listCount(int fieldsPerEntry)
+        {
+            int count = varint();
+            if (!failed && (count < 0 || (long) count * fieldsPerEntry > buf.remaining()))
+                failed = true;
+            return failed ? 0 : count;
+        }
+
+        private boolean has(int bytes)
+        {
+            if (!failed && (bytes < 0 || buf.remaining() < bytes))
+                failed = true;
+            return !failed;
+        }
+    }
+
+    //numbers are trimmed like the old split based handlers did, strings are taken as they are
+    private static final class TextFieldReader implements FieldReader
+    {
+        private final String[] parts;
+        private int next = 1; //past the name
+        private boolean failed = false;
+
+        TextFieldReader(String msg)
+        {
+            parts = msg.split(",", -1);
+        }
+
+        @Override public String str() { return field(); }
+        @Override public boolean ok() { return !failed; }
+        @Override public int listCount(int fieldsPerEntry) { return failed ? 0 : (parts.length - next) / fieldsPerEntry; }
+
+        @Override
+        public int i32()
+        {
+            try
+            {
+                return Integer.parseInt(field().trim());
+            }
+            catch (NumberFormatException e)
+            {
+                failed = true;
+                return 0;
+            }
+        }
+
+        @Override
+        public int u8()
+        {
+            int v = i32();
+            if (v < 0 || v > 0xFF)
+                failed = true;
+            return failed ? 0 : v;
+        }
+
+        @Override
+        public int varint()
+        {
+            try
+            {
+                return Integer.parseUnsignedInt(field().trim());
+            }
+            catch (NumberFormatException e)
+            {
+                failed = true;
+                return 0;
+            }
+        }
+
+        @Override
+        public long u64()
+        {
+            try
+            {
+                return Long.parseUnsignedLong(field().trim());
+            }
+            catch (NumberFormatException e)
+            {
+                failed = true;
+                return 0;
+            }
+        }
+
+        private String field()
+        {
+            if (failed || next >= parts.length)
+            {
+                failed = true;
+                return "";
+            }
+            return parts[next++];
+        }
+    }
+
+    private static final class FrameWriter
+    {
+        private final ByteArrayOutputStream body = new ByteArrayOutputStream();
+
+        FrameWriter(int opcode)
+        {
+            if (opcode >= 0) u8(opcode);
+        }
+
+        void u8(int v) { body.write(v & 0xFF); }
+        void u16(int v) { u8(v); u8(v >>> 8); }
+        void i32(int v) { u8(v); u8(v >>> 8); u8(v >>> 16); u8(v >>> 24); }
+        void i64(long v) { i32((int) v); i32((int) (v >>> 32)); }
+        void f32(float v) { i32(Float.floatToIntBits(v)); }
+        void bytes(byte[] b) { body.write(b, 0, b.length); }
+
+        void varint(int v)
+        {
+            while ((v & ~0x7F) != 0)
+            {
+                u8((v & 0x7F) | 0x80);
+                v >>>= 7;
+            }
+            u8(v);
+        }
+
+        void str(String s)
+        {
+            byte[] b = s.getBytes(StandardCharsets.UTF_8);
+            varint(b.length);
+            bytes(b);
+        }
+
+        byte[] toFrame()
+        {
+            ByteArrayOutputStream frame = new ByteArrayOutputStream(body.size() + 5);
+            int length = body.size();
+            while ((length & ~0x7F) != 0)
+            {
+                frame.write((length & 0x7F) | 0x80);
+                length >>>= 7;
+            }
+            frame.write(length);
+            frame.write(body.toByteArray(), 0, body.size());
+            return frame.toByteArray();
+        }
+    }
+}
@@ -23,8 +23,11 @@ public class Server
     private final World world = new World();
     private volatile boolean running = false;
     private ServerSocket serverSocket;
+    private UdpChannel udpChannel; //null if the port couldnt be bound, everyone stays on tcp then
     private ScheduledExecutorService tickExecutor;
     private long lastUpdateTime;
+    //tile changes from the handler threads, sent out together at the end of the tick they happened in
+    private final ConcurrentLinkedQueue<int[]> pendingTileUpdates = new ConcurrentLinkedQueue<>();
 
     public Server(int port, int playerLimit)
     {
@@ -39,6 +42,17 @@ public class Server
         serverSocket = new ServerSocket(port);
         System.out.println("[Server] Listening on port " + port);
 
+        try
+        {
+            udpChannel = new UdpChannel(port);
+            udpChannel.start();
+        }
+        catch (SocketException e)
+        {
+            System.err.println("[Server] No UDP channel, movement stays on TCP: " + e.getMessage());
+            udpChannel = null;
+        }
+
         tickExecutor = Executors.newSingleThreadScheduledExecutor();
         lastUpdateTime = System.nanoTime();
         tickExecutor.scheduleAtFixedRate(this::gameTick, 0, 16, TimeUnit.MILLISECONDS);
@@ -102,13 +116,16 @@ public class Server
         running = false;
         if (tickExecutor != null)
             tickExecutor.shutdown();
+        if (udpChannel != null)
+            udpChannel.stop();
 
         //disconnect all clients
+        OutgoingMessage shutdown = new OutgoingMessage("SERVER_SHUTDOWN");
         for (ClientHandler h : handlers)
         {
             try
             {
-                h.sendMessage("SERVER_SHUTDOWN");
+                h.send(shutdown);
             }
             catch (Exception ignored) { }
         }
@@ -120,6 +137,7 @@ public class Server
     }
 
     public World getWorld() { return world; }
+    public UdpChannel getUdpChannel() { return udpChannel; }
     public Collection<Player> getAllPlayers() { return players.values(); }
     public Player getPlayer(int id) { return players.get(id); }
 
@@ -133,17 +151,20 @@ public class Server
         return null;
     }
 
+    //encoded once for everyone, see OutgoingMessage
     public void broadcast(String msg)
     {
+        OutgoingMessage out = new OutgoingMessage(msg);
         for (ClientHandler ch : handlers)
-            ch.sendMessage(msg);
+            ch.send(out);
     }
 
     public void broadcastExcept(String msg, int excludeId)
     {
+        OutgoingMessage out = new OutgoingMessage(msg);
         for (ClientHandler ch : handlers)
             if (ch.getClientId() != excludeId)
-                ch.sendMessage(msg);
+                ch.send(out);
     }
 
     public void sendMessageTo(String msg, int targetId)
@@ -152,6 +173,32 @@ public class Server
         if (ch != null) ch.sendMessage(msg);
     }
 
+    //worldY is top-down like UPDATE_TILE
+    public void queueTileUpdate(int worldX, int worldY, int tileId, int layer)
+    {
+        pendingTileUpdates.add(new int[] { worldX, worldY, tileId, layer });
+    }
+
+    private void flushTileUpdates()
+    {
+        if (pendingTileUpdates.isEmpty()) return;
+
+        //a tile touched twice in one tick only needs its final state
+        Map<Long, int[]> latest = new LinkedHashMap<>();
+        int[] u;
+        while ((u = pendingTileUpdates.poll()) != null)
+            latest.put(((long) u[0] << 36) | ((long) u[1] << 4) | u[3], u);
+
+        //both encodings are shared by every client that gets them
+        List<int[]> updates = new ArrayList<>(latest.values());
+        byte[] region = updates.size() > 1 ? ProtocolCodec.encodeRegion(updates) : null;
+        List<OutgoingMessage> tiles = new ArrayList<>(updates.size());
+        for (int[] t : updates)
+            tiles.add(new OutgoingMessage("UPDATE_TILE," + t[0] + "," + t[1] + "," + t[2] + "," + t[3]));
+        for (ClientHandler ch : handlers)
+            ch.sendTileUpdates(tiles, region);
+    }
+
     public void removeClient(int id, ClientHandler handler)
     {
         players.remove(id);
@@ -166,14 +213,34 @@ public class Server
         float deltaTime = (now - lastUpdateTime) / 1_000_000_000f;
         lastUpdateTime = now;
 
+        List<UdpChannel.Move> udpMoves = new ArrayList<>();
         for (Player p : players.values())
         {
             Physics.stepPlayer(p, getWorld(), deltaTime);
             if (p.hasMoved())
             {
-                broadcast("PLAYER_MOVE," + p.getId() + "," + p.getX() + "," + p.getY());
+                //tcp clients get it once, reliably
+                OutgoingMessage move = new OutgoingMessage("PLAYER_MOVE," + p.getId() + "," + p.getX() + "," + p.getY());
+                for (ClientHandler ch : handlers)
+                    if (!ch.isUdpActive())
+                        ch.send(move);
                 p.syncPosition();
+                p.resetUdpRepeats();
             }
+            //udp clients get it for a few more ticks after it stops, so a lost final position is covered
+            if (p.takeUdpRepeat())
+                udpMoves.add(new UdpChannel.Move(p.getId(), p.getX(), p.getY()));
+        }
+        if (udpChannel != null && !udpMoves.isEmpty())
+            for (ClientHandler ch : handlers)
+                if (ch.isUdpActive())
+                    udpChannel.sendMoves(ch, ch.nextUdpTick(), udpMoves);
+
+        flushTileUpdates();
+        for (ClientHandler h : handlers)
+        {
+            h.sendJoinChunks();
+            h.streamPendingChunks();
         }
     }
 }
\ No newline at end of file
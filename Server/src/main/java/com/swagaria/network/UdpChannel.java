@@ -0,0 +1,182 @@
+package com.swagaria.network;
+
+import java.io.IOException;
+import java.net.DatagramPacket;
+import java.net.DatagramSocket;
+import java.net.SocketAddress;
+import java.net.SocketException;
+import java.security.SecureRandom;
+import java.util.List;
+import java.util.Map;
+import java.util.concurrent.ConcurrentHashMap;
+
+/**
+ * unreliable side channel for movement, on the same port number as the tcp listener.
+ * client -> server datagrams are: u64 token | opcode | fields, the token comes from UDP_OFFER over tcp
+ * server -> client ones are: u32 tick | opcode | fields, clients drop anything older than the newest tick they saw
+ * a lost datagram is never resent, the next tick (or the client's next input repeat) supersedes it anyway.
+ * a client says UDP_READY over tcp once our datagrams reach it and keeps sending UDP_HELLO as a keepalive
+ */
+public class UdpChannel
+{
+    private static final int MOVE_SIZE = 12;        //i32 id, f32 x, f32 y
+    private static final int MOVES_PER_DATAGRAM = 96; //keeps every datagram under ProtocolCodec.MAX_DATAGRAM_SIZE
+
+    public record Move(int id, float x, float y) {}
+
+    private final DatagramSocket socket;
+    private final Map<Long, ClientHandler> clients = new ConcurrentHashMap<>();
+    private final SecureRandom random = new SecureRandom();
+    private volatile boolean running = true;
+
+    public UdpChannel(int port) throws SocketException
+    {
+        socket = new DatagramSocket(port);
+    }
+
+    public int getPort() { return socket.getLocalPort(); }
+
+    public void start()
+    {
+        Thread thread = new Thread(this::receiveLoop, "udp-receive");
+        thread.setDaemon(true);
+        thread.start();
+        System.out.println("[Server] UDP movement channel on port " + getPort());
+    }
+
+    public void stop()
+    {
+        running = false;
+        socket.close();
+    }
+
+    //a fresh token the handler hands out in UDP_OFFER, never 0 so a zeroed datagram cant match
+    public long register(ClientHandler handler)
+    {
+        long token;
+        do
+        {
+            token = random.nextLong() & Long.MAX_VALUE;
+        }
+        while (token == 0 || clients.putIfAbsent(token, handler) != null);
+        return token;
+    }
+
+    public void unregister(long token)
+    {
+        clients.remove(token);
+    }
+
+    private void receiveLoop()
+    {
+        byte[] buffer = new byte[ProtocolCodec.MAX_DATAGRAM_SIZE];
+        DatagramPacket packet = new DatagramPacket(buffer, buffer.length);
+        while (running)
+        {
+            try
+            {
+                packet.setLength(buffer.length);
+                socket.receive(packet);
+                handleDatagram(packet);
+            }
+            catch (IOException e)
+            {
+                if (running)
+                    System.err.println("[Server] UDP receive error: " + e.getMessage());
+            }
+        }
+    }
+
+    private void handleDatagram(DatagramPacket packet)
+    {
+        if (packet.getLength() < ProtocolCodec.CLIENT_DATAGRAM_HEADER + 1) return;
+
+        byte[] data = packet.getData();
+        long token = 0;
+        for (int i = 0; i < ProtocolCodec.CLIENT_DATAGRAM_HEADER; i++)
+            token |= (data[i] & 0xFFL) << (8 * i);
+
+        //unknown tokens are dropped silently, theres nobody to tell
+        ClientHandler handler = clients.get(token);
+        if (handler == null) return;
+        handler.onDatagram(); //any of them keeps the channel alive, see ClientHandler.isUdpActive
+
+        int opcode = data[ProtocolCodec.CLIENT_DATAGRAM_HEADER] & 0xFF;
+        int fields = ProtocolCodec.CLIENT_DATAGRAM_HEADER + 1;
+        switch (opcode)
+        {
+            case ProtocolCodec.UDP_HELLO -> {
+                //the address can change under NAT, so the newest hello always wins
+                SocketAddress address = packet.getSocketAddress();
+                if (!address.equals(handler.getUdpAddress()))
+                    System.out.println("[Server] Player #" + handler.getClientId() + " UDP address " + address);
+                handler.setUdpAddress(address);
+                sendMoves(handler, handler.currentUdpTick(), List.of()); //current, so it cant make this tick's moves look stale
+            }
+            case ProtocolCodec.INPUT_STATE -> {
+                //same fields as the tcp frame
+                FieldReader r = ProtocolCodec.binaryFields(data, fields, packet.getLength() - fields);
+                long sequence = r.varint() & 0xFFFFFFFFL;
+                int bits = r.u8();
+                if (r.ok())
+                    handler.applyInputState(sequence, bits);
+            }
+            default -> { }
+        }
+    }
+
+    //every datagram of one tick carries the same tick number
+    public void sendMoves(ClientHandler handler, int tick, List<Move> moves)
+    {
+        SocketAddress address = handler.getUdpAddress();
+        if (address == null) return;
+
+        int start = 0;
+        do
+        {
+            int count = Math.min(MOVES_PER_DATAGRAM, moves.size() - start);
+            byte[] datagram = new byte[ProtocolCodec.SERVER_DATAGRAM_HEADER + 1 + 2 + count * MOVE_SIZE];
+            int pos = 0;
+            for (int i = 0; i < ProtocolCodec.SERVER_DATAGRAM_HEADER; i++)
+                datagram[pos++] = (byte) (tick >>> (8 * i));
+            datagram[pos++] = (byte) ProtocolCodec.MOVE_BATCH;
+
+            //varint count, never more than two bytes at 96
+            if (count >= 0x80)
+            {
+                datagram[pos++] = (byte) ((count & 0x7F) | 0x80);
+                datagram[pos++] = (byte) (count >>> 7);
+            }
+            else
+                datagram[pos++] = (byte) count;
+
+            for (int m = start; m < start + count; m++)
+            {
+                Move move = moves.get(m);
+                pos = putInt(datagram, pos, move.id());
+                pos = putInt(datagram, pos, Float.floatToIntBits(move.x()));
+                pos = putInt(datagram, pos, Float.floatToIntBits(move.y()));
+            }
+
+            try
+            {
+                socket.send(new DatagramPacket(datagram, pos, address));
+            }
+            catch (IOException e)
+            {
+                return; //dropped like any other datagram
+            }
+            start += count;
+        }
+        while (start < moves.size());
+    }
+
+    private static int putInt(byte[] b, int pos, int v)
+    {
+        b[pos] = (byte) v;
+        b[pos + 1] = (byte) (v >>> 8);
+        b[pos + 2] = (byte) (v >>> 16);
+        b[pos + 3] = (byte) (v >>> 24);
+        return pos + 4;
+    }
+}